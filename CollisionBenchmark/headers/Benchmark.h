@@ -0,0 +1,129 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "physics/PhysicEngine.h"
+
+class CWorld;
+
+// How the bodies of a benchmark scene are placed and sized
+enum class BodyDistribution
+{
+	// Bodies of similar sizes spread over the whole world
+	Uniform = 0,
+	// Groups of about a thousand bodies, four times denser than the uniform world
+	Clustered,
+	// Sizes spread over a factor of 32, the large bodies overlap many small ones
+	SizeVariant,
+
+	Count,
+};
+
+const char*	GetBodyDistributionName(BodyDistribution distribution);
+
+struct SBenchmarkParams
+{
+	size_t				bodyCount = 1000;
+	BodyDistribution	distribution = BodyDistribution::Uniform;
+	unsigned			seed = 0;
+};
+
+/*
+* World of boxes and physic engine for the benchmarks. The stages of the step
+* are run one at a time on the calling thread so that each case can prepare
+* the input of the function it measures from the real output of the stages
+* before it. The scene sets the global world and physic engine, only one can
+* exist at a time.
+*/
+class CBenchmarkScene
+{
+public:
+	explicit CBenchmarkScene(const SBenchmarkParams& params);
+	~CBenchmarkScene();
+
+	CBenchmarkScene(const CBenchmarkScene&) = delete;
+	CBenchmarkScene& operator=(const CBenchmarkScene&) = delete;
+
+	const SBenchmarkParams&	GetParams() const { return m_params; }
+	size_t					GetBodyCount() const;
+	const CPolygon&			GetPolygons() const;
+
+	// World AABBs of the bodies and the leaves of the BVH construction
+	void	ComputeWorldAABBs();
+	const AABB&		GetLocalAABB(size_t index) const;
+	const AABB&		GetWorldAABB(size_t index) const;
+
+	// Full construction, the BVH2 then the BVH4. The BVH2 construction sorts the
+	// leaves in place, they are restored from a copy before every build
+	void	BuildAABBTree();
+	void	BuildBVH2();
+	void	BuildBVH4();
+	size_t	GetBVH2NodeCount() const;
+	const Node4*	GetBVH4Nodes() const;
+	size_t			GetBVH4NodeCount() const;
+
+	// Pairs of bodies with overlapping AABBs, found by the BVH4 traversal
+	void	CollisionBroadPhase();
+	const CFrameArray<SPolygonPair>&	GetPairsToCheck() const;
+
+	// Single pair OBB test of the engine, the inputs are packed as it expects them
+	bool	OBBCollisionTest(__m128 pos, __m128 extent, __m128 rotXxYx, __m128 rotXyYy) const noexcept;
+
+private:
+	void	AddBodies();
+	void	SaveLeaves();
+	void	RestoreLeaves();
+
+	SBenchmarkParams	m_params;
+	CPhysicEngine*		m_engine = nullptr;
+	CWorld*				m_world = nullptr;
+
+	// Leaves in the order of the bodies, before the BVH2 construction sorts them
+	std::vector<Leaf>	m_savedLeaves;
+};
+
+/*
+* A benchmark case measures a single function. Setup prepares its input from
+* a scene and returns false if the case doesn't apply to it, Run calls the
+* function iterations times. Each iteration processes GetItemCount() items,
+* bodies, nodes, queries or pairs depending on the case.
+*/
+class IBenchmark
+{
+public:
+	virtual ~IBenchmark() = default;
+
+	virtual const char*	GetName() const = 0;
+	virtual bool		Setup(CBenchmarkScene& scene) = 0;
+	virtual void		Run(size_t iterations) = 0;
+	virtual size_t		GetItemCount() const = 0;
+};
+
+struct SBenchmarkResult
+{
+	size_t	iterations = 0;
+	// Fastest repetition
+	double	seconds = 0.0;
+	double	nanosecondsPerItem = 0.0;
+	double	itemsPerSecond = 0.0;
+};
+
+struct SMeasureParams
+{
+	// Iterations double until a repetition lasts at least this long
+	double	minSeconds = 0.2;
+	// The fastest repetition is kept, the slower ones were disturbed by the system
+	size_t	repetitionCount = 5;
+};
+
+SBenchmarkResult	MeasureBenchmark(IBenchmark& benchmark, const SMeasureParams& params);
+
+// All the cases, deleted by the caller
+void	CreateBenchmarks(std::vector<IBenchmark*>& benchmarks);
+
+// Keeps the compiler from removing the computation of a result nobody reads
+void	DoNotOptimize(int value);
+
+#endif
@@ -0,0 +1,247 @@
+#include "Benchmark.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+#include "GlobalVariables.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include "World.h"
+
+// Area of the world per body, the uniform scenes have few overlaps
+#define AREA_PER_BODY 16.0f
+#define CLUSTER_BODY_COUNT 1000
+
+const char*	GetBodyDistributionName(BodyDistribution distribution)
+{
+	switch (distribution)
+	{
+	case BodyDistribution::Uniform:		return "uniform";
+	case BodyDistribution::Clustered:	return "clustered";
+	case BodyDistribution::SizeVariant:	return "size-variant";
+	default:							return "unknown";
+	}
+}
+
+CBenchmarkScene::CBenchmarkScene(const SBenchmarkParams& params)
+	: m_params(params)
+{
+	gVars = new SGlobalVariables();
+	m_engine = gVars->pPhysicEngine = new CPhysicEngine();
+	m_engine->Reset();
+
+	// The cases run on the calling thread, the workers would only add noise
+	SJobSystemConfig jobSystemConfig;
+	jobSystemConfig.workerCount = 0;
+	m_engine->SetJobSystemConfig(jobSystemConfig);
+
+	m_world = gVars->pWorld = new CWorld();
+	AddBodies();
+}
+
+CBenchmarkScene::~CBenchmarkScene()
+{
+	delete m_world;
+	delete m_engine;
+	delete gVars;
+	gVars = nullptr;
+}
+
+void	CBenchmarkScene::AddBodies()
+{
+	srand(m_params.seed);
+
+	const size_t bodyCount = m_params.bodyCount;
+	const float halfSize = sqrtf(bodyCount * AREA_PER_BODY) * 0.5f;
+
+	// Clusters are discs four times denser than the uniform world
+	const size_t clusterCount = std::max<size_t>(1, bodyCount / CLUSTER_BODY_COUNT);
+	const float clusterRadius = sqrtf(CLUSTER_BODY_COUNT * AREA_PER_BODY * 0.25f / (float)M_PI);
+	std::vector<Vec2> clusterCenters(clusterCount);
+	for (Vec2& center : clusterCenters)
+		center = Vec2(Random(-halfSize, halfSize), Random(-halfSize, halfSize));
+
+	CPolygon& polygons = m_world->GetPolygons();
+	for (size_t i = 0; i < bodyCount; i++)
+	{
+		Vec2 position;
+		float width = Random(0.5f, 2.0f);
+		float height = Random(0.5f, 2.0f);
+
+		switch (m_params.distribution)
+		{
+		case BodyDistribution::Clustered:
+		{
+			// Uniform in the disc of the cluster
+			const float distance = clusterRadius * sqrtf(Random(0.0f, 1.0f));
+			const float angle = Random(0.0f, 2.0f * (float)M_PI);
+			position = clusterCenters[i % clusterCount] + Vec2(cosf(angle), sinf(angle)) * distance;
+			break;
+		}
+		case BodyDistribution::SizeVariant:
+		{
+			// Log-uniform so that there are as many bodies in [0.25, 0.5] as in [4, 8]
+			const float scale = expf(Random(logf(0.25f), logf(8.0f)));
+			width *= scale;
+			height *= scale;
+			position = Vec2(Random(-halfSize, halfSize), Random(-halfSize, halfSize));
+			break;
+		}
+		default:
+			position = Vec2(Random(-halfSize, halfSize), Random(-halfSize, halfSize));
+			break;
+		}
+
+		const size_t polyIdx = m_world->GetBodyIndex(m_world->AddRectangle(width, height, position));
+		polygons.SetAngle(polyIdx, Random(0.0f, 360.0f));
+	}
+}
+
+size_t	CBenchmarkScene::GetBodyCount() const
+{
+	return m_world->GetPolygonCount();
+}
+
+const CPolygon&	CBenchmarkScene::GetPolygons() const
+{
+	return m_world->GetPolygons();
+}
+
+void	CBenchmarkScene::ComputeWorldAABBs()
+{
+	m_engine->ComputeWorldAABBs();
+	SaveLeaves();
+}
+
+const AABB&	CBenchmarkScene::GetLocalAABB(size_t index) const
+{
+	return m_engine->m_localAABBs[index];
+}
+
+const AABB&	CBenchmarkScene::GetWorldAABB(size_t index) const
+{
+	return m_engine->GetWorldAABB(index);
+}
+
+void	CBenchmarkScene::SaveLeaves()
+{
+	m_savedLeaves.assign(m_engine->m_xSortedLeaves.begin(), m_engine->m_xSortedLeaves.end());
+}
+
+void	CBenchmarkScene::RestoreLeaves()
+{
+	const size_t bytes = m_savedLeaves.size() * sizeof(Leaf);
+	memcpy(m_engine->m_xSortedLeaves.Data(), m_savedLeaves.data(), bytes);
+	memcpy(m_engine->m_ySortedLeaves.Data(), m_savedLeaves.data(), bytes);
+}
+
+void	CBenchmarkScene::BuildAABBTree()
+{
+	RestoreLeaves();
+	m_engine->BuildAABBTree();
+}
+
+void	CBenchmarkScene::BuildBVH2()
+{
+	RestoreLeaves();
+
+	const size_t objectCount = m_savedLeaves.size();
+	m_engine->m_bvh2Nodes.Resize(objectCount - 1);
+
+	int32_t newNodeIndex = 0;
+	m_engine->BVH2Recurse(m_engine->m_bvh2Nodes.Data(), newNodeIndex, m_engine->m_xSortedLeaves.Data(), m_engine->m_ySortedLeaves.Data(), objectCount);
+}
+
+void	CBenchmarkScene::BuildBVH4()
+{
+	// Only reads the BVH2, it can be converted again without rebuilding it
+	SBVH4Tree& tree = m_engine->m_bvh4.BeginBuild(m_engine->m_bvh2Nodes.Size());
+
+	int32_t newNodeIndex = 0;
+	m_engine->BVH2ToBVH4(m_engine->m_bvh2Nodes.Data(), 0, tree.nodes.Data(), newNodeIndex);
+	tree.nodeCount = newNodeIndex;
+	m_engine->m_bvh4.EndBuild();
+}
+
+size_t	CBenchmarkScene::GetBVH2NodeCount() const
+{
+	return m_engine->m_bvh2Nodes.Size();
+}
+
+const Node4*	CBenchmarkScene::GetBVH4Nodes() const
+{
+	return m_engine->GetBVH4Nodes();
+}
+
+size_t	CBenchmarkScene::GetBVH4NodeCount() const
+{
+	return m_engine->GetBVH4NodeCount();
+}
+
+void	CBenchmarkScene::CollisionBroadPhase()
+{
+	m_engine->CollisionBroadPhase();
+}
+
+const CFrameArray<SPolygonPair>&	CBenchmarkScene::GetPairsToCheck() const
+{
+	return m_engine->m_pairsToCheck;
+}
+
+bool	CBenchmarkScene::OBBCollisionTest(__m128 pos, __m128 extent, __m128 rotXxYx, __m128 rotXyYy) const noexcept
+{
+	return m_engine->SIMD_Shuffle_OBBCollisionTest(pos, extent, rotXxYx, rotXyYy);
+}
+
+SBenchmarkResult	MeasureBenchmark(IBenchmark& benchmark, const SMeasureParams& params)
+{
+	CTimer timer;
+
+	// Double the iterations until a repetition is long enough for the timer
+	size_t iterations = 1;
+	double seconds = 0.0;
+	while (true)
+	{
+		timer.Start();
+		benchmark.Run(iterations);
+		timer.Stop();
+		seconds = timer.GetDuration();
+
+		if (seconds >= params.minSeconds)
+			break;
+
+		// Jump close to the target once the time is measurable instead of doubling all the way
+		const size_t estimate = seconds > 0.001 ? (size_t)(iterations * params.minSeconds * 1.2 / seconds) : 0;
+		iterations = std::max(iterations * 2, estimate);
+	}
+
+	for (size_t repetition = 1; repetition < params.repetitionCount; repetition++)
+	{
+		timer.Start();
+		benchmark.Run(iterations);
+		timer.Stop();
+		seconds = std::min(seconds, (double)timer.GetDuration());
+	}
+
+	SBenchmarkResult result;
+	result.iterations = iterations;
+	result.seconds = seconds;
+
+	const double items = (double)iterations * benchmark.GetItemCount();
+	if (items > 0.0 && seconds > 0.0)
+	{
+		result.nanosecondsPerItem = seconds * 1e9 / items;
+		result.itemsPerSecond = items / seconds;
+	}
+
+	return result;
+}
+
+static volatile int s_sink = 0;
+
+void	DoNotOptimize(int value)
+{
+	s_sink = s_sink + value;
+}
@@ -0,0 +1,398 @@
+#include "Benchmark.h"
+
+#include <vector>
+#include <immintrin.h>
+
+#include "AlignedArray.h"
+#include "FrameArena.h"
+#include "physics/BroadPhaseAABBTree.h"
+#include "physics/PairGather.h"
+#include "physics/ShapeKernels.h"
+
+/*
+* BVH construction. The cases only differ by the part of the construction they
+* run, each one covers the bodies of the scene once per iteration.
+*/
+
+class CBuildAABBTreeBenchmark : public IBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "BuildAABBTree"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (scene.GetBodyCount() < 2)
+			return false;
+
+		m_scene = &scene;
+		m_scene->ComputeWorldAABBs();
+		return true;
+	}
+
+	virtual void	Run(size_t iterations) override
+	{
+		for (size_t i = 0; i < iterations; i++)
+			m_scene->BuildAABBTree();
+	}
+
+	virtual size_t	GetItemCount() const override { return m_scene->GetBodyCount(); }
+
+protected:
+	CBenchmarkScene*	m_scene = nullptr;
+};
+
+class CBVH2RecurseBenchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "BVH2Recurse"; }
+
+	virtual void	Run(size_t iterations) override
+	{
+		for (size_t i = 0; i < iterations; i++)
+			m_scene->BuildBVH2();
+	}
+};
+
+class CBVH2ToBVH4Benchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "BVH2ToBVH4"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!CBuildAABBTreeBenchmark::Setup(scene))
+			return false;
+
+		m_scene->BuildBVH2();
+		return true;
+	}
+
+	virtual void	Run(size_t iterations) override
+	{
+		for (size_t i = 0; i < iterations; i++)
+			m_scene->BuildBVH4();
+	}
+
+	// Nodes of the BVH2 converted
+	virtual size_t	GetItemCount() const override { return m_scene->GetBVH2NodeCount(); }
+};
+
+/*
+* Broad phase and AABB functions on the tree of the scene.
+*/
+
+class CBVH4TraversalBenchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "BVH4TraversalRecurse"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!CBuildAABBTreeBenchmark::Setup(scene))
+			return false;
+
+		m_scene->BuildAABBTree();
+		return true;
+	}
+
+	// One query per body, the AABB is packed as the broad phase does it
+	virtual void	Run(size_t iterations) override
+	{
+		const size_t bodyCount = m_scene->GetBodyCount();
+		const Node4* nodes = m_scene->GetBVH4Nodes();
+
+		for (size_t i = 0; i < iterations; i++)
+		{
+			m_pairs.Clear();
+			for (size_t body = 0; body < bodyCount; body++)
+				m_broadPhase.BVH4TraversalRecurse(body, body + 1, PackedAABB(m_scene->GetWorldAABB(body)), nodes, 0, m_pairs, m_stats);
+		}
+
+		DoNotOptimize((int)m_pairs.Size());
+	}
+
+private:
+	CBroadPhaseAABBTree			m_broadPhase;
+	CFrameArena					m_arena;
+	CFrameArray<SPolygonPair>	m_pairs{ m_arena };
+	// Counted as the broad phase does it so that the timing includes the counters
+	SPhysicStats				m_stats;
+};
+
+class CPackedAABBIntersectBenchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "PackedAABB::Intersect"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!CBuildAABBTreeBenchmark::Setup(scene))
+			return false;
+
+		m_scene->BuildAABBTree();
+
+		m_queries.clear();
+		for (size_t body = 0; body < m_scene->GetBodyCount(); body++)
+			m_queries.push_back(PackedAABB(m_scene->GetWorldAABB(body)));
+		return true;
+	}
+
+	// Each body against a node of the tree, in the order of the nodes so that the loads don't dominate
+	virtual void	Run(size_t iterations) override
+	{
+		const Node4* nodes = m_scene->GetBVH4Nodes();
+		const size_t nodeCount = m_scene->GetBVH4NodeCount();
+
+		int hits = 0;
+		for (size_t i = 0; i < iterations; i++)
+		{
+			size_t node = 0;
+			for (const PackedAABB& query : m_queries)
+			{
+				hits += PackedAABB::Intersect(query, nodes[node].packedAABBs);
+				node = node + 1 < nodeCount ? node + 1 : 0;
+			}
+		}
+
+		DoNotOptimize(hits);
+	}
+
+	// AABB pairs, 4 per call
+	virtual size_t	GetItemCount() const override { return m_queries.size() * 4; }
+
+private:
+	std::vector<PackedAABB>	m_queries;
+};
+
+class CAABBTransformBenchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "AABB::Transform"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!CBuildAABBTreeBenchmark::Setup(scene))
+			return false;
+
+		m_worldAABBs.resize(m_scene->GetBodyCount());
+		return true;
+	}
+
+	// Same loop as the world AABBs stage without its jobs
+	virtual void	Run(size_t iterations) override
+	{
+		const CPolygon& poly = m_scene->GetPolygons();
+
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (size_t body = 0; body < m_worldAABBs.size(); body++)
+			{
+				const __m128 pos = _mm_setr_ps(poly.positionX[body], poly.positionY[body], poly.positionX[body], poly.positionY[body]);
+				m_worldAABBs[body] = m_scene->GetLocalAABB(body).Transform(pos, poly.rotationCos[body], poly.rotationSin[body]);
+			}
+		}
+
+		DoNotOptimize(_mm_movemask_ps(m_worldAABBs.back().GetReg()));
+	}
+
+private:
+	std::vector<AABB>	m_worldAABBs;
+};
+
+/*
+* OBB kernels of the narrow phase, on the pairs found by the broad phase of the
+* scene. The bodies of the pairs are gathered once during the setup so that the
+* cases only measure the kernels.
+*/
+
+class COBBKernelBenchmark : public CBuildAABBTreeBenchmark
+{
+public:
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!CBuildAABBTreeBenchmark::Setup(scene))
+			return false;
+
+		m_scene->BuildAABBTree();
+		m_scene->CollisionBroadPhase();
+
+		const CFrameArray<SPolygonPair>& pairs = m_scene->GetPairsToCheck();
+		m_pairCount = pairs.Size();
+		if (m_pairCount == 0)
+			return false;
+
+		// All the bodies are boxes, a single bucket
+		const SSpan<const SPolygonPair> bucket = pairs.GetSpan();
+		m_gather.Gather(m_scene->GetPolygons(), &bucket, 1);
+
+		m_batchesA.clear();
+		m_batchesB.clear();
+		for (size_t block = m_gather.GetFirstBlock(0); block < m_gather.GetEndBlock(0); block++)
+		{
+			m_batchesA.push_back(m_gather.GetBatchA(block));
+			m_batchesB.push_back(m_gather.GetBatchB(block));
+		}
+
+		return true;
+	}
+
+	// Pairs tested, without the padding of the last block
+	virtual size_t	GetItemCount() const override { return m_pairCount; }
+
+protected:
+	CPairGather					m_gather;
+	size_t						m_pairCount = 0;
+	std::vector<SBodyBatch>		m_batchesA;
+	std::vector<SBodyBatch>		m_batchesB;
+};
+
+class CShuffleOBBTestBenchmark : public COBBKernelBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "SIMD_Shuffle_OBBCollisionTest"; }
+
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!COBBKernelBenchmark::Setup(scene))
+			return false;
+
+		// Lanes of the rotations are { Y.x, X.x } and { Y.y, X.y } of body A then of body B, checked against
+		// SIMD_OBBOBBTest. The X axis of a body is (cos, sin) and its Y axis (-sin, cos)
+		const CPolygon& poly = m_scene->GetPolygons();
+		m_inputs.clear();
+		for (const SPolygonPair& pair : m_scene->GetPairsToCheck())
+		{
+			const size_t a = pair.polyA;
+			const size_t b = pair.polyB;
+
+			SPairInput input;
+			input.pos = _mm_setr_ps(poly.positionX[a], poly.positionY[a], poly.positionX[b], poly.positionY[b]);
+			input.extent = _mm_setr_ps(poly.halfExtentX[a], poly.halfExtentY[a], poly.halfExtentX[b], poly.halfExtentY[b]);
+			input.rotXxYx = _mm_setr_ps(-poly.rotationSin[a], poly.rotationCos[a], -poly.rotationSin[b], poly.rotationCos[b]);
+			input.rotXyYy = _mm_setr_ps(poly.rotationCos[a], poly.rotationSin[a], poly.rotationCos[b], poly.rotationSin[b]);
+			m_inputs.push_back(input);
+		}
+
+		return true;
+	}
+
+	virtual void	Run(size_t iterations) override
+	{
+		int hits = 0;
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (const SPairInput& input : m_inputs)
+				hits += m_scene->OBBCollisionTest(input.pos, input.extent, input.rotXxYx, input.rotXyYy);
+		}
+
+		DoNotOptimize(hits);
+	}
+
+private:
+	struct SPairInput
+	{
+		__m128	pos;
+		__m128	extent;
+		__m128	rotXxYx;
+		__m128	rotXyYy;
+	};
+
+	std::vector<SPairInput>	m_inputs;
+};
+
+class COBBOBBTestBenchmark : public COBBKernelBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "SIMD_OBBOBBTest"; }
+
+	virtual void	Run(size_t iterations) override
+	{
+		int hits = 0;
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (size_t block = 0; block < m_batchesA.size(); block++)
+				hits += SIMD_OBBOBBTest(m_batchesA[block], m_batchesB[block]);
+		}
+
+		DoNotOptimize(hits);
+	}
+};
+
+class COBBOBBTestAxisBenchmark : public COBBKernelBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "SIMD_OBBOBBTest axis"; }
+
+	virtual void	Run(size_t iterations) override
+	{
+		int hits = 0;
+		__m128i axes = _mm_setzero_si128();
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (size_t block = 0; block < m_batchesA.size(); block++)
+			{
+				__m128i axis;
+				hits += SIMD_OBBOBBTest(m_batchesA[block], m_batchesB[block], axis);
+				axes = _mm_or_si128(axes, axis);
+			}
+		}
+
+		DoNotOptimize(hits + _mm_movemask_epi8(axes));
+	}
+};
+
+class COBBOBBAxisTestBenchmark : public COBBKernelBenchmark
+{
+public:
+	virtual const char*	GetName() const override { return "SIMD_OBBOBBAxisTest"; }
+
+	// Tests each pair against the axis of its largest separation, as the separating axis cache does on the next frame
+	virtual bool	Setup(CBenchmarkScene& scene) override
+	{
+		if (!COBBKernelBenchmark::Setup(scene))
+			return false;
+
+		// 4 axis lanes per block
+		m_axes.Resize(m_batchesA.size() * 4);
+		for (size_t block = 0; block < m_batchesA.size(); block++)
+		{
+			__m128i axis;
+			SIMD_OBBOBBTest(m_batchesA[block], m_batchesB[block], axis);
+			_mm_store_si128(reinterpret_cast<__m128i*>(m_axes.Data() + block * 4), axis);
+		}
+
+		return true;
+	}
+
+	virtual void	Run(size_t iterations) override
+	{
+		int hits = 0;
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (size_t block = 0; block < m_batchesA.size(); block++)
+			{
+				const __m128i axis = _mm_load_si128(reinterpret_cast<const __m128i*>(m_axes.Data() + block * 4));
+				hits += SIMD_OBBOBBAxisTest(m_batchesA[block], m_batchesB[block], axis);
+			}
+		}
+
+		DoNotOptimize(hits);
+	}
+
+private:
+	CAlignedArray<int32_t>	m_axes;
+};
+
+void	CreateBenchmarks(std::vector<IBenchmark*>& benchmarks)
+{
+	benchmarks.push_back(new CBuildAABBTreeBenchmark());
+	benchmarks.push_back(new CBVH2RecurseBenchmark());
+	benchmarks.push_back(new CBVH2ToBVH4Benchmark());
+	benchmarks.push_back(new CBVH4TraversalBenchmark());
+	benchmarks.push_back(new CPackedAABBIntersectBenchmark());
+	benchmarks.push_back(new CAABBTransformBenchmark());
+	benchmarks.push_back(new CShuffleOBBTestBenchmark());
+	benchmarks.push_back(new COBBOBBTestBenchmark());
+	benchmarks.push_back(new COBBOBBTestAxisBenchmark());
+	benchmarks.push_back(new COBBOBBAxisTestBenchmark());
+}
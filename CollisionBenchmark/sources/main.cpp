@@ -0,0 +1,151 @@
+// Benchmarks of the physic engine: BVH construction, broad phase queries, AABB
+// functions and OBB kernels, measured on scenes of 100 to 1M bodies for each
+// distribution of the bodies.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Benchmark.h"
+
+static const size_t s_bodyCounts[] = { 100, 1000, 10000, 100000, 1000000 };
+
+struct SBenchmarkConfig
+{
+	// Cases whose name contains it, all of them if null
+	const char*		filter = nullptr;
+	size_t			minBodies = 100;
+	size_t			maxBodies = 1000000;
+	// Single distribution, all of them if Count
+	BodyDistribution	distribution = BodyDistribution::Count;
+	unsigned		seed = 0;
+	SMeasureParams	measure;
+	bool			csv = false;
+};
+
+static void	PrintUsage()
+{
+	printf("Usage: CollisionBenchmark [options]\n");
+	printf("  --filter <text>               only run the cases whose name contains the text\n");
+	printf("  --min-bodies <count>          smallest scene, of 100, 1000, 10000, 100000 and 1000000 bodies (100)\n");
+	printf("  --max-bodies <count>          largest scene (1000000)\n");
+	printf("  --distribution <name>         uniform, clustered or size-variant (all)\n");
+	printf("  --min-time <seconds>          minimum time of a repetition (0.2)\n");
+	printf("  --repetitions <count>         repetitions of a case, the fastest is kept (5)\n");
+	printf("  --seed <value>                seed of the bodies (0)\n");
+	printf("  --csv                         print the results as comma separated values\n");
+}
+
+static bool	ParseDistribution(const char* name, BodyDistribution& distribution)
+{
+	for (size_t i = 0; i < (size_t)BodyDistribution::Count; i++)
+	{
+		if (strcmp(name, GetBodyDistributionName((BodyDistribution)i)) == 0)
+		{
+			distribution = (BodyDistribution)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool	ParseArguments(int argc, char** argv, SBenchmarkConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (strcmp(arg, "--filter") == 0 && hasValue)
+			config.filter = argv[++i];
+		else if (strcmp(arg, "--min-bodies") == 0 && hasValue)
+			config.minBodies = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--max-bodies") == 0 && hasValue)
+			config.maxBodies = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--distribution") == 0 && hasValue)
+		{
+			if (!ParseDistribution(argv[++i], config.distribution))
+				return false;
+		}
+		else if (strcmp(arg, "--min-time") == 0 && hasValue)
+			config.measure.minSeconds = strtod(argv[++i], nullptr);
+		else if (strcmp(arg, "--repetitions") == 0 && hasValue)
+			config.measure.repetitionCount = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--seed") == 0 && hasValue)
+			config.seed = (unsigned)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--csv") == 0)
+			config.csv = true;
+		else
+			return false;
+	}
+
+	return config.measure.minSeconds > 0.0 && config.measure.repetitionCount > 0;
+}
+
+static void	PrintHeader(bool csv)
+{
+	if (csv)
+		printf("case,distribution,bodies,items,iterations,ns_per_item,items_per_second\n");
+	else
+		printf("%-30s %-13s %8s %10s %10s %12s %14s\n", "Case", "Distribution", "Bodies", "Items", "Iterations", "ns/item", "items/s");
+}
+
+static void	PrintResult(bool csv, const IBenchmark& benchmark, const SBenchmarkParams& params, const SBenchmarkResult& result)
+{
+	const char* format = csv ? "%s,%s,%zu,%zu,%zu,%.3f,%.0f\n" : "%-30s %-13s %8zu %10zu %10zu %12.3f %14.0f\n";
+	printf(format, benchmark.GetName(), GetBodyDistributionName(params.distribution), params.bodyCount,
+		benchmark.GetItemCount(), result.iterations, result.nanosecondsPerItem, result.itemsPerSecond);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	SBenchmarkConfig config;
+	if (!ParseArguments(argc, argv, config))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<IBenchmark*> benchmarks;
+	CreateBenchmarks(benchmarks);
+
+	PrintHeader(config.csv);
+
+	for (size_t bodyCount : s_bodyCounts)
+	{
+		if (bodyCount < config.minBodies || bodyCount > config.maxBodies)
+			continue;
+
+		for (size_t distribution = 0; distribution < (size_t)BodyDistribution::Count; distribution++)
+		{
+			if (config.distribution != BodyDistribution::Count && config.distribution != (BodyDistribution)distribution)
+				continue;
+
+			SBenchmarkParams params;
+			params.bodyCount = bodyCount;
+			params.distribution = (BodyDistribution)distribution;
+			params.seed = config.seed;
+
+			CBenchmarkScene scene(params);
+
+			for (IBenchmark* benchmark : benchmarks)
+			{
+				if (config.filter != nullptr && strstr(benchmark->GetName(), config.filter) == nullptr)
+					continue;
+
+				if (!benchmark->Setup(scene))
+					continue;
+
+				PrintResult(config.csv, *benchmark, params, MeasureBenchmark(*benchmark, config.measure));
+			}
+		}
+	}
+
+	for (IBenchmark* benchmark : benchmarks)
+		delete benchmark;
+
+	return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef _ALIGNED_ARRAY_H_
+#define _ALIGNED_ARRAY_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+// Memory starting on a cache line, throws bad_alloc on failure
+inline void*	AlignedAllocate(size_t bytes)
+{
+#ifdef _WIN32
+	void* memory = _aligned_malloc(bytes, CACHE_LINE_SIZE);
+#else
+	void* memory = nullptr;
+	if (posix_memalign(&memory, CACHE_LINE_SIZE, bytes) != 0)
+		memory = nullptr;
+#endif
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+inline void	AlignedFree(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+// Contiguous range of elements of an array, used to hand columns to SIMD kernels
+template<typename T>
+struct SSpan
+{
+	SSpan() = default;
+	SSpan(T* _data, size_t _size) : data(_data), size(_size){}
+	// A span of mutable elements can be read through a span of const ones
+	template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	SSpan(const SSpan<U>& other) : data(other.data), size(other.size){}
+
+	T*		begin() const { return data; }
+	T*		end() const { return data + size; }
+	T&		operator[](size_t index) const { return data[index]; }
+
+	T*		data = nullptr;
+	size_t	size = 0;
+};
+
+/*
+* Growable array whose storage starts on a cache line, so that columns of
+* floats can be loaded with aligned SIMD loads. The capacity doubles when the
+* array is full and is always a whole number of cache lines, so 4 or 8 wide
+* loads of the last elements never read outside of the allocation.
+*/
+template<typename T>
+class CAlignedArray
+{
+public:
+	CAlignedArray() = default;
+	CAlignedArray(const CAlignedArray&) = delete;
+	CAlignedArray& operator=(const CAlignedArray&) = delete;
+
+	CAlignedArray(CAlignedArray&& other) noexcept
+		: m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity)
+	{
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_capacity = 0;
+	}
+
+	CAlignedArray& operator=(CAlignedArray&& other) noexcept
+	{
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_capacity, other.m_capacity);
+		return *this;
+	}
+
+	~CAlignedArray()
+	{
+		Resize(0);
+		AlignedFree(m_data);
+	}
+
+	T&			operator[](size_t index) { return m_data[index]; }
+	const T&	operator[](size_t index) const { return m_data[index]; }
+
+	T*			Data() { return m_data; }
+	const T*	Data() const { return m_data; }
+	size_t		Size() const { return m_size; }
+	size_t		Capacity() const { return m_capacity; }
+
+	SSpan<T>		GetSpan() { return SSpan<T>(m_data, m_size); }
+	SSpan<const T>	GetSpan() const { return SSpan<const T>(m_data, m_size); }
+
+	T*			begin() { return m_data; }
+	T*			end() { return m_data + m_size; }
+	const T*	begin() const { return m_data; }
+	const T*	end() const { return m_data + m_size; }
+
+	void	Reserve(size_t capacity)
+	{
+		if (capacity <= m_capacity)
+			return;
+
+		// Round up to whole cache lines
+		const size_t lineElements = sizeof(T) < CACHE_LINE_SIZE ? CACHE_LINE_SIZE / sizeof(T) : 1;
+		capacity = (capacity + lineElements - 1) / lineElements * lineElements;
+
+		T* data = static_cast<T*>(AlignedAllocate(capacity * sizeof(T)));
+		for (size_t i = 0; i < m_size; i++)
+		{
+			new(data + i) T(std::move(m_data[i]));
+			m_data[i].~T();
+		}
+
+		AlignedFree(m_data);
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	// New elements are value initialized
+	void	Resize(size_t size)
+	{
+		if (size > m_capacity)
+			Reserve(size > 2 * m_capacity ? size : 2 * m_capacity);
+
+		for (size_t i = m_size; i < size; i++)
+			new(m_data + i) T();
+		for (size_t i = size; i < m_size; i++)
+			m_data[i].~T();
+
+		m_size = size;
+	}
+
+	void	PushBack(const T& value)
+	{
+		if (m_size == m_capacity)
+			Reserve(m_capacity == 0 ? 1 : 2 * m_capacity);
+
+		new(m_data + m_size) T(value);
+		m_size++;
+	}
+
+	void	PopBack()
+	{
+		m_size--;
+		m_data[m_size].~T();
+	}
+
+	// Moves the last element into index and pops it, the order of elements isn't kept
+	void	SwapRemove(size_t index)
+	{
+		if (index + 1 < m_size)
+			m_data[index] = std::move(m_data[m_size - 1]);
+		PopBack();
+	}
+
+private:
+	T*		m_data = nullptr;
+	size_t	m_size = 0;
+	size_t	m_capacity = 0;
+};
+
+#endif
@@ -2,8 +2,10 @@
 #define _APPLICATION_H_
 
 #include "GlobalVariables.h"
+#include "Profiler.h"
 #include "render/SDLRenderWindow.h"
 #include "physics/PhysicEngine.h"
+#include "physics/PhysicThread.h"
 #include "render/Renderer.h"
 #include "scenes/SceneManager.h"
 #include "World.h"
@@ -16,13 +18,21 @@ void InitApplication(int width, int height, float worldHeight)
 	gVars->pRenderer = new CRenderer(worldHeight);
 	gVars->pSceneManager = new CSceneManager();
 	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pPhysicThread = new CPhysicThread();
+	gVars->pProfiler = new CProfiler();
+
+	CProfiler::SetThreadName("Render");
 
 	gVars->bDebug = false;
 }
 
 void RunApplication()
 {
+	gVars->pPhysicThread->Start();
+
 	gVars->pRenderWindow->Init();
+
+	gVars->pPhysicThread->Stop();
 }
 
 #endif
\ No newline at end of file
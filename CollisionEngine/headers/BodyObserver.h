@@ -0,0 +1,24 @@
+#ifndef _BODY_OBSERVER_H_
+#define _BODY_OBSERVER_H_
+
+#include <cstddef>
+
+/*
+* Notified by the world when bodies are added or removed so that data kept
+* outside of the physics columns (render buffers, editor data) can follow the
+* dense order of the bodies. The world runs without any observer when headless.
+*/
+class IBodyObserver
+{
+public:
+	virtual ~IBodyObserver() = default;
+
+	// Body appended at index, with its outline in local space
+	virtual void	OnBodyAdded(size_t index, const float* pointsX, const float* pointsY, size_t pointCount) = 0;
+	// The last body was moved into index
+	virtual void	OnBodyRemoved(size_t index) = 0;
+	// All the bodies are removed when the world is destroyed
+	virtual void	OnBodiesCleared() = 0;
+};
+
+#endif
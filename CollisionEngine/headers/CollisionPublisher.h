@@ -0,0 +1,181 @@
+#ifndef _COLLISION_PUBLISHER_H_
+#define _COLLISION_PUBLISHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class CPhysicEngine;
+
+// Colliding pair of a frame with its contact point, as written in shared memory
+struct SPublishedPair
+{
+	// Indices of the bodies in the world polygons
+	uint32_t	polyA;
+	uint32_t	polyB;
+	float		pointX;
+	float		pointY;
+	// Points from A to B
+	float		normalX;
+	float		normalY;
+	float		distance;
+	uint32_t	padding;
+};
+
+// Point of a contact manifold of two boxes, as written in shared memory
+struct SPublishedContact
+{
+	uint32_t	polyA;
+	uint32_t	polyB;
+	float		pointX;
+	float		pointY;
+	float		normalX;
+	float		normalY;
+	// Negative when the bodies overlap
+	float		separation;
+	uint32_t	featureId;
+};
+
+// Header of a slot of the ring, followed by its pairs then its contacts
+struct SPublishedFrame
+{
+	// Seqlock of the slot: odd while the frame is written, twice the frame index once it is complete
+	std::atomic<uint64_t>	sequence;
+	uint64_t				frameIndex;
+	// Pairs and contacts of the slot, the step may have found more than the capacities of the ring
+	uint32_t				pairCount;
+	uint32_t				contactCount;
+	uint32_t				stepPairCount;
+	uint32_t				stepContactCount;
+};
+
+// Header of the shared memory, the slots follow it
+struct SPublishedRing
+{
+	char					magic[4];
+	uint32_t				version;
+	uint32_t				slotCount;
+	uint32_t				pairCapacity;
+	uint32_t				contactCapacity;
+	// Bytes from one slot to the next, a multiple of 64
+	uint32_t				slotSize;
+	// Index of the last complete frame, 0 before the first one
+	std::atomic<uint64_t>	lastFrame;
+};
+
+// Shared memory of the ring, created by the publisher and opened read only by the readers
+class CSharedMemory
+{
+public:
+	CSharedMemory() = default;
+	~CSharedMemory();
+
+	CSharedMemory(const CSharedMemory&) = delete;
+	CSharedMemory& operator=(const CSharedMemory&) = delete;
+
+	// The name has no slash, it is a POSIX shared memory object or a named file mapping on Windows
+	bool	Create(const char* name, size_t size);
+	bool	Open(const char* name);
+	// Removes the name if the memory was created here, readers keep their mapping
+	void	Close();
+
+	uint8_t*	GetData() const { return m_data; }
+	size_t		GetSize() const { return m_size; }
+
+private:
+	bool	Map(const char* name, size_t size, bool create);
+
+	uint8_t*	m_data = nullptr;
+	size_t		m_size = 0;
+	bool		m_owner = false;
+#ifdef _WIN32
+	void*		m_mapping = nullptr;
+#else
+	// Name of the object with its leading slash, unlinked by the owner
+	char		m_name[256] = {};
+#endif
+};
+
+/*
+* Streams the colliding pairs and the contact points of every step to other
+* processes on the machine without copying them through a socket. The step
+* writes them in a ring of slots in shared memory, one frame per slot, and
+* readers map the same memory to read them in place:
+*	- each slot is a seqlock, its sequence is odd while the slot is written
+*	  and becomes twice the frame index once the frame is complete
+*	- a reader loads the sequence, reads the slot, then loads the sequence
+*	  again: the frame is valid if both are twice its index
+*	- the publisher never waits for the readers, a reader more than a ring
+*	  behind finds its frames overwritten and skips to the last one
+* Frames bigger than the capacities of the ring are truncated, the slot keeps
+* the counts of the step. The memory layout is the one of the machine, the
+* readers must be built with the same structures.
+*/
+class CCollisionPublisher
+{
+public:
+	bool	Open(const char* name, size_t slotCount, size_t pairCapacity, size_t contactCapacity);
+	void	Close();
+
+	bool	IsOpen() const { return m_memory.GetData() != nullptr; }
+	uint64_t	GetLastFrame() const { return m_frameIndex; }
+
+	// Writes the collisions and the contact manifolds of the last step in the next slot
+	void	Publish(CPhysicEngine& engine);
+
+private:
+	CSharedMemory	m_memory;
+	uint64_t		m_frameIndex = 0;
+};
+
+enum class PublishedFrameStatus
+{
+	Valid,
+	// Not published yet, or being written
+	NotReady,
+	// Replaced by a later frame, before or while it was read
+	Overwritten,
+};
+
+// Reads the frames of a CCollisionPublisher from another process
+class CCollisionReader
+{
+public:
+	// Fails if the ring doesn't exist or has another version
+	bool	Open(const char* name);
+	void	Close();
+
+	// Index of the last complete frame, 0 before the first one
+	uint64_t	GetLastFrame() const { return m_ring->lastFrame.load(std::memory_order_acquire); }
+
+	/*
+	* Calls functor(frame, pairs, contacts) on the frame in place in shared
+	* memory. The publisher may overwrite it meanwhile, the functor must not
+	* keep anything it read unless the result is Valid.
+	*/
+	template<typename TFunctor>
+	PublishedFrameStatus	Read(uint64_t frameIndex, TFunctor functor) const
+	{
+		const SPublishedFrame& frame = GetSlot(frameIndex);
+
+		const uint64_t sequence = frame.sequence.load(std::memory_order_acquire);
+		if (sequence != 2 * frameIndex)
+			return sequence > 2 * frameIndex ? PublishedFrameStatus::Overwritten : PublishedFrameStatus::NotReady;
+
+		const SPublishedPair* pairs = reinterpret_cast<const SPublishedPair*>(&frame + 1);
+		const SPublishedContact* contacts = reinterpret_cast<const SPublishedContact*>(pairs + m_ring->pairCapacity);
+		functor(frame, pairs, contacts);
+
+		// The reads of the slot can't move after the second load of the sequence
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return frame.sequence.load(std::memory_order_relaxed) == sequence ? PublishedFrameStatus::Valid : PublishedFrameStatus::Overwritten;
+	}
+
+private:
+	const SPublishedFrame&	GetSlot(uint64_t frameIndex) const;
+
+	CSharedMemory			m_memory;
+	const SPublishedRing*	m_ring = nullptr;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _FRAME_ARENA_H_
+#define _FRAME_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+
+#include "AlignedArray.h"
+
+/*
+* Linear allocator for the buffers that only live for one step. Allocating is
+* a pointer bump and Reset() frees everything at once. The memory is a single
+* block for which huge pages are requested. Allocations that don't
+* fit go to the heap until the next Reset(), which then grows the block to the
+* high-water mark so that the following frames don't allocate at all.
+* Allocations from several threads at once are lock free: the offset is moved
+* with a compare and swap, only the rare allocations that go to the heap take
+* a lock. Reset() must not run at the same time as allocations.
+*/
+class CFrameArena
+{
+public:
+	explicit CFrameArena(size_t capacity = 16 * 1024 * 1024);
+	~CFrameArena();
+
+	CFrameArena(const CFrameArena&) = delete;
+	CFrameArena& operator=(const CFrameArena&) = delete;
+
+	void*	Allocate(size_t bytes, size_t alignment = CACHE_LINE_SIZE);
+	// Grows an allocation of oldBytes in place when it is still at the top of the block,
+	// otherwise allocates a new one and copies its first usedBytes
+	void*	Reallocate(void* memory, size_t oldBytes, size_t usedBytes, size_t newBytes, size_t alignment = CACHE_LINE_SIZE);
+
+	// Frees all the allocations of the frame
+	void	Reset();
+
+	size_t	GetUsed() const { return m_offset.load(std::memory_order_relaxed) + m_overflowBytes.load(std::memory_order_relaxed); }
+	size_t	GetCapacity() const { return m_capacity; }
+	// Largest number of bytes used by a frame since the arena was created
+	size_t	GetHighWaterMark() const { return GetUsed() > m_highWaterMark ? GetUsed() : m_highWaterMark; }
+	// The system accepted to back the block with huge pages. Transparent huge pages are only
+	// a hint on Linux, whether the pages really are huge isn't known
+	bool	AreHugePagesRequested() const { return m_hugePagesRequested; }
+
+private:
+	void*	AllocateOverflow(size_t bytes);
+	void	MapBlock(size_t capacity);
+	void	UnmapBlock();
+
+	char*	m_block = nullptr;
+	size_t	m_capacity = 0;
+	// End of the allocations in the block, they are placed one after the other
+	std::atomic<size_t>	m_offset{ 0 };
+	bool	m_hugePagesRequested = false;
+
+	// Heap allocations of the frame, when the block is full
+	std::mutex			m_overflowMutex;
+	std::vector<void*>	m_overflow;
+	std::atomic<size_t>	m_overflowBytes{ 0 };
+	// Updated by Reset(), GetHighWaterMark() also counts the current frame
+	size_t	m_highWaterMark = 0;
+};
+
+/*
+* Growable array allocated from a frame arena, for trivially copyable types.
+* Its memory is gone when the arena is reset: Reset() must be called on the
+* array at the same time, which empties it without touching the old memory.
+* An array must only be used by one thread at a time.
+* New elements of Resize() are not initialized.
+*/
+template<typename T>
+class CFrameArray
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Frame arrays are moved with memcpy");
+
+public:
+	explicit CFrameArray(CFrameArena& arena) : m_arena(&arena){}
+
+	CFrameArray(const CFrameArray&) = delete;
+	CFrameArray& operator=(const CFrameArray&) = delete;
+
+	T&			operator[](size_t index) { return m_data[index]; }
+	const T&	operator[](size_t index) const { return m_data[index]; }
+
+	T*			Data() { return m_data; }
+	const T*	Data() const { return m_data; }
+	size_t		Size() const { return m_size; }
+	bool		Empty() const { return m_size == 0; }
+
+	SSpan<T>		GetSpan() { return SSpan<T>(m_data, m_size); }
+	SSpan<const T>	GetSpan() const { return SSpan<const T>(m_data, m_size); }
+
+	T*			begin() { return m_data; }
+	T*			end() { return m_data + m_size; }
+	const T*	begin() const { return m_data; }
+	const T*	end() const { return m_data + m_size; }
+
+	void	Reset()
+	{
+		m_data = nullptr;
+		m_size = 0;
+		m_capacity = 0;
+	}
+
+	void	Clear() { m_size = 0; }
+
+	void	Reserve(size_t capacity)
+	{
+		if (capacity <= m_capacity)
+			return;
+
+		m_data = static_cast<T*>(m_arena->Reallocate(m_data, m_capacity * sizeof(T), m_size * sizeof(T), capacity * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+		m_capacity = capacity;
+	}
+
+	void	Resize(size_t size)
+	{
+		if (size > m_capacity)
+			Reserve(size > 2 * m_capacity ? size : 2 * m_capacity);
+		m_size = size;
+	}
+
+	void	PushBack(const T& value)
+	{
+		if (m_size == m_capacity)
+			Reserve(m_capacity == 0 ? 64 : 2 * m_capacity);
+		m_data[m_size++] = value;
+	}
+
+private:
+	CFrameArena*	m_arena;
+	T*				m_data = nullptr;
+	size_t			m_size = 0;
+	size_t			m_capacity = 0;
+};
+
+#endif
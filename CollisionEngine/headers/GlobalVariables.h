@@ -8,6 +8,13 @@ struct SGlobalVariables
 	class CWorld*			pWorld;
 	class CSceneManager*	pSceneManager;
 	class CPhysicEngine*	pPhysicEngine;
+	class CPhysicThread*	pPhysicThread;
+	// Null unless the scopes are recorded
+	class CProfiler*		pProfiler;
+	// Null unless the steps are recorded
+	class CSceneRecorder*	pSceneRecorder;
+	// Null unless the collisions are streamed to other processes
+	class CCollisionPublisher*	pCollisionPublisher;
 
 	bool					bDebug;
 };
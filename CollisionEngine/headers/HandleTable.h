@@ -0,0 +1,59 @@
+#ifndef _HANDLE_TABLE_H_
+#define _HANDLE_TABLE_H_
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+
+// Stable reference to a body, stays valid when other bodies are removed
+struct SBodyHandle
+{
+	static constexpr uint32_t InvalidSlot = ~0u;
+
+	uint32_t	slot = InvalidSlot;
+	uint32_t	generation = 0;
+
+	bool	IsNull() const { return slot == InvalidSlot; }
+	bool	operator==(const SBodyHandle& other) const { return slot == other.slot && generation == other.generation; }
+	bool	operator!=(const SBodyHandle& other) const { return !(*this == other); }
+};
+
+/*
+* Maps handles to the index of their body in dense arrays. Removing a body
+* moves the last body into its index so the arrays stay packed for SIMD loops,
+* the table only updates the index of the moved body's slot.
+* A slot gets a new generation when its body is removed, so handles to the
+* removed body are detected as invalid once the slot is reused. Freed slots are
+* reused in the order they were freed and only once enough of them are free,
+* so per slot data kept from the last frame is not picked up by a new body.
+*/
+class CHandleTable
+{
+public:
+	// Handle of a body appended at the end of the dense arrays
+	SBodyHandle	Create();
+	// Index the caller must fill with the last body of the dense arrays before popping it
+	size_t		Remove(SBodyHandle handle);
+
+	bool		IsValid(SBodyHandle handle) const;
+	size_t		GetIndex(SBodyHandle handle) const { return m_slots[handle.slot].index; }
+	SBodyHandle	GetHandle(size_t index) const;
+	size_t		GetCount() const { return m_denseSlots.size(); }
+
+	// Slot of each body in dense order, a stable key for data kept between frames
+	const uint32_t*	GetSlots() const { return m_denseSlots.data(); }
+
+private:
+	struct SSlot
+	{
+		uint32_t	index;
+		uint32_t	generation;
+	};
+
+	std::vector<SSlot>		m_slots;
+	std::vector<uint32_t>	m_denseSlots;
+	std::deque<uint32_t>	m_freeSlots;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "AlignedArray.h"
+
+#define MAX_JOB_CONTINUATIONS 8
+
+// Called with the range of indices [begin, end) of the job
+typedef void	(*TJobFunction)(void* context, size_t begin, size_t end, size_t threadIndex);
+
+struct SJob
+{
+	TJobFunction			function;
+	void*					context;
+	size_t					begin;
+	size_t					end;
+	// Ranges larger than this are split in two jobs before running
+	size_t					batchSize;
+
+	// Job waiting for this one to finish, for the halves of a split range
+	SJob*					parent;
+	// The job itself and its unfinished split halves
+	std::atomic<int32_t>	unfinishedJobs;
+	// Unfinished dependencies, plus one until the job is run
+	std::atomic<int32_t>	pendingDependencies;
+
+	// Jobs depending on this one, queued when it finishes and they have no other pending dependency
+	SJob*					continuations[MAX_JOB_CONTINUATIONS];
+	std::atomic<int32_t>	continuationCount;
+};
+
+struct SJobSystemConfig
+{
+	// Default leaves one hardware thread for the calling thread
+	size_t	workerCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0;
+	// Pin worker N to core N, the calling thread is left free
+	bool	pinWorkers = false;
+};
+
+/*
+* Work stealing job system. Every thread has its own queue of jobs: it takes
+* the most recent one it pushed and, when empty, steals the oldest job of
+* another thread. The thread that creates the jobs and waits for them takes
+* part in running them as thread 0, workers are threads [1, GetThreadCount()).
+* Jobs form a graph through AddDependency and are only queued once the jobs
+* they depend on are finished. Job memory is a ring per thread reused without
+* being freed, skipping the jobs that aren't finished. The ring grows by a block
+* of jobs when none of its jobs is finished, waiting on a finished job may wait
+* for the job reusing its memory.
+* Threads outside of the workers all run as thread 0, they must not use the
+* job system at the same time.
+*/
+class CJobSystem
+{
+public:
+	explicit CJobSystem(const SJobSystemConfig& config = SJobSystemConfig());
+	~CJobSystem();
+
+	CJobSystem(const CJobSystem&) = delete;
+	CJobSystem& operator=(const CJobSystem&) = delete;
+
+	size_t	GetThreadCount() const { return m_threads.size(); }
+
+	// Creates a job calling function on [0, count), split in ranges of batchSize indices
+	// balanced between threads. It only starts once Run has been called
+	SJob*	CreateJob(TJobFunction function, void* context, size_t count = 1, size_t batchSize = 1);
+	// job starts after dependency is finished, must be called before both are run
+	void	AddDependency(SJob* job, SJob* dependency);
+	// Queues the job once its dependencies are finished
+	void	Run(SJob* job);
+	// Runs jobs on the calling thread until job is finished
+	void	Wait(const SJob* job);
+
+	// Calls functor(index, threadIndex) for every index in [0, count) and returns once all calls are done
+	template<typename TFunctor>
+	void	ParallelFor(size_t count, TFunctor functor, size_t batchSize = 1)
+	{
+		if (count == 0)
+			return;
+
+		// The functor is called through a plain function pointer, wrapping it
+		// in a std::function could allocate on every loop
+		SJob* job = CreateJob([](void* context, size_t begin, size_t end, size_t threadIndex)
+		{
+			for (size_t index = begin; index < end; index++)
+				(*static_cast<TFunctor*>(context))(index, threadIndex);
+		}, &functor, count, batchSize);
+
+		Run(job);
+		Wait(job);
+	}
+
+private:
+	static const size_t JOB_BLOCK_SIZE = 1024;
+	static const size_t JOB_QUEUE_SIZE = 1024;
+
+	// Jobs and queue of a thread, starts on its own cache line
+	struct alignas(CACHE_LINE_SIZE) SThreadJobs
+	{
+		// Ring of the jobs created by the thread, in blocks that are never moved since
+		// other threads hold pointers to the jobs. Only the owner reads the blocks
+		std::vector<SJob*>	jobBlocks;
+		size_t				nextJob = 0;
+
+		// Ring of queued jobs, the owner pushes and pops at the back, thieves take from the front
+		std::mutex		queueMutex;
+		SJob*			queue[JOB_QUEUE_SIZE];
+		size_t			front = 0;
+		size_t			back = 0;
+	};
+
+	static void	AddJobBlock(SThreadJobs& thread);
+
+	void	WorkerLoop(size_t threadIndex);
+	void	PinWorker(std::thread& worker, size_t core);
+
+	void	Push(SJob* job);
+	SJob*	Pop(size_t threadIndex);
+	SJob*	Steal(size_t threadIndex);
+	// Next job for the thread, from its queue or stolen from another
+	SJob*	GetJob(size_t threadIndex);
+
+	void	Execute(SJob* job, size_t threadIndex);
+	void	Finish(SJob* job);
+
+	std::vector<SThreadJobs*>	m_threads;
+	std::vector<std::thread>	m_workers;
+
+	// Idle workers sleep until jobs are queued
+	std::mutex					m_sleepMutex;
+	std::condition_variable		m_sleepCondition;
+	std::atomic<size_t>			m_queuedJobs;
+	std::atomic<size_t>			m_sleepingWorkers;
+	bool						m_exit = false;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <immintrin.h>
 
 
 #define RAD2DEG(x) ((x)*(180.0f/(float)M_PI))
@@ -36,6 +37,13 @@ float Sign(float a);
 
 float Random(float from, float to);
 
+// Sine and cosine of angles in radians, polynomial approximations accurate to a
+// few ulps for angles up to a few thousand radians
+void SIMD_SinCos(__m128 angle, __m128& sin, __m128& cos) noexcept;
+#ifdef __AVX2__
+void SIMD_SinCos(__m256 angle, __m256& sin, __m256& cos) noexcept;
+#endif
+
 struct Vec2
 {
 	float x, y;
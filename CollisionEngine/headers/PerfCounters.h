@@ -0,0 +1,74 @@
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+enum class PerfCounter
+{
+	Cycles = 0,
+	Instructions,
+	L1DataMisses,
+	LastLevelCacheMisses,
+	BranchMisses,
+	// Nanoseconds the thread ran on a CPU, a software counter that also exists without a PMU
+	TaskClock,
+
+	Count,
+};
+
+const char*	GetPerfCounterName(PerfCounter counter);
+
+struct SPerfCounterValues
+{
+	uint64_t	values[(size_t)PerfCounter::Count] = {};
+	// Bit per PerfCounter that could be opened, the others stay at 0
+	uint32_t	availableMask = 0;
+
+	uint64_t	Get(PerfCounter counter) const { return values[(size_t)counter]; }
+	bool		IsAvailable(PerfCounter counter) const { return (availableMask & (1u << (size_t)counter)) != 0; }
+
+	SPerfCounterValues&	operator+=(const SPerfCounterValues& other);
+};
+
+/*
+* Hardware counters of the calling thread, opened as a single group with
+* perf_event_open so that they are all read at once and count the same
+* instructions. Only user space is counted. When the CPU has fewer counters
+* than the group needs, the kernel shares them over time and the values are
+* scaled by the fraction of the time they were counting.
+* Counters only exist on Linux, elsewhere or without access to them (see
+* /proc/sys/kernel/perf_event_paranoid) the group opens no counter. On a
+* machine without a PMU, such as most virtual machines, only the task clock
+* opens and leads the group.
+*/
+class CPerfCounterGroup
+{
+public:
+	CPerfCounterGroup();
+	~CPerfCounterGroup();
+
+	CPerfCounterGroup(const CPerfCounterGroup&) = delete;
+	CPerfCounterGroup& operator=(const CPerfCounterGroup&) = delete;
+
+	bool	IsOpen() const { return m_leader >= 0; }
+
+	// Counts since the group was opened
+	void	Read(SPerfCounterValues& values) const;
+
+	// Group of the calling thread, opened on the first call and closed when the thread exits
+	static const CPerfCounterGroup&	GetThreadGroup();
+
+private:
+	int			m_leader = -1;
+	int			m_fds[(size_t)PerfCounter::Count];
+	// Position of each opened counter in the values read from the group
+	uint32_t	m_readIndices[(size_t)PerfCounter::Count];
+	uint32_t	m_openCount = 0;
+	uint32_t	m_availableMask = 0;
+};
+
+// Counts between two reads of a group
+SPerfCounterValues	operator-(const SPerfCounterValues& end, const SPerfCounterValues& start);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Samples kept per thread, the oldest ones are overwritten
+#define PROFILER_RING_SIZE (64 * 1024)
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Records the time spent until the end of the enclosing block, name must outlive the profiler
+#define PROFILE_SCOPE(name) CProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+struct SProfileSample
+{
+	const char*	name;
+	uint64_t	start;
+	uint64_t	end;
+};
+
+/*
+* Records the scopes run by every thread while it is gVars->pProfiler, with a
+* ring of samples per thread. A thread only writes to its own ring and
+* publishes its samples by moving its write index, recording never locks.
+* Scopes nest, the trace viewer stacks a scope under the ones enclosing it
+* on the same thread.
+* The rings are read without stopping their threads: the trace must be
+* written while no thread records samples, for example between two steps.
+*/
+class CProfiler
+{
+public:
+	CProfiler();
+	~CProfiler();
+
+	CProfiler(const CProfiler&) = delete;
+	CProfiler& operator=(const CProfiler&) = delete;
+
+	// Name of the calling thread in the traces, kept for all the profilers
+	static void	SetThreadName(const char* name);
+
+	// Writes the samples of all the threads in the Chrome trace event format,
+	// to open in chrome://tracing or https://ui.perfetto.dev
+	bool		WriteChromeTrace(const char* path) const;
+
+private:
+	friend class CProfileScope;
+
+	struct SThreadSamples
+	{
+		SProfileSample			samples[PROFILER_RING_SIZE];
+		// Samples written since the thread started recording, the last one is at (writeIndex - 1) % PROFILER_RING_SIZE
+		std::atomic<uint64_t>	writeIndex;
+		uint32_t				threadId;
+		char					threadName[32];
+	};
+
+	// Ring of the calling thread, created by its first sample
+	SThreadSamples*		GetThreadSamples();
+
+	// Distinguishes the profilers in the cache of the threads, a new one can be allocated at the address of a deleted one
+	uint64_t			m_id;
+
+	// Matching readings of the timestamp and of the steady clock to measure the rate of the timestamps
+	uint64_t								m_startTicks;
+	std::chrono::steady_clock::time_point	m_startTime;
+
+	mutable std::mutex				m_threadsMutex;
+	std::vector<SThreadSamples*>	m_threads;
+};
+
+class CProfileScope
+{
+public:
+	explicit CProfileScope(const char* name);
+	~CProfileScope();
+
+	CProfileScope(const CProfileScope&) = delete;
+	CProfileScope& operator=(const CProfileScope&) = delete;
+
+private:
+	// Null if there is no profiler
+	CProfiler::SThreadSamples*	m_samples;
+	const char*					m_name;
+	uint64_t					m_start;
+};
+
+#endif
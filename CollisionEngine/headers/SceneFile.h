@@ -0,0 +1,63 @@
+#ifndef _SCENE_FILE_H_
+#define _SCENE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+class CWorld;
+class CPhysicEngine;
+
+// Read only view of a whole file mapped in memory, pages are read when they are first touched
+class CMappedFile
+{
+public:
+	CMappedFile() = default;
+	~CMappedFile();
+
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	bool			Open(const char* path);
+	void			Close();
+
+	const uint8_t*	GetData() const { return m_data; }
+	size_t			GetSize() const { return m_size; }
+
+private:
+	const uint8_t*	m_data = nullptr;
+	size_t			m_size = 0;
+#ifdef _WIN32
+	void*			m_file = nullptr;
+	void*			m_mapping = nullptr;
+#endif
+};
+
+/*
+* Binary scene: the body columns of CPolygon and the local AABBs of the
+* physic engine stored as they are in memory, and optionally the BVH4 of the
+* dynamic bodies and the one of the static bodies. Every section starts on a cache line so loading is a copy of each
+* section into its column, without any work per body.
+* The file is written in the byte order and with the structure layouts of
+* the machine, the header records the size of the elements and the loading
+* fails on another layout:
+*	- header: "CSCN", version, body count, whether the static BVH4 is stored,
+*	  then the offset, element size and element count of each column in the
+*	  order of CPolygon::ForEachColumn, of the local AABBs, of the BVH4 nodes
+*	  and of the static BVH4 nodes
+*	- the sections, each padded to a multiple of 64 bytes
+* The leaves of the trees are the indices of the bodies in the file.
+*/
+class CSceneFile
+{
+public:
+	// Writes the bodies of the world, with the trees of the last step of the engine if withBVH.
+	// The bodies must not have changed since that step for the trees to match them
+	static bool	Save(const char* path, CWorld& world, const CPhysicEngine& engine, bool withBVH);
+
+	// Appends the bodies of the file to the world. The trees of the file become the trees of
+	// the engine if the world was empty, the next step only replaces the dynamic one. Trees with
+	// a child out of their nodes or a leaf out of the bodies are built again instead
+	static bool	Load(const char* path, CWorld& world, CPhysicEngine& engine);
+};
+
+#endif
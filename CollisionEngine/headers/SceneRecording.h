@@ -0,0 +1,95 @@
+#ifndef _SCENE_RECORDING_H_
+#define _SCENE_RECORDING_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+class CWorld;
+
+// Shape of a body in a recording
+struct SRecordedBody
+{
+	uint8_t		shapeType;
+	uint8_t		fast;
+	uint8_t		isStatic;
+	uint8_t		padding;
+	float		halfExtentX;
+	float		halfExtentY;
+	float		radius;
+};
+
+/*
+* Recordings hold the bodies of a world and their transforms before each
+* step, so that the physic engine can be run again on exactly the same
+* workload whatever moved the bodies: behaviors, the integration of the
+* engine or the mouse. The file is written in the byte order of the machine:
+*	- a header: "CREC", version, body count, fast body count, frame count
+*	- the shape of each body: shape type, fast and static flags, half extents, radius
+*	- for each frame: the time of the step, then the position X, position Y,
+*	  angle and speed columns of all the bodies. The engine sweeps the fast
+*	  bodies with their speed and their times of impact also use the speed of
+*	  the other body
+* The bodies can't change while recording, a frame with another body count
+* stops the recording.
+*/
+class CSceneRecorder
+{
+public:
+	CSceneRecorder() = default;
+	~CSceneRecorder();
+
+	CSceneRecorder(const CSceneRecorder&) = delete;
+	CSceneRecorder& operator=(const CSceneRecorder&) = delete;
+
+	// Writes the bodies of the world, returns false if the file can't be written
+	bool	Start(const char* path, CWorld& world);
+	// Writes the transforms of the bodies before a step of deltaTime
+	bool	RecordFrame(CWorld& world, float deltaTime);
+	// Writes the frame count in the header and closes the file
+	bool	Stop();
+
+	bool	IsRecording() const { return m_file != nullptr; }
+	size_t	GetFrameCount() const { return m_frameCount; }
+
+private:
+	FILE*					m_file = nullptr;
+	size_t					m_bodyCount = 0;
+	size_t					m_frameCount = 0;
+};
+
+/*
+* Plays a recording back: creates its bodies in an empty world, then sets
+* their transforms frame by frame. The bodies don't move between frames,
+* the integration of the engine must be off and the world must not have any
+* behavior.
+*/
+class CSceneReplay
+{
+public:
+	CSceneReplay() = default;
+	~CSceneReplay();
+
+	CSceneReplay(const CSceneReplay&) = delete;
+	CSceneReplay& operator=(const CSceneReplay&) = delete;
+
+	// Reads the header and the bodies, returns false if the file isn't a recording of this version
+	bool	Open(const char* path);
+	void	Close();
+
+	size_t	GetBodyCount() const { return m_bodies.size(); }
+	size_t	GetFrameCount() const { return m_frameCount; }
+
+	// Adds the bodies of the recording to the world, in their recorded order
+	void	CreateBodies(CWorld& world) const;
+	// Sets the transforms of the next frame, returns false after the last one
+	bool	ReadFrame(CWorld& world, float& deltaTime);
+
+private:
+	FILE*						m_file = nullptr;
+	size_t						m_frameCount = 0;
+	size_t						m_nextFrame = 0;
+	std::vector<SRecordedBody>	m_bodies;
+};
+
+#endif
@@ -1,20 +1,36 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#include <Windows.h>
+#include <chrono>
+#include <cstdint>
 
+// Measures durations with the steady clock
 class CTimer
 {
 public:
 	void Start();
 	void Stop();
 
+	// Seconds between Start and Stop
 	float	GetDuration() const;
 
 private:
-	LARGE_INTEGER	m_frequency;
-	LARGE_INTEGER	m_startTime;
-	LARGE_INTEGER	m_stopTime;
+	std::chrono::steady_clock::time_point	m_startTime;
+	std::chrono::steady_clock::time_point	m_stopTime;
 };
 
-#endif
\ No newline at end of file
+/*
+* Timestamps of the profiler. On x86 they are read from the time stamp counter
+* of the CPU, which is several times cheaper than the steady clock. Its rate is
+* constant and shared by all the cores on the CPUs the engine runs on (they
+* have SSE4.1), but unknown: it is measured against the steady clock with
+* GetTimestampFrequency. Other CPUs fall back to the steady clock in
+* nanoseconds.
+*/
+uint64_t	ReadTimestamp();
+
+// Ticks of ReadTimestamp per second, measured between the two points given
+double		GetTimestampFrequency(uint64_t startTicks, std::chrono::steady_clock::time_point startTime,
+								  uint64_t endTicks, std::chrono::steady_clock::time_point endTime);
+
+#endif
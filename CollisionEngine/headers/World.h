@@ -3,6 +3,8 @@
 
 #include <vector>
 
+#include "BodyObserver.h"
+#include "HandleTable.h"
 #include "shapes/Polygon.h"
 #include "shapes/AABB.h"
 #include "behaviors/Behavior.h"
@@ -19,33 +21,57 @@ class CWorld
 {
 public:
 	CWorld()
-		: polygons(CPolygon())
 	{
 
 	}
 
 	~CWorld()
 	{
-		polygons.Destroy();
+		if (m_bodyObserver != nullptr)
+			m_bodyObserver->OnBodiesCleared();
 	}
 
-	size_t			AddRectangle(float width, float height, const Vec2& position);
-	size_t			AddRandomRectangle(const SRandomPolyParams& params);
+	// Set before adding bodies, no observer runs the world headless
+	void			SetBodyObserver(IBodyObserver* observer) { m_bodyObserver = observer; }
+
+	SBodyHandle		AddRectangle(float width, float height, const Vec2& position);
+	SBodyHandle		AddRandomRectangle(const SRandomPolyParams& params);
+	SBodyHandle		AddCircle(float radius, const Vec2& position);
+	SBodyHandle		AddRandomCircle(const SRandomPolyParams& params);
+	SBodyHandle		AddCapsule(float halfLength, float radius, const Vec2& position);
+	SBodyHandle		AddRandomCapsule(const SRandomPolyParams& params);
+
+	// Adds a body with the outline given to the body observer, the shape data is set by the caller
+	SBodyHandle		AddPolygon(const float* pointsX, const float* pointsY, size_t pointCount);
+	// Appends count bodies to the columns in one go and returns the index of the first one. The caller
+	// fills their columns and their local AABBs in the physic engine, then calls NotifyBodiesAdded
+	size_t			AddBodies(size_t count);
+	// Gives the outlines of the bodies, built from their shape columns, to the body observer
+	void			NotifyBodiesAdded(size_t first, size_t count);
+	// Removes the body from all the columns of the world and of the physic engine,
+	// the last body takes its index and the handles of other bodies stay valid
+	void			RemovePolygon(SBodyHandle body);
+	// Static bodies never move and their speeds are cleared, the physic engine builds their tree again
+	// when they change. Moving one afterwards requires CPhysicEngine::InvalidateStaticBVH
+	void			SetStatic(SBodyHandle body, bool isStatic);
+
+	bool			IsValid(SBodyHandle body) const { return m_bodyHandles.IsValid(body); }
+	// Index of the body in the columns of CPolygon, changes when bodies are removed
+	size_t			GetBodyIndex(SBodyHandle body) const { return m_bodyHandles.GetIndex(body); }
+	SBodyHandle		GetBodyHandle(size_t index) const { return m_bodyHandles.GetHandle(index); }
+	const uint32_t*	GetBodySlots() const { return m_bodyHandles.GetSlots(); }
 
-	size_t			AddPolygon();
-	void			RemovePolygon(size_t index);
-
-	// WARNING
 	template<class TBehavior>
-	CBehaviorPtr	AddBehavior(CPolygonPtr poly)
+	CBehaviorPtr	AddBehavior(SBodyHandle body = SBodyHandle())
 	{
 		CBehaviorPtr behavior(new TBehavior());
 		behavior->m_index = m_behaviors.size();
-		behavior->polyIdx = 0;
+		behavior->body = body;
 		m_behaviors.push_back(behavior);
 
 		return behavior;
 	}
+	// Also removes the body of the behavior if it has one
 	void			RemoveBehavior(CBehaviorPtr behavior);
 
 	template<typename TFunctor>
@@ -70,12 +96,15 @@ public:
 	}
 
 	void Update(float frameTime);
-	void RenderPolygons();
 
 	CPolygon& GetPolygons();
 
 protected:
+	SBodyHandle		AddRoundShape(ShapeType type, float halfLength, float radius, const Vec2& position);
+
 	CPolygon polygons;
+	CHandleTable				m_bodyHandles;
+	IBodyObserver*				m_bodyObserver = nullptr;
 	//std::vector<CPolygonPtr>	m_polygons;
 	std::vector<CBehaviorPtr>	m_behaviors;
 };
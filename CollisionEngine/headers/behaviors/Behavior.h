@@ -1,6 +1,7 @@
 #ifndef _BEHAVIOR_H_
 #define _BEHAVIOR_H_
 
+#include "HandleTable.h"
 #include "shapes/Polygon.h"
 
 class CBehavior
@@ -14,7 +15,8 @@ public:
 	virtual ~CBehavior() = default;
 
 	//CPolygonPtr poly;
-	size_t polyIdx;
+	// Body driven by the behavior, null for behaviors acting on the whole world
+	SBodyHandle body;
 
 	virtual void Start(){}
 	virtual void Update(float frameTime){}
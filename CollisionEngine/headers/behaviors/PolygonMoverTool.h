@@ -11,23 +11,21 @@
 class CPolygonMoverTool : public CBehavior
 {
 public:
-	CPolygonMoverTool()
-		: m_selectedPolyIdx(-1)
-	{}
+	CPolygonMoverTool() = default;
 
 private:
-	size_t	GetClickedPolygon()
+	SBodyHandle	GetClickedPolygon()
 	{
 		Vec2 pt, n;
 		Vec2 mousePoint = gVars->pRenderer->ScreenToWorldPos(gVars->pRenderWindow->GetMousePos());
-		size_t clickedPoly = -1;
+		SBodyHandle clickedPoly;
 		CPolygon& poly = gVars->pWorld->GetPolygons();
 
 		gVars->pWorld->ForEachPolygon([&](size_t idx)
 		{
 			if (poly.IsPointInside(idx, mousePoint))
 			{
-				clickedPoly = idx;
+				clickedPoly = gVars->pWorld->GetBodyHandle(idx);
 			}
 		});
 
@@ -39,35 +37,37 @@ private:
 		CPolygon& poly = gVars->pWorld->GetPolygons();
 		if (gVars->pRenderWindow->GetMouseButton(0) || gVars->pRenderWindow->GetMouseButton(2))
 		{
-			if (m_selectedPolyIdx == -1)
+			// The selected body may have been removed since last frame
+			if (!gVars->pWorld->IsValid(m_selectedPoly))
 			{
-				m_selectedPolyIdx = GetClickedPolygon();
+				m_selectedPoly = GetClickedPolygon();
 				m_prevMousePos = gVars->pRenderer->ScreenToWorldPos(gVars->pRenderWindow->GetMousePos());
 				m_translate = gVars->pRenderWindow->GetMouseButton(0);
 				m_clickMousePos = m_prevMousePos;
 
-				if (m_selectedPolyIdx != -1)
-					m_clickAngle = poly.rotation[m_selectedPolyIdx].GetAngle();
+				if (!m_selectedPoly.IsNull())
+					m_clickAngle = poly.GetAngle(gVars->pWorld->GetBodyIndex(m_selectedPoly));
 			}
 			else
 			{
 				Vec2 mousePoint = gVars->pRenderer->ScreenToWorldPos(gVars->pRenderWindow->GetMousePos());
+				size_t selectedPolyIdx = gVars->pWorld->GetBodyIndex(m_selectedPoly);
 
-				Vec2 pos = poly.GetPosition(m_selectedPolyIdx);
+				Vec2 pos = poly.GetPosition(selectedPolyIdx);
 
 				if (m_translate)
 				{
 					Vec2 result = pos + mousePoint - m_prevMousePos;
-					poly.SetPosition(m_selectedPolyIdx, result);
-					poly.speed[m_selectedPolyIdx] = Vec2();
+					poly.SetPosition(selectedPolyIdx, result);
+					poly.speed[selectedPolyIdx] = Vec2();
 				}
 				else
 				{
 					Vec2 from = m_clickMousePos - pos;
 					Vec2 to = mousePoint - pos;
 
-					poly.rotation[m_selectedPolyIdx].SetAngle(m_clickAngle + from.Angle(to));
-					poly.speed[m_selectedPolyIdx] = Vec2();
+					poly.SetAngle(selectedPolyIdx, m_clickAngle + from.Angle(to));
+					poly.speed[selectedPolyIdx] = Vec2();
 				}
 
 				m_prevMousePos = mousePoint;
@@ -75,12 +75,12 @@ private:
 		}
 		else
 		{
-			m_selectedPolyIdx = -1;
+			m_selectedPoly = SBodyHandle();
 		}
 	}
 
 private:
-	size_t		m_selectedPolyIdx;
+	SBodyHandle	m_selectedPoly;
 	bool		m_translate;
 	Vec2		m_prevMousePos;
 	Vec2		m_clickMousePos;
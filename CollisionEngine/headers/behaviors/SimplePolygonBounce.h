@@ -21,44 +21,14 @@ private:
 		//	collision.polyB->speed.Reflect(collision.normal);
 		//});
 
+		// The bodies are moved by the physic engine at the end of its step, bouncing
+		// on the borders of the screen
 		float hWidth = gVars->pRenderer->GetWorldWidth() * 0.5f;
 		float hHeight = gVars->pRenderer->GetWorldHeight() * 0.5f;
 
-		CPolygon& polygons = gVars->pWorld->GetPolygons();
-
-		gVars->pWorld->ForEachPolygon([&](size_t idx)
-		{
-				Vec2 position = polygons.GetPosition(idx);
-				Vec2 speed = polygons.speed[idx];
-
-			position += speed * frameTime;
-			polygons.SetPosition(idx, position);
-
-			if (position.x < -hWidth)
-			{
-				position.x = -hWidth;
-				speed.x *= -1.0f;
-			}
-			else if (position.x > hWidth)
-			{
-				position.x = hWidth;
-				speed.x *= -1.0f;
-			}
-
-			if (position.y < -hHeight)
-			{
-				position.y = -hHeight;
-				speed.y *= -1.0f;
-			}
-			else if (position.y > hHeight)
-			{
-				position.y = hHeight;
-				speed.y *= -1.0f;
-			}
-
-			polygons.SetPosition(idx, position);
-			polygons.speed[idx] = speed;
-		});
+		gVars->pPhysicEngine->integrate = true;
+		gVars->pPhysicEngine->worldBoundsMin = Vec2(-hWidth, -hHeight);
+		gVars->pPhysicEngine->worldBoundsMax = Vec2(hWidth, hHeight);
 	}
 };
 
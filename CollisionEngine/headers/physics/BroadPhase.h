@@ -6,7 +6,8 @@
 class IBroadPhase
 {
 public:
-	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) = 0;
+	// Also fills the broad phase counters of the stats
+	virtual void GetCollidingPairsToCheck(CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats) = 0;
 };
 
 #endif
\ No newline at end of file
@@ -6,10 +6,11 @@
 class CBroadPhaseAABBTree : public IBroadPhase
 {
 public:
-    virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
+    virtual void GetCollidingPairsToCheck(CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats) override;
 
-private:
-    void BVH4TraversalRecurse(size_t polyIndex, const PackedAABB& polyAABBPacked, const Node4* bvh4Nodes, int32_t currentNodeIndex, std::vector<SPolygonPair>& pairsToCheck) const noexcept;
+    // Adds the pairs of polyIndex with the leaves of index firstLeafIndex or higher overlapping its AABB, from the node
+    // currentNodeIndex, and adds the nodes it visits and the leaves it hits to the stats
+    void BVH4TraversalRecurse(size_t polyIndex, size_t firstLeafIndex, const PackedAABB& polyAABBPacked, const Node4* bvh4Nodes, int32_t currentNodeIndex, CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats) const noexcept;
 };
 
 #endif
\ No newline at end of file
@@ -10,13 +10,24 @@
 class CBroadPhaseBrut : public IBroadPhase
 {
 public:
-	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
+	virtual void GetCollidingPairsToCheck(CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats) override
 	{
+		// No tree and no AABB test, every pair is a candidate
+		stats.nodesVisited = 0;
+		stats.aabbTests = 0;
+		stats.leafHits = 0;
+
+		const CPolygon& poly = gVars->pWorld->GetPolygons();
+
 		for (size_t i = 0; i < gVars->pWorld->GetPolygonCount(); ++i)
 		{
 			for (size_t j = i + 1; j < gVars->pWorld->GetPolygonCount(); ++j)
 			{
-				pairsToCheck.push_back(SPolygonPair(i, j));
+				// Static bodies never collide together
+				if (poly.isStatic[i] && poly.isStatic[j])
+					continue;
+
+				pairsToCheck.PushBack(SPolygonPair(i, j));
 			}
 		}
 	}
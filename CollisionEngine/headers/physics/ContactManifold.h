@@ -0,0 +1,101 @@
+#ifndef _CONTACT_MANIFOLD_H_
+#define _CONTACT_MANIFOLD_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "Maths.h"
+#include "physics/PairTable.h"
+
+class CPolygon;
+
+#define MAX_MANIFOLD_POINTS 2
+
+/*
+* Feature IDs identify a contact point by the features of the two boxes that
+* created it so that it can be found again next frame:
+* 	- bits 0-7: face of the reference box the points were clipped against
+* 	- bits 8-15: vertex of the incident box, or side of the reference face
+* 	  that clipped the incident edge
+* 	- bit 16: set if the point was created by clipping
+* 	- bit 17: set if the reference box is body B
+*/
+#define FEATURE_CLIPPED (1 << 16)
+#define FEATURE_FLIPPED (1 << 17)
+
+// Contact points between two bodies, used to add a manifold to the cache
+struct SContactManifold
+{
+	size_t		polyA;
+	size_t		polyB;
+
+	// Points from A to B
+	Vec2		normal;
+
+	size_t		pointCount = 0;
+	Vec2		points[MAX_MANIFOLD_POINTS];
+	// Negative when the bodies overlap
+	float		separations[MAX_MANIFOLD_POINTS];
+	uint32_t	featureIds[MAX_MANIFOLD_POINTS];
+};
+
+// Contact manifold of two overlapping boxes built by clipping the incident face of one box against
+// the reference face of the other, returns false if the boxes don't overlap
+bool	BuildOBBManifold(const CPolygon& poly, size_t polyA, size_t polyB, SContactManifold& manifold);
+
+/*
+* Contact manifolds of the current frame in SoA layout so that a solver can
+* stream through them. Manifolds are kept from one frame to the next: when a
+* manifold is added, its points are matched by feature ID with the points the
+* same pair of bodies had last frame and get their accumulated impulses back
+* to warm start the solver.
+*/
+class CManifoldCache
+{
+public:
+	struct SColumns
+	{
+		// One entry per manifold
+		std::vector<uint64_t>	pairKey;
+		std::vector<uint32_t>	polyA;
+		std::vector<uint32_t>	polyB;
+		std::vector<float>		normalX;
+		std::vector<float>		normalY;
+		std::vector<uint32_t>	firstContact;
+		std::vector<uint32_t>	contactCount;
+
+		// One entry per contact point, the points of a manifold are contiguous
+		std::vector<float>		pointX;
+		std::vector<float>		pointY;
+		std::vector<float>		separation;
+		std::vector<uint32_t>	featureId;
+		std::vector<float>		normalImpulse;
+		std::vector<float>		tangentImpulse;
+
+		void	Clear();
+	};
+
+	// Keeps the manifolds of the last frame for matching and starts a new frame
+	void	BeginFrame();
+	// The pair key must not depend on the index of the bodies, which changes when bodies are removed
+	void	AddManifold(const SContactManifold& manifold, uint64_t pairKey);
+
+	size_t	GetManifoldCount() const { return m_current.polyA.size(); }
+	size_t	GetContactCount() const { return m_current.pointX.size(); }
+	// Contacts of the current frame that got impulses from the last frame
+	size_t	GetWarmStartedCount() const { return m_warmStartedCount; }
+
+	// The solver writes the accumulated impulses back in the columns
+	SColumns&		GetColumns() { return m_current; }
+	const SColumns&	GetColumns() const { return m_current; }
+
+private:
+	SColumns				m_current;
+	SColumns				m_previous;
+
+	// Index of the manifold of each pair of bodies in m_previous
+	CPairTable<uint32_t>	m_previousManifolds;
+	size_t					m_warmStartedCount = 0;
+};
+
+#endif
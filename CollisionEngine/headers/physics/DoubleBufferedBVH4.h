@@ -0,0 +1,81 @@
+#ifndef _DOUBLE_BUFFERED_BVH4_H_
+#define _DOUBLE_BUFFERED_BVH4_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "AlignedArray.h"
+#include "shapes/AABB.h"
+
+// Nodes of a BVH4, the array only grows so that building a tree of the same size again constructs nothing
+struct SBVH4Tree
+{
+	CAlignedArray<Node4>	nodes;
+	size_t					nodeCount = 0;
+};
+
+/*
+* Two BVH4 trees, the front one being the last complete tree and the back one
+* the tree being built. Readers on other threads query the front tree without
+* waiting for the build of the next one, which swaps the trees when it is done:
+*	- the epoch counts the swaps, the front tree is trees[epoch & 1]
+*	- a reader increments the reader count of the front tree then checks that
+*	  the epoch didn't change meanwhile, otherwise it tries again on the new
+*	  front tree
+*	- the builder waits until the back tree has no reader left, which only
+*	  happens when a reader is slower than a whole build, and increments the
+*	  epoch once the tree is written
+* Only one thread builds, the stepping thread may read the front tree without
+* acquiring it since it is the only one to replace it.
+*/
+class CDoubleBufferedBVH4
+{
+public:
+	CDoubleBufferedBVH4();
+
+	CDoubleBufferedBVH4(const CDoubleBufferedBVH4&) = delete;
+	CDoubleBufferedBVH4& operator=(const CDoubleBufferedBVH4&) = delete;
+
+	// Front tree for the building thread
+	const SBVH4Tree&	GetFront() const { return m_trees[m_epoch.load(std::memory_order_relaxed) & 1]; }
+	uint32_t			GetEpoch() const { return m_epoch.load(std::memory_order_acquire); }
+
+	// Front tree for any thread, it isn't replaced until the matching Release
+	const SBVH4Tree&	Acquire() const;
+	void				Release(const SBVH4Tree& tree) const;
+
+	// Back tree with room for nodeCapacity nodes, once no reader is left on it
+	SBVH4Tree&			BeginBuild(size_t nodeCapacity);
+	// Makes the back tree the front tree
+	void				EndBuild();
+
+	// Replaces the front tree with an empty one
+	void				Clear();
+
+private:
+	SBVH4Tree						m_trees[2];
+	std::atomic<uint32_t>			m_epoch;
+	mutable std::atomic<uint32_t>	m_readers[2];
+};
+
+// Holds the front tree of a CDoubleBufferedBVH4 for the scope
+class CBVH4ReadLock
+{
+public:
+	CBVH4ReadLock(const CDoubleBufferedBVH4& bvh) : m_bvh(bvh), m_tree(bvh.Acquire()) {}
+	~CBVH4ReadLock() { m_bvh.Release(m_tree); }
+
+	CBVH4ReadLock(const CBVH4ReadLock&) = delete;
+	CBVH4ReadLock& operator=(const CBVH4ReadLock&) = delete;
+
+	const SBVH4Tree&	GetTree() const { return m_tree; }
+	const Node4*		GetNodes() const { return m_tree.nodes.Data(); }
+	size_t				GetNodeCount() const { return m_tree.nodeCount; }
+
+private:
+	const CDoubleBufferedBVH4&	m_bvh;
+	const SBVH4Tree&			m_tree;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _PAIR_GATHER_H_
+#define _PAIR_GATHER_H_
+
+#include <vector>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "AlignedArray.h"
+#include "physics/PhysicEngine.h"
+#include "physics/ShapeKernels.h"
+
+/*
+* Gather stage of the narrow phase: copies the transforms and dimensions of the
+* bodies of each pair into contiguous SoA columns, so that the test kernels only
+* do aligned loads and the random memory accesses happen here and can be timed
+* on their own.
+* Pairs are given as buckets (one per kernel), each bucket starts on a new block
+* of 4 pairs so that a block never mixes two kernels. Incomplete blocks are
+* padded by repeating the last pair of the bucket.
+*/
+class CPairGather
+{
+public:
+	void		Gather(const CPolygon& poly, const SSpan<const SPolygonPair>* buckets, size_t bucketCount);
+
+	// Range of blocks holding the pairs of a bucket
+	size_t		GetFirstBlock(size_t bucket) const { return m_bucketFirstBlock[bucket]; }
+	size_t		GetEndBlock(size_t bucket) const { return m_bucketFirstBlock[bucket + 1]; }
+
+	// Bodies A and B of the 4 pairs of a block
+	SBodyBatch	GetBatchA(size_t block) const noexcept { return GetBatch(0, block); }
+	SBodyBatch	GetBatchB(size_t block) const noexcept { return GetBatch(1, block); }
+
+private:
+	enum Column
+	{
+		PosX = 0,
+		PosY,
+		Cos,
+		Sin,
+		ExtentX,
+		ExtentY,
+		Radius,
+
+		ColumnCount,
+	};
+
+	float*		GetColumn(size_t side, Column column) noexcept;
+	SBodyBatch	GetBatch(size_t side, size_t block) const noexcept;
+
+	void		GatherSide(const CPolygon& poly, size_t side, const int32_t* indices);
+
+	std::vector<size_t>		m_bucketFirstBlock;
+	std::vector<int32_t>	m_indicesA;
+	std::vector<int32_t>	m_indicesB;
+
+	// All columns of side A then all columns of side B, each holding m_blockCount blocks of 4 floats
+	CAlignedArray<float>	m_columns;
+	size_t					m_blockCount = 0;
+};
+
+#endif
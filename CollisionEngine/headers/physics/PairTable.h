@@ -0,0 +1,89 @@
+#ifndef _PAIR_TABLE_H_
+#define _PAIR_TABLE_H_
+
+#include <vector>
+#include <cstdint>
+
+/*
+* Open addressing hash table from an ordered pair of bodies to a value, used to
+* carry per pair data from one frame to the next. It is rebuilt every frame from
+* the pairs of the broad phase: Clear() keeps the memory so that no allocation
+* happens once the table has grown, and lookups are safe from several threads as
+* long as nobody inserts at the same time.
+*/
+template<typename TValue>
+class CPairTable
+{
+public:
+	static uint64_t	MakeKey(size_t polyA, size_t polyB)
+	{
+		return ((uint64_t)polyA << 32) | (uint32_t)polyB;
+	}
+
+	// Empties the table and makes room for pairCount pairs with a load factor of at most 1/2
+	void	Clear(size_t pairCount)
+	{
+		size_t capacity = 16;
+		while (capacity < pairCount * 2)
+			capacity *= 2;
+
+		m_keys.assign(capacity, uint64_t(EmptyKey));
+		m_values.resize(capacity);
+		m_count = 0;
+	}
+
+	void	Insert(uint64_t key, const TValue& value)
+	{
+		size_t slot = FindSlot(key);
+		if (m_keys[slot] == EmptyKey)
+		{
+			m_keys[slot] = key;
+			m_count++;
+		}
+		m_values[slot] = value;
+	}
+
+	const TValue*	Find(uint64_t key) const
+	{
+		if (m_keys.empty())
+			return nullptr;
+
+		size_t slot = FindSlot(key);
+		return m_keys[slot] == EmptyKey ? nullptr : &m_values[slot];
+	}
+
+	size_t	GetCount() const { return m_count; }
+
+private:
+	static constexpr uint64_t EmptyKey = ~(uint64_t)0;
+
+	// Linear probing from the hashed key, the table is never full so this ends on
+	// the slot holding the key or on the empty slot where it should be inserted
+	size_t	FindSlot(uint64_t key) const
+	{
+		const size_t mask = m_keys.size() - 1;
+
+		size_t slot = (size_t)Hash(key) & mask;
+		while (m_keys[slot] != key && m_keys[slot] != EmptyKey)
+			slot = (slot + 1) & mask;
+
+		return slot;
+	}
+
+	// Finalizer of MurmurHash3, mixes the bits of both indices
+	static uint64_t	Hash(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
+	std::vector<uint64_t>	m_keys;
+	std::vector<TValue>		m_values;
+	size_t					m_count = 0;
+};
+
+#endif
@@ -4,10 +4,18 @@
 #include <vector>
 #include <unordered_map>
 #include "Maths.h"
+#include "FrameArena.h"
+#include "PerfCounters.h"
 #include "shapes/Polygon.h"
 #include "shapes/AABB.h"
+#include "physics/PairTable.h"
+#include "physics/ContactManifold.h"
+#include "physics/DoubleBufferedBVH4.h"
 
 class IBroadPhase;
+class CPairGather;
+class CJobSystem;
+struct SJobSystemConfig;
 
 struct SPolygonPair
 {
@@ -20,26 +28,115 @@ struct SPolygonPair
 struct SCollision
 {
 	SCollision() = default;
-	SCollision(CPolygonPtr _polyA, CPolygonPtr _polyB, Vec2	_point, Vec2 _normal, float _distance)
+	SCollision(size_t _polyA, size_t _polyB) : polyA(_polyA), polyB(_polyB){}
+	SCollision(size_t _polyA, size_t _polyB, Vec2	_point, Vec2 _normal, float _distance)
 		: polyA(_polyA), polyB(_polyB), point(_point), normal(_normal), distance(_distance){}
 
-	CPolygonPtr	polyA, polyB;
+	// Indices of the colliding bodies in the world polygons
+	size_t	polyA = 0;
+	size_t	polyB = 0;
 
 	Vec2	point;
 	Vec2	normal;
-	float	distance;
+	float	distance = 0.0f;
 };
 
+// First contact of a pair involving a fast body during the step
+struct STimeOfImpact
+{
+	STimeOfImpact(size_t _polyA, size_t _polyB, float _time, Vec2 _normal)
+		: polyA(_polyA), polyB(_polyB), time(_time), normal(_normal){}
+
+	size_t	polyA;
+	size_t	polyB;
+
+	// Fraction of the step at which the bodies touch, in [0, 1]
+	float	time;
+	// Contact normal pointing from polyA to polyB
+	Vec2	normal;
+};
+
+// Separation of two bodies and their closest points
+struct SBodyDistance
+{
+	// Null if the bodies overlap
+	float	distance = 0.0f;
+	Vec2	pointA;
+	Vec2	pointB;
+};
+
+// Closest body AABB crossed by a ray
+struct SRaycastHit
+{
+	// Index of the body in the world polygons
+	size_t	polyIndex = 0;
+	// Along the ray, in lengths of its direction, null if the origin is inside the AABB
+	float	distance = 0.0f;
+};
+
+// Work done by the last step and quality of its BVH, counted at every step
+struct SPhysicStats
+{
+	// Broad phase, one traversal of the dynamic BVH4 and one of the static BVH4 per dynamic body
+	size_t	nodesVisited = 0;
+	// 4 per visited node, the packed test also runs on the empty children
+	size_t	aabbTests = 0;
+	// Leaves overlapping the body AABB, including the body itself and the pairs reported by the other body
+	size_t	leafHits = 0;
+	size_t	candidatePairs = 0;
+
+	// Narrow phase, box pairs run through the full SAT test, the others left on their cached axis
+	size_t	obbTests = 0;
+	size_t	collisions = 0;
+
+	// Dynamic BVH4, expected nodes visited plus leaves hit by a point query spread uniformly over the root AABB
+	float	sahCost = 0.0f;
+	size_t	depth = 0;
+	// Children per node, out of 4
+	float	averageNodeFill = 0.0f;
+	// Sum of the intersection areas of the children of each node, children that overlap are both visited
+	float	siblingOverlapArea = 0.0f;
+
+	// Candidate pairs of the broad phase that don't collide
+	float	GetFalsePositiveRate() const { return candidatePairs > 0 ? (float)(candidatePairs - collisions) / (float)candidatePairs : 0.0f; }
+};
+
+// Stages of CPhysicEngine::Step, in the order of their dependencies
+enum class StepStage
+{
+	WorldAABBs = 0,
+	BVH,
+	BroadPhase,
+	Gather,
+	NarrowPhase,
+	ContactManifolds,
+	Continuous,
+	Integration,
+
+	Count,
+};
+
+const char*	GetStepStageName(StepStage stage);
+
 class CPhysicEngine
 {
 public:
 	void	Reset();
 	void	Activate(bool active);
 
-	void	DetectCollisions();
-
 	void	Step(float deltaTime);
 
+	// Recreates the threads running the step, the default config uses all the hardware threads
+	void	SetJobSystemConfig(const SJobSystemConfig& config);
+	size_t	GetThreadCount() const;
+
+	// Duration of a stage during the last step, in seconds
+	float	GetStageDuration(StepStage stage) const { return m_stepStages[(size_t)stage].duration; }
+	// Hardware counters of a stage during the last step, if usePerfCounters. They only count the thread
+	// running the stage, not the jobs it splits over the other threads unless there are no workers
+	const SPerfCounterValues&	GetStagePerfCounters(StepStage stage) const { return m_stepStages[(size_t)stage].perfCounters; }
+	SPerfCounterValues			GetStepPerfCounters() const;
+
 	template<typename TFunctor>
 	void	ForEachCollision(TFunctor functor)
 	{
@@ -49,24 +146,166 @@ public:
 		}
 	}
 
+	template<typename TFunctor>
+	void	ForEachTimeOfImpact(TFunctor functor)
+	{
+		for (const STimeOfImpact& timeOfImpact : m_timesOfImpact)
+		{
+			functor(timeOfImpact);
+		}
+	}
+
+	// Distance queries on the current positions of the bodies, with the same SIMD kernel for
+	// both so that the batched version gives the same results, only faster per pair.
+	// ComputeDistances gathers the pairs in m_queryGather and tests them on the job system, so it
+	// must not run while Step does: with a CPhysicThread, call it with the world mutex held
+	SBodyDistance	ComputeDistance(size_t polyA, size_t polyB) const;
+	void			ComputeDistances(const std::vector<SPolygonPair>& pairs, std::vector<SBodyDistance>& distances);
+
+	// Contact manifolds of the colliding boxes, with the impulses accumulated last frame
+	CManifoldCache&	GetManifolds() { return m_manifolds; }
+	const CManifoldCache&	GetManifolds() const { return m_manifolds; }
+
 	void AddLocalAABB(const AABB& aabb);
+	void AddLocalAABBs(const AABB* aabbs, size_t count);
 	void RemoveLocalAABB(size_t index);
+	const AABB* GetLocalAABBs() const { return m_localAABBs.data(); }
+	// World AABB of the body during the last step, swept over its motion for fast bodies
 	const AABB& GetWorldAABB(size_t index) const { return m_worldAABBs[index]; }
-	const Node4* GetBVH4Nodes() const { return m_bvh4Nodes.data(); }
+	// Trees of the last complete step, for the thread stepping the engine
+	const Node4* GetBVH4Nodes() const { return m_bvh4.GetFront().nodes.Data(); }
+	size_t GetBVH4NodeCount() const { return m_bvh4.GetFront().nodeCount; }
+	// Tree of the current bodies built beforehand, for example loaded with them. It is
+	// the tree of the engine until the next step builds one from the moved bodies
+	void SetBVH4(const Node4* nodes, size_t nodeCount);
+	// Builds the trees of the bodies where they are, outside of a step, for example to save
+	// them with the bodies. The results of the last step are cleared
+	void BuildBVH4();
+
+	/*
+	* Static bodies are kept in their own BVH4, built once when the engine
+	* steps after they changed, and the tree built at every step only holds
+	* the dynamic bodies. The broad phase queries both trees with each dynamic
+	* body, static bodies are never paired together.
+	*/
+	const Node4* GetStaticBVH4Nodes() const { return m_staticBVH4.GetFront().nodes.Data(); }
+	size_t GetStaticBVH4NodeCount() const { return m_staticBVH4.GetFront().nodeCount; }
+	bool IsStaticBVHValid() const { return m_staticBVHValid; }
+	// Builds the static tree again at the next step, after static bodies were added, removed or moved
+	void InvalidateStaticBVH() { m_staticBVHValid = false; }
+	// Static tree of the current bodies built beforehand, for example loaded with them
+	void SetStaticBVH4(const Node4* nodes, size_t nodeCount);
+
+	/*
+	* Both trees are double buffered, other threads query the last complete
+	* trees with a CBVH4ReadLock while the step builds the next ones, and only
+	* wait if they hold a tree for longer than a whole step.
+	*/
+	const CDoubleBufferedBVH4& GetBVH4() const { return m_bvh4; }
+	const CDoubleBufferedBVH4& GetStaticBVH4() const { return m_staticBVH4; }
+
+	// Closest body whose leaf AABB in the trees of the last complete step is crossed by the ray
+	// before maxDistance lengths of direction. Safe from any thread, even while the engine steps,
+	// but the AABBs are the ones of the step that built the trees, not the exact shapes
+	bool	Raycast(const Vec2& origin, const Vec2& direction, float maxDistance, SRaycastHit& hit) const;
+
+	size_t	GetCollisionCount() const { return m_collidingPairs.Size(); }
+	size_t	GetTimeOfImpactCount() const { return m_timesOfImpact.Size(); }
+	// Pairs of the broad phase with these shapes, in either order
+	size_t	GetShapePairCount(ShapeType typeA, ShapeType typeB) const;
+	// Box pairs rejected by their cached separating axis during the last step
+	size_t	GetAxisCacheExits() const { return m_axisCacheExits; }
+
+	// Counters of the broad and narrow phases and BVH metrics of the last step
+	const SPhysicStats&	GetStats() const { return m_stats; }
+
+	// Memory of the buffers that only live for one step
+	const CFrameArena&	GetFrameArena() const { return m_frameArena; }
 
 	bool useSAH = true;
+	// Keep the colliding pairs in the order of the shape buckets whatever thread tested them
+	bool stableCollisionOrder = true;
+	// Test box pairs against the axis that separated them last frame before running the full SAT test
+	bool useSeparatingAxisCache = true;
+	// Move the bodies by their speeds at the end of the step, they bounce on the world bounds
+	// and bodies hit by a fast body stop at their time of impact. Off after a reset
+	bool integrate = false;
+	// Read the hardware counters around each stage, see CPerfCounterGroup
+	bool usePerfCounters = false;
+	Vec2 worldBoundsMin;
+	Vec2 worldBoundsMax;
 
 private:
 	friend class CPenetrationVelocitySolver;
+	// Runs the stages one by one to time them
+	friend class CBenchmarkScene;
+
+	// Range of gathered blocks of a single bucket tested as one task of the narrow phase
+	struct SNarrowPhaseChunk
+	{
+		size_t	bucket;
+		size_t	firstBlock;
+		size_t	endBlock;
+
+		// Where the colliding pairs of the chunk were written in the thread outputs
+		size_t	thread;
+		size_t	outputOffset;
+		size_t	outputCount;
+	};
+
+	// Colliding pairs found by a thread, padded so that threads don't write to the same cache line
+	struct SThreadCollisions
+	{
+		std::vector<SCollision>	collisions;
+		// Box pairs rejected by their cached separating axis
+		size_t					axisCacheExits = 0;
+		// Box pairs run through the full SAT test
+		size_t					obbTests = 0;
+		char					padding[64];
+	};
 
+	// Job running a stage of the step and timing it
+	struct SStepStageJob
+	{
+		CPhysicEngine*			engine;
+		void					(CPhysicEngine::*function)();
+		// Name of the stage in the profiler
+		const char*				name;
+		float					duration;
+		SPerfCounterValues		perfCounters;
+	};
+
+	static void					RunStepStage(void* context, size_t begin, size_t end, size_t threadIndex);
+
+	void						ComputeWorldAABBs();
 	void						BuildAABBTree();
+	void						BuildStaticAABBTree();
+	// Builds the BVH4 of the leaves into bvh4Nodes, which has room for GetBVH4NodeCapacity(leafCount) nodes,
+	// and returns its node count. The leaves are sorted in place
+	int32_t						BuildBVH4FromLeaves(Leaf* xSortedLeaves, Leaf* ySortedLeaves, size_t leafCount, Node4* bvh4Nodes);
+	static size_t				GetBVH4NodeCapacity(size_t leafCount) { return leafCount > 1 ? leafCount - 1 : 1; }
 	int32_t						BVH2Recurse(Node2* nodes, int32_t& newNodeIndex, Leaf* xSortedLeaves, Leaf* ySortedLeaves, size_t leafCount);
 	int32_t						BVH2ToBVH4(Node2* bvh2Nodes, int32_t currentNode2Index, Node4* bvh4Nodes, int32_t& newNode4Index);
-	static void					DrawBVH2(const Node2* nodes, const size_t nodeCount);
-	static void					DrawBVH4(const Node4* nodes, const size_t nodeCount);
+	void						ComputeBVHStats();
+
+	// Frees the buffers of the last step, they stay readable until the next one starts
+	void						ResetFrameBuffers();
 
 	void						CollisionBroadPhase();
+	void						CollisionGather();
 	void						CollisionNarrowPhase();
+	void						BucketPairsByShape();
+	SSpan<const SPolygonPair>	GetShapePairBucket(size_t bucket) const;
+	void						NarrowPhaseChunk(const SNarrowPhaseChunk& chunk, SThreadCollisions& output);
+	template<typename TKernel>
+	void						NarrowPhaseBlocks(const SNarrowPhaseChunk& chunk, TKernel kernel, std::vector<SCollision>& output) const;
+	void						NarrowPhaseOBBBlocks(const SNarrowPhaseChunk& chunk, SThreadCollisions& output);
+	void						MergeCollisions();
+	void						UpdateSeparatingAxisCache();
+	void						CollisionContinuous();
+	void						BuildContactManifolds();
+
+	void						Integrate();
 
 	bool						SIMD_Set_OBBCollisionTest(CPolygonPtr p1, CPolygonPtr p2) const noexcept;
 	bool						SISD_OBBCollisionTest(CPolygonPtr p1, CPolygonPtr p2) const noexcept;
@@ -74,18 +313,64 @@ private:
 	bool						SIMD_Shuffle_OBBCollisionTest(__m128 pos, __m128 extent, __m128 rotX, __m128 rotY) const noexcept;
 
 	bool						m_active = true;
+	float						m_stepTime = 0.0f;
+
+	// Written by the BVH, broad phase and narrow phase stages, which run one after the other
+	SPhysicStats				m_stats;
+
+	// Buffers rebuilt every step are allocated from the frame arena, it must be declared first
+	CFrameArena					m_frameArena;
 
 	// Collision detection
 	IBroadPhase*				m_broadPhase;
-	std::vector<SPolygonPair>	m_pairsToCheck;
-	std::vector<SCollision>		m_collidingPairs;
+	CFrameArray<SPolygonPair>	m_pairsToCheck{ m_frameArena };
+	CFrameArray<SCollision>		m_collidingPairs{ m_frameArena };
+
+	// Pairs to check sorted by shape types so each bucket runs a single kernel, bucket
+	// typeA * ShapeType::Count + typeB with typeA <= typeB starts at its offset
+	CFrameArray<SPolygonPair>	m_shapePairs{ m_frameArena };
+	size_t						m_shapePairBucketOffsets[(size_t)ShapeType::Count * (size_t)ShapeType::Count + 1] = {};
+	CPairGather*				m_pairGather = nullptr;
+
+	CJobSystem*						m_jobSystem = nullptr;
+	SStepStageJob					m_stepStages[(size_t)StepStage::Count] = {};
+	CFrameArray<SNarrowPhaseChunk>	m_narrowPhaseChunks{ m_frameArena };
+	// Each thread appends to its own output, they keep their capacity from one step to the next instead of growing in the frame arena
+	std::vector<SThreadCollisions>	m_threadCollisions;
+	CFrameArray<size_t>				m_mergeOffsets{ m_frameArena };
+
+	// OBBAxis with the largest separation of each box pair last frame, and of the
+	// box pairs of the current frame in the order of their bucket
+	CPairTable<uint8_t>				m_separatingAxisCache;
+	CFrameArray<uint8_t>			m_obbPairAxes{ m_frameArena };
+	size_t							m_axisCacheExits = 0;
+
+	// Continuous collision detection of the pairs involving fast bodies
+	CFrameArray<SPolygonPair>		m_ccdPairs{ m_frameArena };
+	CPairGather*					m_ccdGather = nullptr;
+	CFrameArray<STimeOfImpact>		m_timesOfImpact{ m_frameArena };
+
+	// First time of impact of each body during the step and its normal, padded to blocks of 4 bodies
+	CFrameArray<float>				m_bodyTimesOfImpact{ m_frameArena };
+	CFrameArray<Vec2>				m_bodyImpactNormals{ m_frameArena };
+
+	CManifoldCache					m_manifolds;
+
+	CPairGather*					m_queryGather = nullptr;
 
 	std::vector<AABB> m_localAABBs;
-	std::vector<AABB> m_worldAABBs;
-	std::vector<Leaf> m_xSortedLeaves;
-	std::vector<Leaf> m_ySortedLeaves;
-	std::vector<Node2> m_bvh2Nodes;
-	std::vector<Node4> m_bvh4Nodes;
+	CFrameArray<AABB> m_worldAABBs{ m_frameArena };
+	// World AABBs of the static bodies when their tree was built, copied at every step
+	std::vector<AABB> m_staticWorldAABBs;
+	CFrameArray<Leaf> m_xSortedLeaves{ m_frameArena };
+	CFrameArray<Leaf> m_ySortedLeaves{ m_frameArena };
+	CFrameArray<Node2> m_bvh2Nodes{ m_frameArena };
+	// Not in the frame arena so that other threads keep reading it during the next step
+	CDoubleBufferedBVH4 m_bvh4;
+
+	// Tree of the static bodies, kept from one step to the next
+	CDoubleBufferedBVH4 m_staticBVH4;
+	bool m_staticBVHValid = false;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef _PHYSIC_THREAD_H_
+#define _PHYSIC_THREAD_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "Maths.h"
+
+// Transforms of the bodies at the end of a tick and at the end of the tick
+// before, so that the renderer can interpolate between them, and the contact
+// points found during the tick
+struct SPhysicSnapshot
+{
+	std::chrono::steady_clock::time_point	time;
+	size_t				bodyCount = 0;
+
+	std::vector<float>	positionX;
+	std::vector<float>	positionY;
+	std::vector<float>	angle;
+
+	std::vector<float>	previousPositionX;
+	std::vector<float>	previousPositionY;
+	std::vector<float>	previousAngle;
+
+	std::vector<float>	contactX;
+	std::vector<float>	contactY;
+
+	// alpha is 0 for the previous tick and 1 for the last one
+	Vec2	GetPosition(size_t index, float alpha) const;
+	float	GetAngle(size_t index, float alpha) const;
+};
+
+/*
+* Runs the physic engine on its own thread at a fixed tick so that the
+* render thread doesn't wait for the step. The world and the physic engine
+* are shared: other threads must hold the world lock while using them, the
+* physics thread takes it for the length of a step.
+* Each tick publishes a snapshot of the bodies. There are two of them: the
+* renderer reads the last one published while the physics thread writes
+* the other. A tick ending while the renderer still reads the older one
+* doesn't publish, the renderer never waits for the physics thread.
+*/
+class CPhysicThread
+{
+public:
+	explicit CPhysicThread(float tickTime = 1.0f / 60.0f);
+	~CPhysicThread();
+
+	void	Start();
+	void	Stop();
+	bool	IsRunning() const { return m_running; }
+
+	float	GetTickTime() const { return m_tickTime; }
+
+	std::mutex&		GetWorldMutex() { return m_worldMutex; }
+
+	// Last snapshot published, null before the first tick. It stays valid until
+	// ReleaseSnapshot, alpha is where the current time falls between its two ticks
+	const SPhysicSnapshot*	AcquireSnapshot(float& alpha);
+	void					ReleaseSnapshot();
+
+private:
+	void	ThreadLoop();
+	void	Tick();
+
+	std::thread			m_thread;
+	std::atomic<bool>	m_running;
+	float				m_tickTime;
+
+	std::mutex			m_worldMutex;
+
+	SPhysicSnapshot		m_snapshots[2];
+	std::mutex			m_snapshotMutex;
+	// Last published snapshot and the one the renderer reads, -1 for none
+	int					m_frontSnapshot = -1;
+	int					m_readSnapshot = -1;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _SHAPE_KERNELS_H_
+#define _SHAPE_KERNELS_H_
+
+#include <immintrin.h>
+
+// Transforms and dimensions of 4 bodies in SoA layout, one body per lane.
+// The rotation is stored as the X axis of the body (cos, sin), the Y axis
+// being (-sin, cos)
+struct SBodyBatch
+{
+	__m128 posX, posY;
+	__m128 cos, sin;
+	__m128 extentX, extentY;
+	__m128 radius;
+};
+
+// SAT axes of an OBB-OBB pair, the X and Y axes of box A then of box B
+enum class OBBAxis : int
+{
+	AX = 0,
+	AY,
+	BX,
+	BY,
+};
+
+/*
+* Pairwise overlap tests between 4 pairs of bodies at once, lane i of the first
+* batch is tested against lane i of the second one. All the tests return a mask
+* with bit i set if the bodies in lane i overlap.
+*/
+
+int SIMD_OBBOBBTest(const SBodyBatch& boxA, const SBodyBatch& boxB) noexcept;
+// Also writes the OBBAxis of each lane with the largest separation, which is a separating
+// axis for separated boxes and the axis of least penetration for overlapping ones
+int SIMD_OBBOBBTest(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128i& axis) noexcept;
+// Projects the boxes on a single OBBAxis per lane, a bit is cleared if that axis separates the
+// boxes of the lane, a set bit is inconclusive unless the 4 axes were tested
+int SIMD_OBBOBBAxisTest(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128i axis) noexcept;
+int SIMD_CircleCircleTest(const SBodyBatch& circleA, const SBodyBatch& circleB) noexcept;
+int SIMD_CircleOBBTest(const SBodyBatch& circle, const SBodyBatch& box) noexcept;
+int SIMD_CapsuleOBBTest(const SBodyBatch& capsule, const SBodyBatch& box) noexcept;
+// Circles are capsules with a null half length so this also tests circle-capsule pairs
+int SIMD_CapsuleCapsuleTest(const SBodyBatch& capsuleA, const SBodyBatch& capsuleB) noexcept;
+
+// Distance between the bodies of each lane, any shape being a rounded box. Also writes the closest
+// points of A and B, for overlapping bodies the distance is 0 and both points are the middle of the
+// closest points of their cores which is only an approximation of the contact
+__m128 SIMD_DistanceTest(const SBodyBatch& bodyA, const SBodyBatch& bodyB,
+						 __m128& pointAX, __m128& pointAY, __m128& pointBX, __m128& pointBY) noexcept;
+
+// Time of impact of boxes moving without rotation, box B moving by (moveX, moveY) relative to
+// box A over the step. Bit i is set if the boxes of lane i start touching during the step, in
+// which case toi is the fraction of the step at which they touch and normal the contact normal
+// pointing from A to B. Boxes already overlapping at the start of the step are not reported
+int SIMD_OBBOBBTimeOfImpact(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128 moveX, __m128 moveY,
+							__m128& toi, __m128& normalX, __m128& normalY) noexcept;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _POLYGON_RENDER_H_
+#define _POLYGON_RENDER_H_
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "Maths.h"
+#include "BodyObserver.h"
+
+class CPolygon;
+struct SPhysicSnapshot;
+
+// Vertex buffers of the outline of the bodies, in the same order as the physics columns
+class CPolygonRender : public IBodyObserver
+{
+public:
+	virtual void	OnBodyAdded(size_t index, const float* pointsX, const float* pointsY, size_t pointCount) override;
+	virtual void	OnBodyRemoved(size_t index) override;
+	virtual void	OnBodiesCleared() override;
+
+	void			Draw(const CPolygon& poly);
+	// The snapshot can lag behind the world by a tick, bodies added since are not drawn yet
+	void			Draw(const SPhysicSnapshot& snapshot, float alpha);
+
+private:
+	void			DrawBody(size_t index, const Vec2& position, float cos, float sin);
+	void			CreateBuffers(size_t index, const float* pointsX, const float* pointsY, size_t pointCount);
+	void			BindBuffers(size_t index);
+	void			DestroyBuffers(size_t index);
+
+	std::vector<GLuint>		m_vertexBufferId;
+	std::vector<size_t>		m_pointCount;
+};
+
+#endif
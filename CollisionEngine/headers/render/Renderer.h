@@ -18,9 +18,9 @@ enum class FPS : int
 
 struct SRenderText
 {
-	SRenderText(const std::string& _text, int _x, int _y) : text(_text), x(_x), y(_y){}
+	SRenderText(size_t _offset, int _x, int _y) : offset(_offset), x(_x), y(_y){}
 
-	std::string	text;
+	size_t	offset; // start of the text in the text buffer of the renderer
 	int x, y; // screen space (0,0) left bottom corner
 };
 
@@ -34,11 +34,18 @@ public:
 	float	GetWorldWidth() const;
 	float	GetWorldHeight() const;
 
+	void	DisplayText(const char* text);
+	void	DisplayText(const char* text, int x, int y);
 	void	DisplayText(const std::string& text);
 	void	DisplayText(const std::string& text, int x, int y);
 	void	DisplayTextWorld(const std::string& text, const Vec2& worldPos);
 	void	DrawLine(const Vec2& from, const Vec2& to, float r, float g, float b);
 	void	DrawCross(const Vec2& pos, float size, float r, float g, float b);
+	// World AABB stored with its negated maximum, as in the physic engine
+	void	DrawWorldAABB(const struct AABB& aabb, float r, float g, float b);
+
+	// Keeps the vertex buffers of the bodies of the world in sync
+	class IBodyObserver*	GetBodyObserver();
 
 	Vec2	ScreenToWorldPos(const Vec2& pos) const;
 	Vec2	WorldToScreenPos(const Vec2& pos) const;
@@ -54,7 +61,12 @@ private:
 	void	DrawFPS(float frameTime);
 	void	UpdateWorld(float frameTime);
 	void	RenderPolygons();
+	// Bodies of the last physics thread snapshot, interpolated to the current time
+	void	RenderSnapshot();
 	void	RenderTexts();
+	// Debug texts and drawings of the last step of the physic engine
+	void	DisplayStepStats();
+	void	DrawBVH4(const struct Node4* nodes, size_t nodeCount, float r, float g, float b);
 	void	UpdateLockFPS();
 
 	float	UpdateFrameTime();
@@ -64,7 +76,10 @@ private:
 
 	CTimer m_frameTimer;
 
+	class CPolygonRender*		m_polygonRender;
+
 	std::vector<SRenderText>	m_renderTexts;
+	std::vector<char>			m_textBuffer; // texts of the frame, kept to reuse its capacity
 	int							m_textCursor;
 
 	struct dtx_font* m_font;
@@ -23,7 +23,7 @@ protected:
 		//CreateBorderRectangles();
 
 		
-		gVars->pWorld->AddBehavior<CPolygonMoverTool>(nullptr);
+		gVars->pWorld->AddBehavior<CPolygonMoverTool>();
 	}
 	
 	//void CreateBorderRectangles()
@@ -16,7 +16,7 @@ protected:
 	{
 		CBaseScene::Create();
 
-		gVars->pWorld->AddBehavior<CSimplePolygonBounce>(nullptr);
+		gVars->pWorld->AddBehavior<CSimplePolygonBounce>();
 
 		float width = gVars->pRenderer->GetWorldWidth();
 		float height = gVars->pRenderer->GetWorldHeight();
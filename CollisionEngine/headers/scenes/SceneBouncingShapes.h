@@ -0,0 +1,59 @@
+#ifndef _SCENE_BOUNCING_SHAPES_H_
+#define _SCENE_BOUNCING_SHAPES_H_
+
+#include "BaseScene.h"
+
+#include "Behaviors/SimplePolygonBounce.h"
+
+class CSceneBouncingShapes : public CBaseScene
+{
+public:
+	CSceneBouncingShapes(size_t shapeCount)
+		: m_shapeCount(shapeCount){}
+
+protected:
+	virtual void Create() override
+	{
+		CBaseScene::Create();
+
+		gVars->pWorld->AddBehavior<CSimplePolygonBounce>();
+
+		float width = gVars->pRenderer->GetWorldWidth();
+		float height = gVars->pRenderer->GetWorldHeight();
+
+		SRandomPolyParams params;
+		params.minRadius = 1.0f;
+		params.maxRadius = 3.0f;
+		params.minBounds = Vec2(-width * 0.5f + params.maxRadius * 3.0f, -height * 0.5f + params.maxRadius * 3.0f);
+		params.maxBounds = params.minBounds * -1.0f;
+		params.minPoints = 4;
+		params.maxPoints = 4;
+		params.minSpeed = 1.0f;
+		params.maxSpeed = 3.0f;
+
+		// Mix of boxes, circles and capsules so every narrow phase kernel gets pairs to test
+		for (size_t i = 0; i < m_shapeCount; ++i)
+		{
+			switch (i % 3)
+			{
+			case 0: gVars->pWorld->AddRandomRectangle(params); break;
+			case 1: gVars->pWorld->AddRandomCircle(params); break;
+			case 2: gVars->pWorld->AddRandomCapsule(params); break;
+			}
+		}
+
+		// A few very fast boxes would tunnel through the other shapes without the continuous collision detection
+		CPolygon& polygons = gVars->pWorld->GetPolygons();
+		for (size_t i = 0; i < m_shapeCount / 30; ++i)
+		{
+			size_t polyIdx = gVars->pWorld->GetBodyIndex(gVars->pWorld->AddRandomRectangle(params));
+			polygons.speed[polyIdx] = polygons.speed[polyIdx] * 20.0f;
+			polygons.fast[polyIdx] = true;
+		}
+	}
+
+private:
+	size_t m_shapeCount;
+};
+
+#endif
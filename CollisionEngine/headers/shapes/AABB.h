@@ -6,7 +6,8 @@
 #include <vector>
 #include <smmintrin.h>
 
-struct AABB
+// The minimum and maximum are laid out as one SSE register: minimum x, minimum y, maximum x, maximum y
+struct alignas(16) AABB
 {
     constexpr AABB() noexcept
         : minimum(FLT_MAX, FLT_MAX), maximum(FLT_MIN, FLT_MIN) { }
@@ -14,19 +15,19 @@ struct AABB
     constexpr AABB(const Vec2& minimum, const Vec2& maximum)
         : minimum(minimum), maximum(maximum) { }
 
-    constexpr explicit AABB(const __m128 reg)
-        : reg(reg) { }
+    explicit AABB(const __m128 reg) noexcept
+    {
+        _mm_store_ps(&minimum.x, reg);
+    }
 
-    union {
-        struct { Vec2 minimum, maximum; };
-        __m128 reg;
-    };
+    Vec2 minimum;
+    Vec2 maximum;
+
+    __m128 GetReg() const noexcept { return _mm_load_ps(&minimum.x); }
 
     float Surface() const noexcept;
-    AABB Transform(__m128 position, __m128 rotation) const noexcept;
-    //AABB Transform(__m128 position, __m128 rotation) const noexcept;
+    AABB Transform(__m128 position, float cos, float sin) const noexcept;
 
-    static void DrawWorld(const AABB& A) noexcept;
     static float GetSurface(const std::vector<AABB>& aabbs) noexcept;
     static AABB GetSurrounding(const std::vector<AABB>& aabbs) noexcept;
 };
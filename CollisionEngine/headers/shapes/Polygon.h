@@ -1,19 +1,33 @@
 #ifndef _POLYGON_H_
 #define _POLYGON_H_
 
-#include <GL/glew.h>
 #include <vector>
 #include <memory>
+#include <cstdint>
 #include <immintrin.h>
 
 #include "Maths.h"
+#include "AlignedArray.h"
 
-#define MAX_POLY 100
+// Circles and capsules are stored as rounded boxes: a core shape of half extents
+// (halfExtentX, halfExtentY) inflated by a radius. A circle is a point core
+// (0, 0), a capsule is a segment core (halfLength, 0) along its local X axis
+enum class ShapeType : uint8_t
+{
+	OBB = 0,
+	Circle,
+	Capsule,
+
+	Count,
+};
 
+// Physics data of the bodies, render data lives on the render side (see IBodyObserver)
 class CPolygon
 {
 private:
 	friend class CWorld;
+	// Reads and writes the columns as they are
+	friend class CSceneFile;
 
 	CPolygon();
 public:
@@ -26,24 +40,49 @@ public:
 	//float*				pointsY;
 	//size_t				pointCount;
 	//Vec2				halfExtent;
-	size_t				polyCount;
-
-	union
-	{
-		__m128				registerRotation[MAX_POLY * 4];
-		Mat2				rotation[MAX_POLY * 4];
-	};
+	size_t				polyCount = 0;
+
+	/*
+	* Every body has an entry in all the columns below, they grow together
+	* when bodies are added. Columns start on a cache line and their capacity
+	* is a whole number of cache lines, so they can be read 4 or 8 bodies at a
+	* time with aligned loads.
+	* The rotation is the angle in radians, its cosine and sine are cached in
+	* their own columns and must be updated when the angle changes (SetAngle
+	* for one body, UpdateRotations for a range).
+	*/
+	CAlignedArray<float>		angle;
+	CAlignedArray<float>		rotationCos;
+	CAlignedArray<float>		rotationSin;
+
+	CAlignedArray<float>		positionX;
+	CAlignedArray<float>		positionY;
+	CAlignedArray<float>		halfExtentX;
+	CAlignedArray<float>		halfExtentY;
+	CAlignedArray<float>		radius;
+
+	CAlignedArray<ShapeType>	shapeType;
+
+	// Adds a body at the end of all the columns and returns its index
+	size_t				Add();
+	// Adds count bodies with a single resize of each column and returns the index of the first one
+	size_t				AddRange(size_t count);
+	// Removes a body by moving the last body into its index in all the columns
+	void				SwapRemove(const size_t index);
+
+	Mat2				GetRotation(const size_t index) const { return Mat2(rotationCos[index], -rotationSin[index], rotationSin[index], rotationCos[index]); }
+	// Angles are in degrees like Mat2
+	float				GetAngle(const size_t index) const;
+	void				SetAngle(const size_t index, float angle);
+	// Computes the cosine and sine of the bodies of [begin, end) from their angle, 8 at a time
+	void				UpdateRotations(size_t begin, size_t end);
 
-	__m128				positionX[MAX_POLY];
-	__m128				positionY[MAX_POLY];
-	__m128				halfExtentX[MAX_POLY];
-	__m128				halfExtentY[MAX_POLY];
-
-	void				Build(const size_t polyIdx, float pointsX[4], float pointsY[4]);
-	void				Draw(const size_t index);
 	//size_t				GetIndex() const;
 	Vec2				GetPosition(const size_t index) const;
+	Vec2				GetExtent(const size_t index) const;
 	void				SetExtent(const size_t index, const Vec2& halfExtent);
+	float				GetRadius(const size_t index) const;
+	void				SetRadius(const size_t index, float radius);
 	void				SetPosition(const size_t index, const Vec2& position);
 
 	float				GetArea() const;
@@ -51,27 +90,43 @@ public:
 	Vec2				TransformPoint(const size_t index, const Vec2& point) const;
 	Vec2				InverseTransformPoint(const size_t index, const Vec2& point) const;
 
-	// if point is outside then returned distance is negative (and doesn't make sense)
+	// Tested against the shape of the body, not its outline
 	bool				IsPointInside(const size_t index, const Vec2& point) const;
 
 	bool				CheckCollision(const CPolygon& poly, Vec2& colPoint, Vec2& colNormal, float& colDist) const;
-	void				Destroy();
 
 	// Physics
-	float				density[MAX_POLY * 4];
-	Vec2				speed[MAX_POLY*4];
+	CAlignedArray<float>		density;
+	CAlignedArray<Vec2>			speed;
+	// Radians per second
+	CAlignedArray<float>		angularSpeed;
+	// Bodies moving far enough in a step to pass through others, they are swept
+	// by the continuous collision detection of the physic engine
+	CAlignedArray<bool>			fast;
+	// Bodies that never move, the physic engine keeps them in a tree built once, see CWorld::SetStatic
+	CAlignedArray<bool>			isStatic;
 
 private:
-	void				CreateBuffers(const size_t polyIdx, float pointsX[4], float pointsY[4]);
-	void				BindBuffers(const size_t polyIdx);
-	void				DestroyBuffers(const size_t polyIdx);
-
-	void				BuildLines(const size_t polyIdx, float pointsX[4], float pointsY[4]);
-
-	GLuint				m_vertexBufferId[MAX_POLY*4];
-	size_t				m_index;
-
-	std::vector<Line>	m_lines[MAX_POLY*4];
+	// Calls functor(column) on every per body column, the only place listing them
+	template<typename TFunctor>
+	void				ForEachColumn(TFunctor functor)
+	{
+		functor(angle);
+		functor(rotationCos);
+		functor(rotationSin);
+		functor(positionX);
+		functor(positionY);
+		functor(halfExtentX);
+		functor(halfExtentY);
+		functor(radius);
+		functor(shapeType);
+
+		functor(density);
+		functor(speed);
+		functor(angularSpeed);
+		functor(fast);
+		functor(isStatic);
+	}
 };
 
 typedef std::shared_ptr<CPolygon>	CPolygonPtr;
@@ -0,0 +1,279 @@
+#include "CollisionPublisher.h"
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AlignedArray.h"
+#include "physics/PhysicEngine.h"
+
+#define COLLISION_RING_VERSION 1
+
+static const char s_ringMagic[4] = { 'C', 'P', 'U', 'B' };
+
+static size_t	AlignToCacheLine(size_t bytes)
+{
+	return (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+CSharedMemory::~CSharedMemory()
+{
+	Close();
+}
+
+bool	CSharedMemory::Create(const char* name, size_t size)
+{
+	return Map(name, size, true);
+}
+
+bool	CSharedMemory::Open(const char* name)
+{
+	return Map(name, 0, false);
+}
+
+#ifdef _WIN32
+
+bool	CSharedMemory::Map(const char* name, size_t size, bool create)
+{
+	Close();
+
+	char mappingName[256];
+	snprintf(mappingName, sizeof(mappingName), "Local\\%s", name);
+
+	if (create)
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, mappingName);
+	else
+		m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName);
+
+	if (m_mapping == nullptr)
+		return false;
+
+	m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	// The view of an opened mapping covers all of it
+	MEMORY_BASIC_INFORMATION info;
+	m_size = create ? size : (VirtualQuery(m_data, &info, sizeof(info)) != 0 ? info.RegionSize : 0);
+	m_owner = create;
+	return true;
+}
+
+void	CSharedMemory::Close()
+{
+	// The mapping is gone once every process closed it
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_owner = false;
+	m_mapping = nullptr;
+}
+
+#else
+
+bool	CSharedMemory::Map(const char* name, size_t size, bool create)
+{
+	Close();
+
+	snprintf(m_name, sizeof(m_name), "/%s", name);
+
+	const int file = create ? shm_open(m_name, O_CREAT | O_RDWR, 0644) : shm_open(m_name, O_RDONLY, 0);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	bool sized = create ? ftruncate(file, (off_t)size) == 0 : fstat(file, &status) == 0;
+	if (!create)
+		size = sized ? (size_t)status.st_size : 0;
+
+	void* data = MAP_FAILED;
+	if (sized && size > 0)
+		data = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+
+	// The mapping keeps the memory alive
+	close(file);
+
+	if (data == MAP_FAILED)
+	{
+		if (create)
+			shm_unlink(m_name);
+		return false;
+	}
+
+	m_data = static_cast<uint8_t*>(data);
+	m_size = size;
+	m_owner = create;
+	return true;
+}
+
+void	CSharedMemory::Close()
+{
+	if (m_data != nullptr)
+		munmap(m_data, m_size);
+	if (m_owner)
+		shm_unlink(m_name);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_owner = false;
+}
+
+#endif
+
+bool	CCollisionPublisher::Open(const char* name, size_t slotCount, size_t pairCapacity, size_t contactCapacity)
+{
+	Close();
+
+	if (slotCount == 0 || pairCapacity > UINT32_MAX || contactCapacity > UINT32_MAX)
+		return false;
+
+	const size_t slotSize = AlignToCacheLine(sizeof(SPublishedFrame) + pairCapacity * sizeof(SPublishedPair) + contactCapacity * sizeof(SPublishedContact));
+	const size_t headerSize = AlignToCacheLine(sizeof(SPublishedRing));
+	if (slotSize > UINT32_MAX || !m_memory.Create(name, headerSize + slotCount * slotSize))
+		return false;
+
+	// The memory of a new object is zeroed, a previous ring of the same name is reset
+	uint8_t* data = m_memory.GetData();
+	for (size_t slot = 0; slot < slotCount; slot++)
+	{
+		SPublishedFrame* frame = new(data + headerSize + slot * slotSize) SPublishedFrame();
+		frame->sequence.store(0, std::memory_order_relaxed);
+	}
+
+	SPublishedRing* ring = new(data) SPublishedRing();
+	memcpy(ring->magic, s_ringMagic, sizeof(ring->magic));
+	ring->version = COLLISION_RING_VERSION;
+	ring->slotCount = (uint32_t)slotCount;
+	ring->pairCapacity = (uint32_t)pairCapacity;
+	ring->contactCapacity = (uint32_t)contactCapacity;
+	ring->slotSize = (uint32_t)slotSize;
+	ring->lastFrame.store(0, std::memory_order_release);
+
+	m_frameIndex = 0;
+	return true;
+}
+
+void	CCollisionPublisher::Close()
+{
+	m_memory.Close();
+	m_frameIndex = 0;
+}
+
+void	CCollisionPublisher::Publish(CPhysicEngine& engine)
+{
+	if (!IsOpen())
+		return;
+
+	uint8_t* data = m_memory.GetData();
+	SPublishedRing& ring = *reinterpret_cast<SPublishedRing*>(data);
+
+	const uint64_t frameIndex = ++m_frameIndex;
+	SPublishedFrame& frame = *reinterpret_cast<SPublishedFrame*>(data + AlignToCacheLine(sizeof(SPublishedRing)) + (frameIndex % ring.slotCount) * ring.slotSize);
+	SPublishedPair* pairs = reinterpret_cast<SPublishedPair*>(&frame + 1);
+	SPublishedContact* contacts = reinterpret_cast<SPublishedContact*>(pairs + ring.pairCapacity);
+
+	// Odd while the slot is written, the writes of the slot can't move before it
+	frame.sequence.store(2 * frameIndex - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint32_t pairCount = 0;
+	engine.ForEachCollision([&](const SCollision& collision)
+	{
+		if (pairCount == ring.pairCapacity)
+			return;
+
+		SPublishedPair& pair = pairs[pairCount++];
+		pair.polyA = (uint32_t)collision.polyA;
+		pair.polyB = (uint32_t)collision.polyB;
+		pair.pointX = collision.point.x;
+		pair.pointY = collision.point.y;
+		pair.normalX = collision.normal.x;
+		pair.normalY = collision.normal.y;
+		pair.distance = collision.distance;
+		pair.padding = 0;
+	});
+
+	// The manifold columns are flattened, each contact carries its pair and normal
+	const CManifoldCache::SColumns& manifolds = engine.GetManifolds().GetColumns();
+	uint32_t contactCount = 0;
+	for (size_t manifold = 0; manifold < manifolds.polyA.size(); manifold++)
+	{
+		const uint32_t first = manifolds.firstContact[manifold];
+		const uint32_t end = first + manifolds.contactCount[manifold];
+
+		for (uint32_t point = first; point < end && contactCount < ring.contactCapacity; point++)
+		{
+			SPublishedContact& contact = contacts[contactCount++];
+			contact.polyA = manifolds.polyA[manifold];
+			contact.polyB = manifolds.polyB[manifold];
+			contact.pointX = manifolds.pointX[point];
+			contact.pointY = manifolds.pointY[point];
+			contact.normalX = manifolds.normalX[manifold];
+			contact.normalY = manifolds.normalY[manifold];
+			contact.separation = manifolds.separation[point];
+			contact.featureId = manifolds.featureId[point];
+		}
+	}
+
+	frame.frameIndex = frameIndex;
+	frame.pairCount = pairCount;
+	frame.contactCount = contactCount;
+	frame.stepPairCount = (uint32_t)engine.GetCollisionCount();
+	frame.stepContactCount = (uint32_t)manifolds.pointX.size();
+
+	frame.sequence.store(2 * frameIndex, std::memory_order_release);
+	ring.lastFrame.store(frameIndex, std::memory_order_release);
+}
+
+bool	CCollisionReader::Open(const char* name)
+{
+	Close();
+
+	if (!m_memory.Open(name) || m_memory.GetSize() < sizeof(SPublishedRing))
+	{
+		Close();
+		return false;
+	}
+
+	const SPublishedRing* ring = reinterpret_cast<const SPublishedRing*>(m_memory.GetData());
+	const size_t ringSize = AlignToCacheLine(sizeof(SPublishedRing)) + (size_t)ring->slotCount * ring->slotSize;
+	const size_t slotSize = sizeof(SPublishedFrame) + (size_t)ring->pairCapacity * sizeof(SPublishedPair) + (size_t)ring->contactCapacity * sizeof(SPublishedContact);
+
+	if (memcmp(ring->magic, s_ringMagic, sizeof(ring->magic)) != 0 || ring->version != COLLISION_RING_VERSION
+		|| ring->slotCount == 0 || ring->slotSize < slotSize || ringSize > m_memory.GetSize())
+	{
+		Close();
+		return false;
+	}
+
+	m_ring = ring;
+	return true;
+}
+
+void	CCollisionReader::Close()
+{
+	m_memory.Close();
+	m_ring = nullptr;
+}
+
+const SPublishedFrame&	CCollisionReader::GetSlot(uint64_t frameIndex) const
+{
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(m_ring);
+	return *reinterpret_cast<const SPublishedFrame*>(data + AlignToCacheLine(sizeof(SPublishedRing)) + (frameIndex % m_ring->slotCount) * m_ring->slotSize);
+}
@@ -0,0 +1,139 @@
+#include "FrameArena.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Size of a huge page on x64, the block is always a multiple of it
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static size_t RoundUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+CFrameArena::CFrameArena(size_t capacity)
+{
+	MapBlock(capacity);
+}
+
+CFrameArena::~CFrameArena()
+{
+	Reset();
+	UnmapBlock();
+}
+
+void*	CFrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	size_t offset = m_offset.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const size_t start = RoundUp(offset, alignment);
+		if (start + bytes > m_capacity)
+			return AllocateOverflow(bytes);
+
+		// Threads allocating at the same time get ranges one after the other, a failed
+		// exchange reloads the offset moved by another thread
+		if (m_offset.compare_exchange_weak(offset, start + bytes, std::memory_order_relaxed))
+			return m_block + start;
+	}
+}
+
+void*	CFrameArena::AllocateOverflow(size_t bytes)
+{
+	// Kept until the next reset, which resizes the block so this doesn't happen again
+	void* memory = AlignedAllocate(bytes);
+
+	std::lock_guard<std::mutex> lock(m_overflowMutex);
+	m_overflow.push_back(memory);
+	m_overflowBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+	return memory;
+}
+
+void*	CFrameArena::Reallocate(void* memory, size_t oldBytes, size_t usedBytes, size_t newBytes, size_t alignment)
+{
+	// The allocation is at the top of the block if nothing was allocated after it, which the
+	// exchange checks atomically
+	char* bytes = static_cast<char*>(memory);
+	if (bytes >= m_block && bytes < m_block + m_capacity)
+	{
+		const size_t start = bytes - m_block;
+		size_t end = start + oldBytes;
+		if (start + newBytes <= m_capacity && m_offset.compare_exchange_strong(end, start + newBytes, std::memory_order_relaxed))
+			return memory;
+	}
+
+	void* newMemory = Allocate(newBytes, alignment);
+	if (usedBytes > 0)
+		memcpy(newMemory, memory, usedBytes);
+
+	return newMemory;
+}
+
+void	CFrameArena::Reset()
+{
+	const size_t used = GetUsed();
+	if (used > m_highWaterMark)
+		m_highWaterMark = used;
+
+	if (!m_overflow.empty())
+	{
+		for (void* memory : m_overflow)
+			AlignedFree(memory);
+		m_overflow.clear();
+		m_overflowBytes.store(0, std::memory_order_relaxed);
+
+		UnmapBlock();
+		MapBlock(m_highWaterMark);
+	}
+
+	m_offset.store(0, std::memory_order_relaxed);
+}
+
+void	CFrameArena::MapBlock(size_t capacity)
+{
+	m_capacity = RoundUp(capacity, HUGE_PAGE_SIZE);
+	m_hugePagesRequested = false;
+
+#ifdef _WIN32
+	// Large pages need the "Lock pages in memory" privilege, fall back to normal pages without it
+	const size_t largePageSize = GetLargePageMinimum();
+	if (largePageSize != 0)
+	{
+		m_block = static_cast<char*>(VirtualAlloc(nullptr, RoundUp(m_capacity, largePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+		m_hugePagesRequested = m_block != nullptr;
+	}
+	if (m_block == nullptr)
+		m_block = static_cast<char*>(VirtualAlloc(nullptr, m_capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+	// Explicit huge pages need to be reserved by the system, otherwise ask for transparent ones
+	void* block = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	m_hugePagesRequested = block != MAP_FAILED;
+	if (block == MAP_FAILED)
+	{
+		block = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (block != MAP_FAILED)
+			m_hugePagesRequested = madvise(block, m_capacity, MADV_HUGEPAGE) == 0;
+	}
+	m_block = block != MAP_FAILED ? static_cast<char*>(block) : nullptr;
+#endif
+
+	if (m_block == nullptr)
+		throw std::bad_alloc();
+}
+
+void	CFrameArena::UnmapBlock()
+{
+	if (m_block == nullptr)
+		return;
+
+#ifdef _WIN32
+	VirtualFree(m_block, 0, MEM_RELEASE);
+#else
+	munmap(m_block, m_capacity);
+#endif
+	m_block = nullptr;
+}
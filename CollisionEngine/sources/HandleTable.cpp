@@ -0,0 +1,51 @@
+#include "HandleTable.h"
+
+// Freed slots waiting before being reused
+#define MIN_FREE_SLOTS 1024
+
+SBodyHandle	CHandleTable::Create()
+{
+	uint32_t slot;
+	if (m_freeSlots.size() > MIN_FREE_SLOTS)
+	{
+		slot = m_freeSlots.front();
+		m_freeSlots.pop_front();
+	}
+	else
+	{
+		slot = (uint32_t)m_slots.size();
+		m_slots.push_back({ 0, 0 });
+	}
+
+	m_slots[slot].index = (uint32_t)m_denseSlots.size();
+	m_denseSlots.push_back(slot);
+
+	return { slot, m_slots[slot].generation };
+}
+
+size_t	CHandleTable::Remove(SBodyHandle handle)
+{
+	const uint32_t index = m_slots[handle.slot].index;
+	const uint32_t lastSlot = m_denseSlots.back();
+
+	// The last body moves into the hole
+	m_denseSlots[index] = lastSlot;
+	m_slots[lastSlot].index = index;
+	m_denseSlots.pop_back();
+
+	m_slots[handle.slot].generation++;
+	m_freeSlots.push_back(handle.slot);
+
+	return index;
+}
+
+bool	CHandleTable::IsValid(SBodyHandle handle) const
+{
+	return handle.slot < m_slots.size() && m_slots[handle.slot].generation == handle.generation;
+}
+
+SBodyHandle	CHandleTable::GetHandle(size_t index) const
+{
+	const uint32_t slot = m_denseSlots[index];
+	return { slot, m_slots[slot].generation };
+}
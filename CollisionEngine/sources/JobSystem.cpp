@@ -0,0 +1,287 @@
+#include "JobSystem.h"
+
+#include <cassert>
+#include <cstdio>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "Profiler.h"
+
+// Index of the calling thread in the job system, 0 for the thread outside of the workers
+static thread_local size_t s_threadIndex = 0;
+
+CJobSystem::CJobSystem(const SJobSystemConfig& config)
+	: m_queuedJobs(0), m_sleepingWorkers(0)
+{
+	// Allocated by hand to get their cache line alignment
+	for (size_t i = 0; i < config.workerCount + 1; i++)
+	{
+		m_threads.push_back(new (AlignedAllocate(sizeof(SThreadJobs))) SThreadJobs());
+		AddJobBlock(*m_threads.back());
+	}
+
+	for (size_t i = 0; i < config.workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&CJobSystem::WorkerLoop, this, i + 1));
+
+		if (config.pinWorkers)
+			PinWorker(m_workers.back(), i + 1);
+	}
+}
+
+CJobSystem::~CJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_exit = true;
+	}
+	m_sleepCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+
+	for (SThreadJobs* thread : m_threads)
+	{
+		for (SJob* jobBlock : thread->jobBlocks)
+			delete[] jobBlock;
+
+		thread->~SThreadJobs();
+		AlignedFree(thread);
+	}
+}
+
+void	CJobSystem::AddJobBlock(SThreadJobs& thread)
+{
+	SJob* jobBlock = new SJob[JOB_BLOCK_SIZE];
+	for (size_t i = 0; i < JOB_BLOCK_SIZE; i++)
+		jobBlock[i].unfinishedJobs = 0;
+
+	thread.jobBlocks.push_back(jobBlock);
+}
+
+SJob*	CJobSystem::CreateJob(TJobFunction function, void* context, size_t count, size_t batchSize)
+{
+	SThreadJobs& thread = *m_threads[s_threadIndex];
+
+	// Jobs of the ring still running or waiting for their dependencies are skipped
+	const size_t jobCount = thread.jobBlocks.size() * JOB_BLOCK_SIZE;
+	SJob* job = nullptr;
+	for (size_t tried = 0; tried < jobCount && job == nullptr; tried++)
+	{
+		const size_t index = thread.nextJob++ % jobCount;
+		SJob* candidate = &thread.jobBlocks[index / JOB_BLOCK_SIZE][index % JOB_BLOCK_SIZE];
+		if (candidate->unfinishedJobs.load() == 0)
+			job = candidate;
+	}
+
+	// Every job of the ring is unfinished, the ring continues with a new block
+	if (job == nullptr)
+	{
+		AddJobBlock(thread);
+		job = &thread.jobBlocks.back()[0];
+		thread.nextJob = jobCount + 1;
+	}
+
+	job->function = function;
+	job->context = context;
+	job->begin = 0;
+	job->end = count;
+	job->batchSize = batchSize > 0 ? batchSize : 1;
+	job->parent = nullptr;
+	job->unfinishedJobs = 1;
+	job->pendingDependencies = 1;
+	job->continuationCount = 0;
+
+	return job;
+}
+
+void	CJobSystem::AddDependency(SJob* job, SJob* dependency)
+{
+	const int32_t index = dependency->continuationCount.fetch_add(1);
+	assert(index < MAX_JOB_CONTINUATIONS);
+
+	dependency->continuations[index] = job;
+	job->pendingDependencies.fetch_add(1);
+}
+
+void	CJobSystem::Run(SJob* job)
+{
+	if (job->pendingDependencies.fetch_sub(1) == 1)
+		Push(job);
+}
+
+void	CJobSystem::Wait(const SJob* job)
+{
+	const size_t threadIndex = s_threadIndex;
+
+	while (job->unfinishedJobs.load() > 0)
+	{
+		SJob* next = GetJob(threadIndex);
+		if (next != nullptr)
+			Execute(next, threadIndex);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void	CJobSystem::WorkerLoop(size_t threadIndex)
+{
+	s_threadIndex = threadIndex;
+
+	char threadName[32];
+	snprintf(threadName, sizeof(threadName), "Worker %zu", threadIndex);
+	CProfiler::SetThreadName(threadName);
+
+	while (true)
+	{
+		SJob* job = GetJob(threadIndex);
+		if (job != nullptr)
+		{
+			Execute(job, threadIndex);
+			continue;
+		}
+
+		// The sleeping count is checked by Push after it counts its job, so either the
+		// worker sees the job or Push sees the worker and wakes it up
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepingWorkers++;
+		m_sleepCondition.wait(lock, [this]() { return m_exit || m_queuedJobs.load() > 0; });
+		m_sleepingWorkers--;
+
+		if (m_exit)
+			return;
+	}
+}
+
+void	CJobSystem::PinWorker(std::thread& worker, size_t core)
+{
+	const size_t coreCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+
+#ifdef _WIN32
+	// Only the cores of the first processor group can be used
+	SetThreadAffinityMask(worker.native_handle(), (DWORD_PTR)1 << (core % coreCount % (sizeof(DWORD_PTR) * 8)));
+#else
+	cpu_set_t cores;
+	CPU_ZERO(&cores);
+	CPU_SET(core % coreCount, &cores);
+	pthread_setaffinity_np(worker.native_handle(), sizeof(cores), &cores);
+#endif
+}
+
+void	CJobSystem::Push(SJob* job)
+{
+	const size_t threadIndex = s_threadIndex;
+	SThreadJobs& thread = *m_threads[threadIndex];
+
+	{
+		std::lock_guard<std::mutex> lock(thread.queueMutex);
+		if (thread.back - thread.front < JOB_QUEUE_SIZE)
+		{
+			thread.queue[thread.back++ % JOB_QUEUE_SIZE] = job;
+			job = nullptr;
+		}
+	}
+
+	// Full queue, no room to hand it to other threads
+	if (job != nullptr)
+	{
+		Execute(job, threadIndex);
+		return;
+	}
+
+	m_queuedJobs.fetch_add(1);
+	if (m_sleepingWorkers.load() > 0)
+	{
+		// Taking the mutex makes sure a worker about to sleep has either seen the job or is waiting
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_sleepCondition.notify_one();
+	}
+}
+
+SJob*	CJobSystem::Pop(size_t threadIndex)
+{
+	SThreadJobs& thread = *m_threads[threadIndex];
+
+	std::lock_guard<std::mutex> lock(thread.queueMutex);
+	if (thread.back == thread.front)
+		return nullptr;
+
+	return thread.queue[--thread.back % JOB_QUEUE_SIZE];
+}
+
+SJob*	CJobSystem::Steal(size_t threadIndex)
+{
+	for (size_t i = 1; i < m_threads.size(); i++)
+	{
+		SThreadJobs& victim = *m_threads[(threadIndex + i) % m_threads.size()];
+
+		std::lock_guard<std::mutex> lock(victim.queueMutex);
+		if (victim.back != victim.front)
+			return victim.queue[victim.front++ % JOB_QUEUE_SIZE];
+	}
+
+	return nullptr;
+}
+
+SJob*	CJobSystem::GetJob(size_t threadIndex)
+{
+	SJob* job = Pop(threadIndex);
+	if (job == nullptr)
+		job = Steal(threadIndex);
+
+	if (job != nullptr)
+		m_queuedJobs.fetch_sub(1);
+
+	return job;
+}
+
+void	CJobSystem::Execute(SJob* job, size_t threadIndex)
+{
+	// Split large ranges in two, the upper half is queued so that idle threads can steal it
+	while (job->end - job->begin > job->batchSize)
+	{
+		const size_t middle = job->begin + (job->end - job->begin) / 2;
+
+		SJob* half = CreateJob(job->function, job->context, 0, job->batchSize);
+		half->begin = middle;
+		half->end = job->end;
+		half->parent = job;
+		half->pendingDependencies = 0;
+
+		job->unfinishedJobs.fetch_add(1);
+		job->end = middle;
+
+		Push(half);
+	}
+
+	if (job->function != nullptr && job->begin < job->end)
+		job->function(job->context, job->begin, job->end, threadIndex);
+
+	Finish(job);
+}
+
+void	CJobSystem::Finish(SJob* job)
+{
+	// The job can be reused as soon as it is finished, what runs next is read before
+	SJob* parent = job->parent;
+	SJob* continuations[MAX_JOB_CONTINUATIONS];
+	const int32_t continuationCount = job->continuationCount.load();
+	for (int32_t i = 0; i < continuationCount; i++)
+		continuations[i] = job->continuations[i];
+
+	if (job->unfinishedJobs.fetch_sub(1) != 1)
+		return;
+
+	for (int32_t i = 0; i < continuationCount; i++)
+		Run(continuations[i]);
+
+	if (parent != nullptr)
+		Finish(parent);
+}
@@ -11,3 +11,72 @@ float Random(float from, float to)
 {
 	return from + (to - from) * (((float)rand()) / ((float)RAND_MAX));
 }
+
+/*
+* The angle is reduced to [-pi/4, pi/4] by removing the nearest multiple j of
+* pi/2 (in three parts to keep the precision), the sine and cosine of the
+* remainder are minimax polynomials (from Cephes sinf/cosf). The quadrant j
+* then swaps and negates them:
+*	j & 3 = 0 : sin = s,  cos = c
+*	j & 3 = 1 : sin = c,  cos = -s
+*	j & 3 = 2 : sin = -s, cos = -c
+*	j & 3 = 3 : sin = -c, cos = s
+*/
+#define SINCOS_PI_2_PART1	1.5703125f
+#define SINCOS_PI_2_PART2	4.837512969970703125e-4f
+#define SINCOS_PI_2_PART3	7.54978995489188216e-8f
+
+void SIMD_SinCos(__m128 angle, __m128& sin, __m128& cos) noexcept
+{
+	const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set_ps1(2.0f / (float)M_PI)));
+	const __m128 j = _mm_cvtepi32_ps(quadrant);
+
+	__m128 x = _mm_sub_ps(angle, _mm_mul_ps(j, _mm_set_ps1(SINCOS_PI_2_PART1)));
+	x = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set_ps1(SINCOS_PI_2_PART2)));
+	x = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set_ps1(SINCOS_PI_2_PART3)));
+	const __m128 z = _mm_mul_ps(x, x);
+
+	__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set_ps1(-1.9515295891e-4f), z), _mm_set_ps1(8.3321608736e-3f));
+	s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set_ps1(-1.6666654611e-1f));
+	s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+	__m128 c = _mm_add_ps(_mm_mul_ps(_mm_set_ps1(2.443315711809948e-5f), z), _mm_set_ps1(-1.388731625493765e-3f));
+	c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set_ps1(4.166664568298827e-2f));
+	c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, z), z), _mm_sub_ps(_mm_set_ps1(1.0f), _mm_mul_ps(z, _mm_set_ps1(0.5f))));
+
+	// Odd quadrants swap the sine and cosine, bit 1 of j (j + 1 for the cosine) gives the sign
+	const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+	const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+	sin = _mm_xor_ps(_mm_blendv_ps(s, c, swap), sinSign);
+	cos = _mm_xor_ps(_mm_blendv_ps(c, s, swap), cosSign);
+}
+
+#ifdef __AVX2__
+void SIMD_SinCos(__m256 angle, __m256& sin, __m256& cos) noexcept
+{
+	const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(angle, _mm256_set1_ps(2.0f / (float)M_PI)));
+	const __m256 j = _mm256_cvtepi32_ps(quadrant);
+
+	__m256 x = _mm256_sub_ps(angle, _mm256_mul_ps(j, _mm256_set1_ps(SINCOS_PI_2_PART1)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(SINCOS_PI_2_PART2)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(SINCOS_PI_2_PART3)));
+	const __m256 z = _mm256_mul_ps(x, x);
+
+	__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), z), _mm256_set1_ps(8.3321608736e-3f));
+	s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(-1.6666654611e-1f));
+	s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), x), x);
+
+	__m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), z), _mm256_set1_ps(-1.388731625493765e-3f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(4.166664568298827e-2f));
+	c = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c, z), z), _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(z, _mm256_set1_ps(0.5f))));
+
+	const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+	const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+	sin = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign);
+	cos = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign);
+}
+#endif
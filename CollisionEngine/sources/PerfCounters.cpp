@@ -0,0 +1,165 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+const char*	GetPerfCounterName(PerfCounter counter)
+{
+	switch (counter)
+	{
+	case PerfCounter::Cycles:				return "Cycles";
+	case PerfCounter::Instructions:			return "Instructions";
+	case PerfCounter::L1DataMisses:			return "L1D misses";
+	case PerfCounter::LastLevelCacheMisses:	return "LLC misses";
+	case PerfCounter::BranchMisses:			return "Branch misses";
+	case PerfCounter::TaskClock:			return "Task clock ns";
+	default:								return "Unknown";
+	}
+}
+
+SPerfCounterValues&	SPerfCounterValues::operator+=(const SPerfCounterValues& other)
+{
+	for (size_t i = 0; i < (size_t)PerfCounter::Count; i++)
+		values[i] += other.values[i];
+	availableMask |= other.availableMask;
+	return *this;
+}
+
+SPerfCounterValues	operator-(const SPerfCounterValues& end, const SPerfCounterValues& start)
+{
+	SPerfCounterValues delta;
+	for (size_t i = 0; i < (size_t)PerfCounter::Count; i++)
+		delta.values[i] = end.values[i] > start.values[i] ? end.values[i] - start.values[i] : 0;
+	delta.availableMask = end.availableMask & start.availableMask;
+	return delta;
+}
+
+#ifdef __linux__
+
+static int	OpenCounter(uint32_t type, uint64_t config, int groupFd)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// The leader starts the whole group once every counter is in it
+	attr.disabled = groupFd < 0 ? 1 : 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// Calling thread on any CPU
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+static uint64_t	GetCacheConfig(uint64_t cache, uint64_t operation, uint64_t result)
+{
+	return cache | (operation << 8) | (result << 16);
+}
+
+CPerfCounterGroup::CPerfCounterGroup()
+{
+	struct SCounterConfig
+	{
+		uint32_t	type;
+		uint64_t	config;
+	};
+
+	const SCounterConfig configs[(size_t)PerfCounter::Count] =
+	{
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, GetCacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+	};
+
+	// Counters the CPU doesn't have are left out of the group, the group fails without its leader
+	for (size_t i = 0; i < (size_t)PerfCounter::Count; i++)
+	{
+		m_fds[i] = OpenCounter(configs[i].type, configs[i].config, m_leader);
+		if (m_fds[i] < 0)
+			continue;
+
+		if (m_leader < 0)
+			m_leader = m_fds[i];
+
+		m_readIndices[i] = m_openCount++;
+		m_availableMask |= 1u << i;
+	}
+
+	if (m_leader >= 0)
+	{
+		ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+CPerfCounterGroup::~CPerfCounterGroup()
+{
+	// The leader is closed last, the other counters are attached to it
+	for (size_t i = (size_t)PerfCounter::Count; i-- > 0;)
+	{
+		if (m_fds[i] >= 0)
+			close(m_fds[i]);
+	}
+}
+
+void	CPerfCounterGroup::Read(SPerfCounterValues& values) const
+{
+	values = SPerfCounterValues();
+	if (m_leader < 0)
+		return;
+
+	// Layout of PERF_FORMAT_GROUP with both times: count, time enabled, time running, values
+	uint64_t buffer[3 + (size_t)PerfCounter::Count];
+	const ssize_t bytes = read(m_leader, buffer, sizeof(buffer));
+	if (bytes < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != m_openCount)
+		return;
+
+	const uint64_t timeEnabled = buffer[1];
+	const uint64_t timeRunning = buffer[2];
+	// Never scheduled, for example while another tool holds the counters
+	if (timeRunning == 0)
+		return;
+
+	const double scale = (double)timeEnabled / (double)timeRunning;
+	for (size_t i = 0; i < (size_t)PerfCounter::Count; i++)
+	{
+		if (m_fds[i] >= 0)
+			values.values[i] = (uint64_t)((double)buffer[3 + m_readIndices[i]] * scale);
+	}
+	values.availableMask = m_availableMask;
+}
+
+#else
+
+CPerfCounterGroup::CPerfCounterGroup()
+{
+	for (int& fd : m_fds)
+		fd = -1;
+}
+
+CPerfCounterGroup::~CPerfCounterGroup()
+{
+}
+
+void	CPerfCounterGroup::Read(SPerfCounterValues& values) const
+{
+	values = SPerfCounterValues();
+}
+
+#endif
+
+const CPerfCounterGroup&	CPerfCounterGroup::GetThreadGroup()
+{
+	static thread_local CPerfCounterGroup group;
+	return group;
+}
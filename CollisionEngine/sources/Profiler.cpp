@@ -0,0 +1,132 @@
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "AlignedArray.h"
+#include "GlobalVariables.h"
+#include "Timer.h"
+
+static std::atomic<uint64_t> s_nextProfilerId(1);
+
+// Ring of the calling thread for the profiler of id s_threadProfilerId
+static thread_local uint64_t s_threadProfilerId = 0;
+static thread_local void* s_threadSamples = nullptr;
+static thread_local char s_threadName[32] = {};
+
+CProfiler::CProfiler()
+	: m_id(s_nextProfilerId++)
+{
+	m_startTicks = ReadTimestamp();
+	m_startTime = std::chrono::steady_clock::now();
+}
+
+CProfiler::~CProfiler()
+{
+	for (SThreadSamples* thread : m_threads)
+	{
+		thread->~SThreadSamples();
+		AlignedFree(thread);
+	}
+}
+
+void	CProfiler::SetThreadName(const char* name)
+{
+	snprintf(s_threadName, sizeof(s_threadName), "%s", name);
+}
+
+CProfiler::SThreadSamples*	CProfiler::GetThreadSamples()
+{
+	if (s_threadProfilerId == m_id)
+		return static_cast<SThreadSamples*>(s_threadSamples);
+
+	// First sample of the thread, rings are never freed before the profiler
+	SThreadSamples* thread = new (AlignedAllocate(sizeof(SThreadSamples))) SThreadSamples();
+	thread->writeIndex = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		thread->threadId = (uint32_t)m_threads.size();
+		m_threads.push_back(thread);
+	}
+
+	if (s_threadName[0] != '\0')
+		snprintf(thread->threadName, sizeof(thread->threadName), "%s", s_threadName);
+	else
+		snprintf(thread->threadName, sizeof(thread->threadName), "Thread %u", thread->threadId);
+
+	s_threadProfilerId = m_id;
+	s_threadSamples = thread;
+	return thread;
+}
+
+bool	CProfiler::WriteChromeTrace(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	const double frequency = GetTimestampFrequency(m_startTicks, m_startTime, ReadTimestamp(), std::chrono::steady_clock::now());
+	// Trace times are in microseconds from the creation of the profiler
+	auto toMicroseconds = [this, frequency](uint64_t ticks)
+	{
+		return ticks > m_startTicks ? (double)(ticks - m_startTicks) * 1e6 / frequency : 0.0;
+	};
+
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+	for (const SThreadSamples* thread : m_threads)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", thread->threadId, thread->threadName);
+		first = false;
+
+		// The ring only holds the last samples once it has wrapped
+		const uint64_t end = thread->writeIndex.load(std::memory_order_acquire);
+		const uint64_t begin = end > PROFILER_RING_SIZE ? end - PROFILER_RING_SIZE : 0;
+
+		for (uint64_t index = begin; index < end; index++)
+		{
+			const SProfileSample& sample = thread->samples[index % PROFILER_RING_SIZE];
+			const double start = toMicroseconds(sample.start);
+
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				sample.name, thread->threadId, start, toMicroseconds(sample.end) - start);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
+
+CProfileScope::CProfileScope(const char* name)
+	: m_samples(nullptr), m_name(name), m_start(0)
+{
+	CProfiler* profiler = gVars != nullptr ? gVars->pProfiler : nullptr;
+	if (profiler == nullptr)
+		return;
+
+	m_samples = profiler->GetThreadSamples();
+	m_start = ReadTimestamp();
+}
+
+CProfileScope::~CProfileScope()
+{
+	if (m_samples == nullptr)
+		return;
+
+	// Only this thread writes to the ring, the sample is published by moving the index past it
+	const uint64_t index = m_samples->writeIndex.load(std::memory_order_relaxed);
+
+	SProfileSample& sample = m_samples->samples[index % PROFILER_RING_SIZE];
+	sample.name = m_name;
+	sample.start = m_start;
+	sample.end = ReadTimestamp();
+
+	m_samples->writeIndex.store(index + 1, std::memory_order_release);
+}
@@ -0,0 +1,307 @@
+#include "SceneFile.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AlignedArray.h"
+#include "World.h"
+#include "physics/PhysicEngine.h"
+
+#define SCENE_FILE_VERSION 2
+// Columns the header has room for, CPolygon has fewer
+#define SCENE_FILE_MAX_COLUMNS 32
+
+struct SSceneFileSection
+{
+	// From the start of the file, a multiple of CACHE_LINE_SIZE
+	uint64_t	offset;
+	uint64_t	elementSize;
+	uint64_t	count;
+};
+
+struct SSceneFileHeader
+{
+	char				magic[4];
+	uint32_t			version;
+	uint64_t			bodyCount;
+	uint32_t			columnCount;
+	// The static tree may have no node when there is no static body
+	uint32_t			hasStaticBVH4;
+	SSceneFileSection	columns[SCENE_FILE_MAX_COLUMNS];
+	SSceneFileSection	localAABBs;
+	// Null count if the file has no tree
+	SSceneFileSection	bvh4Nodes;
+	SSceneFileSection	staticBVH4Nodes;
+};
+
+static const char s_sceneFileMagic[4] = { 'C', 'S', 'C', 'N' };
+
+static uint64_t	AlignToCacheLine(uint64_t offset)
+{
+	return (offset + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+/*
+* Child nodes of a tree written by the engine come after their parent, which
+* also rules out cycles, and leaves are indices of bodies. A tree of another
+* file layout or of a damaged file would be traversed out of its nodes.
+*/
+static bool	IsTreeValid(const Node4* nodes, size_t nodeCount, size_t bodyCount)
+{
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		for (const ChildID& child : nodes[node].children)
+		{
+			if (child.index < 0)
+				continue;
+
+			const size_t index = (size_t)child.index;
+			if (child.isLeaf ? index >= bodyCount : (index <= node || index >= nodeCount))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool	CMappedFile::Open(const char* path)
+{
+	Close();
+
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void	CMappedFile::Close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = nullptr;
+}
+
+#else
+
+bool	CMappedFile::Open(const char* path)
+{
+	Close();
+
+	const int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+		data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	// The mapping keeps the file open
+	close(file);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	// The sections are copied front to back
+	madvise(data, (size_t)status.st_size, MADV_SEQUENTIAL);
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = (size_t)status.st_size;
+	return true;
+}
+
+void	CMappedFile::Close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
+
+bool	CSceneFile::Save(const char* path, CWorld& world, const CPhysicEngine& engine, bool withBVH)
+{
+	CPolygon& poly = world.GetPolygons();
+	const size_t bodyCount = poly.polyCount;
+	const size_t nodeCount = withBVH ? engine.GetBVH4NodeCount() : 0;
+	const bool withStaticBVH = withBVH && engine.IsStaticBVHValid();
+	const size_t staticNodeCount = withStaticBVH ? engine.GetStaticBVH4NodeCount() : 0;
+
+	// Lay the sections out one after the other, each on its own cache lines
+	SSceneFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, s_sceneFileMagic, sizeof(header.magic));
+	header.version = SCENE_FILE_VERSION;
+	header.bodyCount = bodyCount;
+	header.hasStaticBVH4 = withStaticBVH ? 1 : 0;
+
+	uint64_t offset = AlignToCacheLine(sizeof(header));
+	auto addSection = [&offset](SSceneFileSection& section, size_t elementSize, size_t count)
+	{
+		section.offset = offset;
+		section.elementSize = elementSize;
+		section.count = count;
+		offset = AlignToCacheLine(offset + elementSize * count);
+	};
+
+	poly.ForEachColumn([&](auto& column)
+	{
+		addSection(header.columns[header.columnCount++], sizeof(column[0]), bodyCount);
+	});
+	addSection(header.localAABBs, sizeof(AABB), bodyCount);
+	addSection(header.bvh4Nodes, sizeof(Node4), nodeCount);
+	addSection(header.staticBVH4Nodes, sizeof(Node4), staticNodeCount);
+
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	const uint8_t padding[CACHE_LINE_SIZE] = {};
+	bool written = true;
+	auto writeSection = [file, &padding, &written](const void* data, size_t bytes)
+	{
+		if (written && bytes > 0)
+			written = fwrite(data, 1, bytes, file) == bytes;
+
+		const size_t paddingBytes = (size_t)(AlignToCacheLine(bytes) - bytes);
+		if (written && paddingBytes > 0)
+			written = fwrite(padding, 1, paddingBytes, file) == paddingBytes;
+	};
+
+	writeSection(&header, sizeof(header));
+	poly.ForEachColumn([&](auto& column)
+	{
+		writeSection(column.Data(), sizeof(column[0]) * bodyCount);
+	});
+	writeSection(engine.GetLocalAABBs(), sizeof(AABB) * bodyCount);
+	writeSection(engine.GetBVH4Nodes(), sizeof(Node4) * nodeCount);
+	writeSection(engine.GetStaticBVH4Nodes(), sizeof(Node4) * staticNodeCount);
+
+	return fclose(file) == 0 && written;
+}
+
+bool	CSceneFile::Load(const char* path, CWorld& world, CPhysicEngine& engine)
+{
+	CMappedFile file;
+	if (!file.Open(path) || file.GetSize() < sizeof(SSceneFileHeader))
+		return false;
+
+	const uint8_t* data = file.GetData();
+
+	SSceneFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, s_sceneFileMagic, sizeof(header.magic)) != 0 || header.version != SCENE_FILE_VERSION)
+		return false;
+
+	const size_t bodyCount = (size_t)header.bodyCount;
+	auto isValid = [&file](const SSceneFileSection& section, size_t elementSize, size_t count)
+	{
+		return section.offset % CACHE_LINE_SIZE == 0 && section.elementSize == elementSize && section.count == count
+			&& section.offset <= file.GetSize() && section.count <= (file.GetSize() - section.offset) / section.elementSize;
+	};
+
+	// The columns of the file must be the ones of this build, with the same layout
+	CPolygon& poly = world.GetPolygons();
+	uint32_t columnCount = 0;
+	bool valid = header.columnCount <= SCENE_FILE_MAX_COLUMNS;
+	poly.ForEachColumn([&](auto& column)
+	{
+		valid = valid && columnCount < header.columnCount && isValid(header.columns[columnCount], sizeof(column[0]), bodyCount);
+		columnCount++;
+	});
+
+	valid = valid && columnCount == header.columnCount;
+	valid = valid && isValid(header.localAABBs, sizeof(AABB), bodyCount);
+	valid = valid && isValid(header.bvh4Nodes, sizeof(Node4), (size_t)header.bvh4Nodes.count);
+	valid = valid && isValid(header.staticBVH4Nodes, sizeof(Node4), (size_t)header.staticBVH4Nodes.count);
+	if (!valid)
+		return false;
+
+	// The leaves of the trees are indices in the file, they only match the world if it has no other body
+	const bool emptyWorld = world.GetPolygonCount() == 0;
+
+	const size_t first = world.AddBodies(bodyCount);
+
+	size_t column = 0;
+	poly.ForEachColumn([&](auto& target)
+	{
+		memcpy(target.Data() + first, data + header.columns[column].offset, sizeof(target[0]) * bodyCount);
+		column++;
+	});
+
+	engine.AddLocalAABBs(reinterpret_cast<const AABB*>(data + header.localAABBs.offset), bodyCount);
+
+	world.NotifyBodiesAdded(first, bodyCount);
+
+	if (!emptyWorld)
+		return true;
+
+	const Node4* nodes = reinterpret_cast<const Node4*>(data + header.bvh4Nodes.offset);
+	const Node4* staticNodes = reinterpret_cast<const Node4*>(data + header.staticBVH4Nodes.offset);
+	const size_t nodeCount = (size_t)header.bvh4Nodes.count;
+	const size_t staticNodeCount = (size_t)header.staticBVH4Nodes.count;
+
+	// Trees pointing outside of their nodes or of the bodies are built again from the bodies
+	if (!IsTreeValid(nodes, nodeCount, bodyCount) || !IsTreeValid(staticNodes, staticNodeCount, bodyCount))
+	{
+		engine.BuildBVH4();
+		return true;
+	}
+
+	if (nodeCount > 0)
+		engine.SetBVH4(nodes, nodeCount);
+
+	// Otherwise the static tree is built again at the next step
+	if (header.hasStaticBVH4 != 0)
+		engine.SetStaticBVH4(staticNodes, staticNodeCount);
+
+	return true;
+}
@@ -0,0 +1,215 @@
+#include "SceneRecording.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "World.h"
+
+#define SCENE_RECORDING_VERSION 3
+
+struct SSceneRecordingHeader
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	bodyCount;
+	uint32_t	fastBodyCount;
+	// Rewritten when the recording stops
+	uint32_t	frameCount;
+};
+
+static const char s_recordingMagic[4] = { 'C', 'R', 'E', 'C' };
+
+CSceneRecorder::~CSceneRecorder()
+{
+	Stop();
+}
+
+bool	CSceneRecorder::Start(const char* path, CWorld& world)
+{
+	Stop();
+
+	m_file = fopen(path, "wb");
+	if (m_file == nullptr)
+		return false;
+
+	const CPolygon& poly = world.GetPolygons();
+	m_bodyCount = poly.polyCount;
+	m_frameCount = 0;
+
+	uint32_t fastBodyCount = 0;
+	for (size_t i = 0; i < m_bodyCount; i++)
+		fastBodyCount += poly.fast[i] ? 1 : 0;
+
+	SSceneRecordingHeader header;
+	memcpy(header.magic, s_recordingMagic, sizeof(header.magic));
+	header.version = SCENE_RECORDING_VERSION;
+	header.bodyCount = (uint32_t)m_bodyCount;
+	header.fastBodyCount = fastBodyCount;
+	header.frameCount = 0;
+
+	bool written = fwrite(&header, sizeof(header), 1, m_file) == 1;
+
+	for (size_t i = 0; i < m_bodyCount && written; i++)
+	{
+		SRecordedBody body;
+		body.shapeType = (uint8_t)poly.shapeType[i];
+		body.fast = poly.fast[i] ? 1 : 0;
+		body.isStatic = poly.isStatic[i] ? 1 : 0;
+		body.padding = 0;
+		body.halfExtentX = poly.halfExtentX[i];
+		body.halfExtentY = poly.halfExtentY[i];
+		body.radius = poly.radius[i];
+
+		written = fwrite(&body, sizeof(body), 1, m_file) == 1;
+	}
+
+	if (!written)
+	{
+		fclose(m_file);
+		m_file = nullptr;
+	}
+
+	return written;
+}
+
+bool	CSceneRecorder::RecordFrame(CWorld& world, float deltaTime)
+{
+	if (m_file == nullptr)
+		return false;
+
+	const CPolygon& poly = world.GetPolygons();
+	if (poly.polyCount != m_bodyCount)
+	{
+		Stop();
+		return false;
+	}
+
+	// The columns are written as they are, a frame is a few large writes
+	bool written = fwrite(&deltaTime, sizeof(deltaTime), 1, m_file) == 1;
+	written = written && fwrite(poly.positionX.Data(), sizeof(float), m_bodyCount, m_file) == m_bodyCount;
+	written = written && fwrite(poly.positionY.Data(), sizeof(float), m_bodyCount, m_file) == m_bodyCount;
+	written = written && fwrite(poly.angle.Data(), sizeof(float), m_bodyCount, m_file) == m_bodyCount;
+	written = written && fwrite(poly.speed.Data(), sizeof(Vec2), m_bodyCount, m_file) == m_bodyCount;
+
+	if (!written)
+	{
+		Stop();
+		return false;
+	}
+
+	m_frameCount++;
+	return true;
+}
+
+bool	CSceneRecorder::Stop()
+{
+	if (m_file == nullptr)
+		return false;
+
+	const uint32_t frameCount = (uint32_t)m_frameCount;
+	bool written = fseek(m_file, (long)offsetof(SSceneRecordingHeader, frameCount), SEEK_SET) == 0;
+	written = written && fwrite(&frameCount, sizeof(frameCount), 1, m_file) == 1;
+	written = fclose(m_file) == 0 && written;
+	m_file = nullptr;
+
+	return written;
+}
+
+CSceneReplay::~CSceneReplay()
+{
+	Close();
+}
+
+bool	CSceneReplay::Open(const char* path)
+{
+	Close();
+
+	m_file = fopen(path, "rb");
+	if (m_file == nullptr)
+		return false;
+
+	SSceneRecordingHeader header;
+	bool valid = fread(&header, sizeof(header), 1, m_file) == 1
+		&& memcmp(header.magic, s_recordingMagic, sizeof(header.magic)) == 0
+		&& header.version == SCENE_RECORDING_VERSION;
+
+	if (valid)
+	{
+		m_bodies.resize(header.bodyCount);
+		valid = fread(m_bodies.data(), sizeof(SRecordedBody), m_bodies.size(), m_file) == m_bodies.size();
+	}
+
+	uint32_t fastBodyCount = 0;
+	for (size_t i = 0; i < m_bodies.size() && valid; i++)
+	{
+		valid = m_bodies[i].shapeType < (uint8_t)ShapeType::Count;
+		fastBodyCount += m_bodies[i].fast ? 1 : 0;
+	}
+
+	if (!valid || fastBodyCount != header.fastBodyCount)
+	{
+		Close();
+		return false;
+	}
+
+	m_frameCount = header.frameCount;
+	m_nextFrame = 0;
+	return true;
+}
+
+void	CSceneReplay::Close()
+{
+	if (m_file != nullptr)
+		fclose(m_file);
+
+	m_file = nullptr;
+	m_frameCount = 0;
+	m_nextFrame = 0;
+	m_bodies.clear();
+}
+
+void	CSceneReplay::CreateBodies(CWorld& world) const
+{
+	CPolygon& poly = world.GetPolygons();
+
+	// The positions and angles are set by the frames
+	for (const SRecordedBody& body : m_bodies)
+	{
+		SBodyHandle handle;
+		switch ((ShapeType)body.shapeType)
+		{
+		case ShapeType::OBB:		handle = world.AddRectangle(body.halfExtentX * 2.0f, body.halfExtentY * 2.0f, Vec2()); break;
+		case ShapeType::Circle:		handle = world.AddCircle(body.radius, Vec2()); break;
+		case ShapeType::Capsule:	handle = world.AddCapsule(body.halfExtentX, body.radius, Vec2()); break;
+		default:					continue;
+		}
+
+		poly.fast[world.GetBodyIndex(handle)] = body.fast != 0;
+		if (body.isStatic != 0)
+			world.SetStatic(handle, true);
+	}
+}
+
+bool	CSceneReplay::ReadFrame(CWorld& world, float& deltaTime)
+{
+	CPolygon& poly = world.GetPolygons();
+	const size_t bodyCount = m_bodies.size();
+
+	if (m_file == nullptr || m_nextFrame >= m_frameCount || poly.polyCount != bodyCount)
+		return false;
+
+	// Read straight into the columns of the world
+	bool read = fread(&deltaTime, sizeof(deltaTime), 1, m_file) == 1;
+	read = read && fread(poly.positionX.Data(), sizeof(float), bodyCount, m_file) == bodyCount;
+	read = read && fread(poly.positionY.Data(), sizeof(float), bodyCount, m_file) == bodyCount;
+	read = read && fread(poly.angle.Data(), sizeof(float), bodyCount, m_file) == bodyCount;
+	read = read && fread(poly.speed.Data(), sizeof(Vec2), bodyCount, m_file) == bodyCount;
+
+	if (!read)
+		return false;
+
+	poly.UpdateRotations(0, bodyCount);
+
+	m_nextFrame++;
+	return true;
+}
@@ -1,17 +1,47 @@
 #include "Timer.h"
 
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define HAS_TIMESTAMP_COUNTER
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TIMESTAMP_COUNTER
+#endif
+
 void CTimer::Start()
 {
-	QueryPerformanceFrequency(&m_frequency);
-	QueryPerformanceCounter(&m_startTime);
+	m_startTime = std::chrono::steady_clock::now();
 }
 
 void CTimer::Stop()
 {
-	QueryPerformanceCounter(&m_stopTime);
+	m_stopTime = std::chrono::steady_clock::now();
 }
 
 float	CTimer::GetDuration() const
 {
-	return (float)(m_stopTime.QuadPart - m_startTime.QuadPart) / (float)m_frequency.QuadPart;
-}
\ No newline at end of file
+	return std::chrono::duration<float>(m_stopTime - m_startTime).count();
+}
+
+uint64_t	ReadTimestamp()
+{
+#ifdef HAS_TIMESTAMP_COUNTER
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double	GetTimestampFrequency(uint64_t startTicks, std::chrono::steady_clock::time_point startTime,
+							  uint64_t endTicks, std::chrono::steady_clock::time_point endTime)
+{
+#ifdef HAS_TIMESTAMP_COUNTER
+	const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+	if (seconds <= 0.0 || endTicks <= startTicks)
+		return 1e9;
+
+	return (double)(endTicks - startTicks) / seconds;
+#else
+	return 1e9;
+#endif
+}
@@ -3,64 +3,87 @@
 #include "GlobalVariables.h"
 #include "physics/PhysicEngine.h"
 
-size_t		CWorld::AddRectangle(float width, float height, const Vec2& position)
+// Number of points used to draw half a circle, circles and capsules outlines are
+// made of two half circles joined by the capsule segment
+#define ROUND_SHAPE_HALF_POINTS 8
+#define MAX_OUTLINE_POINTS (2 * ROUND_SHAPE_HALF_POINTS)
+
+// Outline in local space of a shape given by its columns, returns its point count
+static size_t	GetShapeOutline(ShapeType type, float halfExtentX, float halfExtentY, float radius, float* pointsX, float* pointsY)
 {
-	size_t polyIdx = AddPolygon();
+	if (type == ShapeType::OBB)
+	{
+		pointsX[0] = -halfExtentX;
+		pointsX[1] = halfExtentX;
+		pointsX[2] = halfExtentX;
+		pointsX[3] = -halfExtentX;
+
+		pointsY[0] = -halfExtentY;
+		pointsY[1] = -halfExtentY;
+		pointsY[2] = halfExtentY;
+		pointsY[3] = halfExtentY;
+
+		return 4;
+	}
+
+	// Outline is the right half circle centered on (halfLength, 0) followed
+	// by the left half circle centered on (-halfLength, 0)
+	for (size_t i = 0; i < ROUND_SHAPE_HALF_POINTS; ++i)
+	{
+		const float angle = -0.5f * (float)M_PI + (float)M_PI * (float)i / (float)(ROUND_SHAPE_HALF_POINTS - 1);
+
+		pointsX[i] = halfExtentX + radius * cosf(angle);
+		pointsY[i] = radius * sinf(angle);
+
+		pointsX[i + ROUND_SHAPE_HALF_POINTS] = -pointsX[i];
+		pointsY[i + ROUND_SHAPE_HALF_POINTS] = -pointsY[i];
+	}
 
+	return 2 * ROUND_SHAPE_HALF_POINTS;
+}
+
+SBodyHandle	CWorld::AddRectangle(float width, float height, const Vec2& position)
+{
 	const float halfWidth  = fabs(width) * 0.5f;
 	const float halfHeight = fabs(height) * 0.5f;
 
 	float pointsX[4];
 	float pointsY[4];
+	GetShapeOutline(ShapeType::OBB, halfWidth, halfHeight, 0.0f, pointsX, pointsY);
 
-	pointsX[0] = -halfWidth;
-	pointsX[1] = halfWidth;
-	pointsX[2] = halfWidth;
-	pointsX[3] = -halfWidth;
-
-	pointsY[0] = -halfHeight;
-	pointsY[1] = -halfHeight;
-	pointsY[2] = halfHeight;
-	pointsY[3] = halfHeight;
-
-	polygons.Build(polyIdx, pointsX, pointsY);
+	SBodyHandle body = AddPolygon(pointsX, pointsY, 4);
+	size_t polyIdx = GetBodyIndex(body);
 
-	polygons.rotation[polyIdx].SetAngle(0.0f);
+	polygons.SetAngle(polyIdx, 0.0f);
 
+	polygons.shapeType[polyIdx] = ShapeType::OBB;
 	polygons.SetExtent(polyIdx, { halfWidth, halfHeight });
+	polygons.SetRadius(polyIdx, 0.0f);
 
 	gVars->pPhysicEngine->AddLocalAABB(AABB({ -halfWidth, -halfHeight}, {halfWidth, halfHeight}));
 
 	polygons.SetPosition(polyIdx, position);
 
-	return polyIdx;
+	return body;
 }
 
-size_t		CWorld::AddRandomRectangle(const SRandomPolyParams& params)
+SBodyHandle	CWorld::AddRandomRectangle(const SRandomPolyParams& params)
 {
-	size_t polyIdx = AddPolygon();
-
 	const float halfWidth = fabs(Random(params.minRadius, params.maxRadius)) * 0.5f;
 	const float halfHeight = fabs(Random(params.minRadius, params.maxRadius)) * 0.5f;
 
 	float pointsX[4];
 	float pointsY[4];
+	GetShapeOutline(ShapeType::OBB, halfWidth, halfHeight, 0.0f, pointsX, pointsY);
 
-	pointsX[0] = -halfWidth;
-	pointsX[1] = halfWidth;
-	pointsX[2] = halfWidth;
-	pointsX[3] = -halfWidth;
-
-	pointsY[0] = -halfHeight;
-	pointsY[1] = -halfHeight;
-	pointsY[2] = halfHeight;
-	pointsY[3] = halfHeight;
-
-	polygons.Build(polyIdx, pointsX, pointsY);
+	SBodyHandle body = AddPolygon(pointsX, pointsY, 4);
+	size_t polyIdx = GetBodyIndex(body);
 
+	polygons.shapeType[polyIdx] = ShapeType::OBB;
 	polygons.SetExtent(polyIdx, { halfWidth, halfHeight });
+	polygons.SetRadius(polyIdx, 0.0f);
 
-	polygons.rotation[polyIdx].SetAngle(Random(-180.0f, 180.0f));
+	polygons.SetAngle(polyIdx, Random(-180.0f, 180.0f));
 
 	polygons.SetPosition(polyIdx, { Random(params.minBounds.x, params.maxBounds.x), Random(params.minBounds.y, params.maxBounds.y) });
 
@@ -70,49 +93,155 @@ size_t		CWorld::AddRandomRectangle(const SRandomPolyParams& params)
 
 	gVars->pPhysicEngine->AddLocalAABB(AABB({ -halfWidth, -halfHeight }, { halfWidth, halfHeight }));
 
-	return polyIdx;
+	return body;
+}
+
+SBodyHandle	CWorld::AddCircle(float radius, const Vec2& position)
+{
+	return AddRoundShape(ShapeType::Circle, 0.0f, radius, position);
+}
+
+SBodyHandle	CWorld::AddRandomCircle(const SRandomPolyParams& params)
+{
+	const float radius = fabs(Random(params.minRadius, params.maxRadius)) * 0.5f;
+
+	SBodyHandle body = AddRoundShape(ShapeType::Circle, 0.0f, radius, { Random(params.minBounds.x, params.maxBounds.x), Random(params.minBounds.y, params.maxBounds.y) });
+	size_t polyIdx = GetBodyIndex(body);
+
+	Mat2 rot;
+	rot.SetAngle(Random(-180.0f, 180.0f));
+	polygons.speed[polyIdx] = rot.X * Random(params.minSpeed, params.maxSpeed);
+
+	return body;
+}
+
+SBodyHandle	CWorld::AddCapsule(float halfLength, float radius, const Vec2& position)
+{
+	return AddRoundShape(ShapeType::Capsule, halfLength, radius, position);
+}
+
+SBodyHandle	CWorld::AddRandomCapsule(const SRandomPolyParams& params)
+{
+	// Keep the overall length of the capsule in the same range as the other random shapes
+	const float length = fabs(Random(params.minRadius, params.maxRadius));
+	const float radius = length * Random(0.15f, 0.3f);
+
+	SBodyHandle body = AddRoundShape(ShapeType::Capsule, length * 0.5f - radius, radius, { Random(params.minBounds.x, params.maxBounds.x), Random(params.minBounds.y, params.maxBounds.y) });
+	size_t polyIdx = GetBodyIndex(body);
+
+	polygons.SetAngle(polyIdx, Random(-180.0f, 180.0f));
+
+	Mat2 rot;
+	rot.SetAngle(Random(-180.0f, 180.0f));
+	polygons.speed[polyIdx] = rot.X * Random(params.minSpeed, params.maxSpeed);
+
+	return body;
+}
+
+SBodyHandle	CWorld::AddRoundShape(ShapeType type, float halfLength, float radius, const Vec2& position)
+{
+	float pointsX[MAX_OUTLINE_POINTS];
+	float pointsY[MAX_OUTLINE_POINTS];
+	const size_t pointCount = GetShapeOutline(type, halfLength, 0.0f, radius, pointsX, pointsY);
+
+	SBodyHandle body = AddPolygon(pointsX, pointsY, pointCount);
+	size_t polyIdx = GetBodyIndex(body);
+
+	polygons.SetAngle(polyIdx, 0.0f);
+
+	polygons.shapeType[polyIdx] = type;
+	polygons.SetExtent(polyIdx, { halfLength, 0.0f });
+	polygons.SetRadius(polyIdx, radius);
+
+	gVars->pPhysicEngine->AddLocalAABB(AABB({ -halfLength - radius, -radius }, { halfLength + radius, radius }));
+
+	polygons.SetPosition(polyIdx, position);
+
+	return body;
 }
 
-size_t		CWorld::AddPolygon()
+SBodyHandle	CWorld::AddPolygon(const float* pointsX, const float* pointsY, size_t pointCount)
 {
-	//CPolygonPtr poly( new CPolygon(m_polygons.size()) );
-	//m_polygons.push_back(poly);
-	size_t idx = polygons.polyCount;
-	polygons.polyCount++;
-	return idx;
+	const size_t index = polygons.Add();
+	if (m_bodyObserver != nullptr)
+		m_bodyObserver->OnBodyAdded(index, pointsX, pointsY, pointCount);
+
+	return m_bodyHandles.Create();
 }
 
-// WARNING
-void	CWorld::RemovePolygon(size_t index)
+size_t	CWorld::AddBodies(size_t count)
 {
-	polygons.polyCount--;
-	//if (index + 1 < m_polygons.size())
-	//{
-	//	CPolygonPtr movedPoly = m_polygons[m_polygons.size() - 1];
-	//	m_polygons[index] = movedPoly;
-	//	movedPoly->m_index = index;
-	//	m_polygons.pop_back();
+	const size_t first = polygons.AddRange(count);
+	for (size_t i = 0; i < count; i++)
+		m_bodyHandles.Create();
 
-	//	gVars->pPhysicEngine->RemoveLocalAABB(index);
-	//}
+	return first;
+}
+
+void	CWorld::NotifyBodiesAdded(size_t first, size_t count)
+{
+	if (m_bodyObserver == nullptr)
+		return;
+
+	float pointsX[MAX_OUTLINE_POINTS];
+	float pointsY[MAX_OUTLINE_POINTS];
+
+	for (size_t i = first; i < first + count; i++)
+	{
+		const size_t pointCount = GetShapeOutline(polygons.shapeType[i], polygons.halfExtentX[i], polygons.halfExtentY[i], polygons.radius[i], pointsX, pointsY);
+		m_bodyObserver->OnBodyAdded(i, pointsX, pointsY, pointCount);
+	}
+}
+
+void	CWorld::RemovePolygon(SBodyHandle body)
+{
+	if (!m_bodyHandles.IsValid(body))
+		return;
+
+	// Every per body column is swap removed here so that they all stay in the same order
+	const size_t index = m_bodyHandles.Remove(body);
+
+	// The static tree holds the indices of the removed body and of the one taking its place
+	if (polygons.isStatic[index] || polygons.isStatic[polygons.polyCount - 1])
+		gVars->pPhysicEngine->InvalidateStaticBVH();
+
+	polygons.SwapRemove(index);
+	gVars->pPhysicEngine->RemoveLocalAABB(index);
+	if (m_bodyObserver != nullptr)
+		m_bodyObserver->OnBodyRemoved(index);
+}
+
+void	CWorld::SetStatic(SBodyHandle body, bool isStatic)
+{
+	if (!m_bodyHandles.IsValid(body))
+		return;
+
+	const size_t index = m_bodyHandles.GetIndex(body);
+	if (polygons.isStatic[index] == isStatic)
+		return;
+
+	polygons.isStatic[index] = isStatic;
+	if (isStatic)
+	{
+		polygons.speed[index] = Vec2();
+		polygons.angularSpeed[index] = 0.0f;
+		polygons.fast[index] = false;
+	}
+
+	gVars->pPhysicEngine->InvalidateStaticBVH();
 }
 
-// WARNING
 void	CWorld::RemoveBehavior(CBehaviorPtr behavior)
 {
-	//if (behavior->poly)
-	//{
-	//	RemovePolygon(behavior->poly);
-	//}
+	RemovePolygon(behavior->body);
 
-	//size_t index = behavior->m_index;
+	const size_t index = behavior->m_index;
+	if (index >= m_behaviors.size() || m_behaviors[index] != behavior)
+		return;
 
-	//if (index + 1 < m_polygons.size())
-	//{
-	//	CBehaviorPtr movedBhv = m_behaviors[m_behaviors.size() - 1];
-	//	m_behaviors[index] = movedBhv;
-	//	movedBhv->m_index = index;
-	//}
+	m_behaviors[index] = m_behaviors.back();
+	m_behaviors[index]->m_index = index;
+	m_behaviors.pop_back();
 }
 
 size_t	CWorld::GetPolygonCount() const
@@ -123,18 +252,14 @@ size_t	CWorld::GetPolygonCount() const
 
 void	CWorld::Update(float frameTime)
 {
-	for(CBehaviorPtr behavior : m_behaviors)
+	// Indexed loop so that behaviors can be removed while updating
+	for (size_t i = 0; i < m_behaviors.size(); ++i)
 	{
+		CBehaviorPtr behavior = m_behaviors[i];
 		behavior->Update(frameTime);
 	}
 }
 
-void	CWorld::RenderPolygons()
-{
-	for (size_t i = 0; i < polygons.polyCount; ++i)
-		polygons.Draw(i);
-}
-
 CPolygon& CWorld::GetPolygons()
 {
 	return polygons;
@@ -10,6 +10,7 @@
 #include "scenes/SceneManager.h"
 #include "scenes/SceneDebugCollisions.h"
 #include "scenes/SceneBouncingPolys.h"
+#include "scenes/SceneBouncingShapes.h"
 
 
 /*
@@ -21,6 +22,7 @@ int _tmain(int argc, char** argv)
 
 	gVars->pSceneManager->AddScene(new CSceneDebugCollisions());
 	gVars->pSceneManager->AddScene(new CSceneBouncingPolys(200));
+	gVars->pSceneManager->AddScene(new CSceneBouncingShapes(300));
 
 
 	RunApplication();
@@ -1,29 +1,49 @@
-#include "physics\BroadPhaseAABBTree.h"
+#include "physics/BroadPhaseAABBTree.h"
 
 #include "GlobalVariables.h"
 #include "World.h"
 
-void CBroadPhaseAABBTree::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
+void CBroadPhaseAABBTree::GetCollidingPairsToCheck(CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats)
 {
+    stats.nodesVisited = 0;
+    stats.aabbTests = 0;
+    stats.leafHits = 0;
+
     size_t polyCount = gVars->pWorld->GetPolygonCount();
+    const CPolygon& poly = gVars->pWorld->GetPolygons();
     const Node4* bvh4Nodes = gVars->pPhysicEngine->GetBVH4Nodes();
+    const bool hasDynamicTree = gVars->pPhysicEngine->GetBVH4NodeCount() > 0;
+    const Node4* staticBVH4Nodes = gVars->pPhysicEngine->GetStaticBVH4Nodes();
+    const bool hasStaticTree = gVars->pPhysicEngine->GetStaticBVH4NodeCount() > 0;
 
     for (size_t i = 0; i < polyCount; i++)
     {
+        // Static bodies are only paired with the dynamic bodies that query their tree
+        if (poly.isStatic[i])
+            continue;
+
         // Expand the AABB of the polygon we're going to test into a PackedAABB
         // so that it can be tested against the 4 AABBs in a BVH4 node at once
         PackedAABB polyAABBPacked(gVars->pPhysicEngine->GetWorldAABB(i));
 
-        BVH4TraversalRecurse(i, polyAABBPacked, bvh4Nodes, 0, pairsToCheck);
+        // The dynamic tree holds the polygon itself, only the leaves of higher index are
+        // reported so that each pair is added once. All the static leaves are reported
+        if (hasDynamicTree)
+            BVH4TraversalRecurse(i, i + 1, polyAABBPacked, bvh4Nodes, 0, pairsToCheck, stats);
+        if (hasStaticTree)
+            BVH4TraversalRecurse(i, 0, polyAABBPacked, staticBVH4Nodes, 0, pairsToCheck, stats);
     }
 }
 
-void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, const PackedAABB& polyAABBPacked, const Node4* bvh4Nodes, int32_t currentNodeIndex, std::vector<SPolygonPair>& pairsToCheck) const noexcept
+void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, size_t firstLeafIndex, const PackedAABB& polyAABBPacked, const Node4* bvh4Nodes, int32_t currentNodeIndex, CFrameArray<SPolygonPair>& pairsToCheck, SPhysicStats& stats) const noexcept
 {
     const Node4& node = bvh4Nodes[currentNodeIndex];
     // Overlap test between the AABB of the polygon and all the AABBs in the BVH4 node
     int collisionMask = PackedAABB::Intersect(polyAABBPacked, node.packedAABBs);
 
+    stats.nodesVisited++;
+    stats.aabbTests += 4;
+
     // Check if the first AABB in the node has returned a hit
     if (collisionMask & 0b0001)
     {
@@ -32,15 +52,18 @@ void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, const PackedAAB
         // If it's a leaf we have a potential collision with another polygon
         if (child.isLeaf)
         {
+            stats.leafHits++;
+
             // Don't add the pair if it's the polygone we're testing (child.index == polyIndex),
             // or one that has already been tested against the tree (childIndex < polyIndex) in
-            // which case the potential collision has already been reported
-            if (child.index > polyIndex)
-                pairsToCheck.push_back(SPolygonPair(polyIndex, child.index));
+            // which case the potential collision has already been reported, firstLeafIndex
+            // is past both of them in the dynamic tree
+            if ((size_t)child.index >= firstLeafIndex)
+                pairsToCheck.PushBack(SPolygonPair(polyIndex, child.index));
         }
         // If it's a node continue travelling down the tree
         else
-            BVH4TraversalRecurse(polyIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck);
+            BVH4TraversalRecurse(polyIndex, firstLeafIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck, stats);
     }
 
     // Loop unrolling Agner Fog's style YAY \o/
@@ -51,11 +74,13 @@ void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, const PackedAAB
 
         if (child.isLeaf)
         {
-            if (child.index > polyIndex)
-                pairsToCheck.push_back(SPolygonPair(polyIndex, child.index));
+            stats.leafHits++;
+
+            if ((size_t)child.index >= firstLeafIndex)
+                pairsToCheck.PushBack(SPolygonPair(polyIndex, child.index));
         }
         else
-            BVH4TraversalRecurse(polyIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck);
+            BVH4TraversalRecurse(polyIndex, firstLeafIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck, stats);
     }
 
     if (collisionMask & 0b0100)
@@ -64,11 +89,13 @@ void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, const PackedAAB
 
         if (child.isLeaf)
         {
-            if (child.index > polyIndex)
-                pairsToCheck.push_back(SPolygonPair(polyIndex, child.index));
+            stats.leafHits++;
+
+            if ((size_t)child.index >= firstLeafIndex)
+                pairsToCheck.PushBack(SPolygonPair(polyIndex, child.index));
         }
         else
-            BVH4TraversalRecurse(polyIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck);
+            BVH4TraversalRecurse(polyIndex, firstLeafIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck, stats);
     }
 
     if (collisionMask & 0b1000)
@@ -77,10 +104,12 @@ void CBroadPhaseAABBTree::BVH4TraversalRecurse(size_t polyIndex, const PackedAAB
 
         if (child.isLeaf)
         {
-            if (child.index > polyIndex)
-                pairsToCheck.push_back(SPolygonPair(polyIndex, child.index));
+            stats.leafHits++;
+
+            if ((size_t)child.index >= firstLeafIndex)
+                pairsToCheck.PushBack(SPolygonPair(polyIndex, child.index));
         }
         else
-            BVH4TraversalRecurse(polyIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck);
+            BVH4TraversalRecurse(polyIndex, firstLeafIndex, polyAABBPacked, bvh4Nodes, child.index, pairsToCheck, stats);
     }
 }
\ No newline at end of file
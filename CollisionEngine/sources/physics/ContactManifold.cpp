@@ -0,0 +1,249 @@
+#include "physics/ContactManifold.h"
+
+#include <cfloat>
+#include <utility>
+
+#include "shapes/Polygon.h"
+
+struct SBox
+{
+	Vec2	center;
+	Vec2	axes[2];
+	float	extents[2];
+};
+
+static SBox GetBox(const CPolygon& poly, size_t index)
+{
+	SBox box;
+	box.center = poly.GetPosition(index);
+	const Mat2 rotation = poly.GetRotation(index);
+	box.axes[0] = rotation.X;
+	box.axes[1] = rotation.Y;
+
+	const Vec2 extent = poly.GetExtent(index);
+	box.extents[0] = extent.x;
+	box.extents[1] = extent.y;
+
+	return box;
+}
+
+// Vertices are in counter clockwise order, face i goes from vertex i to vertex i + 1
+static Vec2 GetBoxVertex(const SBox& box, size_t vertex)
+{
+	static const float signX[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+	static const float signY[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+
+	return box.center + box.axes[0] * (box.extents[0] * signX[vertex]) + box.axes[1] * (box.extents[1] * signY[vertex]);
+}
+
+// Faces 0 to 3 have normals X, Y, -X and -Y
+static Vec2 GetBoxFaceNormal(const SBox& box, size_t face)
+{
+	return face < 2 ? box.axes[face] : box.axes[face - 2] * -1.0f;
+}
+
+// Largest distance between a face of the box and the other box, negative if they overlap
+static float FindMaxSeparation(const SBox& box, const SBox& other, size_t& bestFace)
+{
+	float bestSeparation = -FLT_MAX;
+
+	for (size_t face = 0; face < 4; face++)
+	{
+		const Vec2 normal = GetBoxFaceNormal(box, face);
+
+		// Projection of the deepest point of the other box along the face normal
+		const float otherMin = (other.center | normal)
+			- other.extents[0] * fabsf(other.axes[0] | normal)
+			- other.extents[1] * fabsf(other.axes[1] | normal);
+		const float faceOffset = (box.center | normal) + box.extents[face % 2];
+
+		const float separation = otherMin - faceOffset;
+		if (separation > bestSeparation)
+		{
+			bestSeparation = separation;
+			bestFace = face;
+		}
+	}
+
+	return bestSeparation;
+}
+
+// Keeps the part of the segment where normal | point <= offset, the clipped
+// end point gets the feature ID of the clipping plane
+static bool ClipSegment(Vec2 points[2], uint32_t featureIds[2], const Vec2& normal, float offset, uint32_t clipFeatureId)
+{
+	const float distance0 = (normal | points[0]) - offset;
+	const float distance1 = (normal | points[1]) - offset;
+
+	if (distance0 > 0.0f && distance1 > 0.0f)
+		return false;
+
+	if (distance0 > 0.0f)
+	{
+		points[0] = points[0] + (points[1] - points[0]) * (distance0 / (distance0 - distance1));
+		featureIds[0] = clipFeatureId;
+	}
+	else if (distance1 > 0.0f)
+	{
+		points[1] = points[1] + (points[0] - points[1]) * (distance1 / (distance1 - distance0));
+		featureIds[1] = clipFeatureId;
+	}
+
+	return true;
+}
+
+bool	BuildOBBManifold(const CPolygon& poly, size_t polyA, size_t polyB, SContactManifold& manifold)
+{
+	/*
+	* Same clipping algorithm as Box2D's b2CollidePolygons:
+	* 	- The face with the largest separation over both boxes is the reference
+	* 	  face, the face of the other box most facing it is the incident face
+	* 	- The incident face is clipped against the side planes of the reference
+	* 	  face, and the clipped points below the reference face are the contacts
+	* Each contact point is named after the features it comes from so that it
+	* can be matched with the contacts of the previous frame.
+	*/
+
+	manifold.polyA = polyA;
+	manifold.polyB = polyB;
+	manifold.pointCount = 0;
+
+	const SBox boxA = GetBox(poly, polyA);
+	const SBox boxB = GetBox(poly, polyB);
+
+	size_t faceA = 0;
+	const float separationA = FindMaxSeparation(boxA, boxB, faceA);
+	if (separationA > 0.0f)
+		return false;
+
+	size_t faceB = 0;
+	const float separationB = FindMaxSeparation(boxB, boxA, faceB);
+	if (separationB > 0.0f)
+		return false;
+
+	// Prefer box A as the reference so that the reference face (and so the
+	// feature IDs) doesn't switch between frames when both are close
+	const bool flipped = separationB > 0.98f * separationA + 0.001f;
+
+	const SBox& reference = flipped ? boxB : boxA;
+	const SBox& incident = flipped ? boxA : boxB;
+	const size_t referenceFace = flipped ? faceB : faceA;
+	const Vec2 referenceNormal = GetBoxFaceNormal(reference, referenceFace);
+
+	size_t incidentFace = 0;
+	float minDot = FLT_MAX;
+	for (size_t face = 0; face < 4; face++)
+	{
+		const float dot = GetBoxFaceNormal(incident, face) | referenceNormal;
+		if (dot < minDot)
+		{
+			minDot = dot;
+			incidentFace = face;
+		}
+	}
+
+	const size_t incidentNext = (incidentFace + 1) % 4;
+	Vec2 points[2] = { GetBoxVertex(incident, incidentFace), GetBoxVertex(incident, incidentNext) };
+	uint32_t featureIds[2] = { (uint32_t)(referenceFace | (incidentFace << 8)), (uint32_t)(referenceFace | (incidentNext << 8)) };
+
+	const size_t referenceNext = (referenceFace + 1) % 4;
+	const Vec2 vertex0 = GetBoxVertex(reference, referenceFace);
+	const Vec2 vertex1 = GetBoxVertex(reference, referenceNext);
+	const Vec2 tangent = (vertex1 - vertex0).Normalized();
+
+	if (!ClipSegment(points, featureIds, tangent * -1.0f, -(tangent | vertex0), (uint32_t)(referenceFace | (referenceFace << 8) | FEATURE_CLIPPED)))
+		return false;
+	if (!ClipSegment(points, featureIds, tangent, tangent | vertex1, (uint32_t)(referenceFace | (referenceNext << 8) | FEATURE_CLIPPED)))
+		return false;
+
+	const float faceOffset = referenceNormal | vertex0;
+	for (size_t i = 0; i < 2; i++)
+	{
+		const float separation = (referenceNormal | points[i]) - faceOffset;
+		if (separation > 0.0f)
+			continue;
+
+		manifold.points[manifold.pointCount] = points[i];
+		manifold.separations[manifold.pointCount] = separation;
+		manifold.featureIds[manifold.pointCount] = featureIds[i] | (flipped ? FEATURE_FLIPPED : 0);
+		manifold.pointCount++;
+	}
+
+	manifold.normal = flipped ? referenceNormal * -1.0f : referenceNormal;
+
+	return manifold.pointCount > 0;
+}
+
+void	CManifoldCache::SColumns::Clear()
+{
+	pairKey.clear();
+	polyA.clear();
+	polyB.clear();
+	normalX.clear();
+	normalY.clear();
+	firstContact.clear();
+	contactCount.clear();
+
+	pointX.clear();
+	pointY.clear();
+	separation.clear();
+	featureId.clear();
+	normalImpulse.clear();
+	tangentImpulse.clear();
+}
+
+void	CManifoldCache::BeginFrame()
+{
+	// Swapping keeps the memory of both frames so adding manifolds doesn't allocate
+	std::swap(m_current, m_previous);
+	m_current.Clear();
+	m_warmStartedCount = 0;
+
+	m_previousManifolds.Clear(m_previous.pairKey.size());
+	for (size_t i = 0; i < m_previous.pairKey.size(); i++)
+		m_previousManifolds.Insert(m_previous.pairKey[i], (uint32_t)i);
+}
+
+void	CManifoldCache::AddManifold(const SContactManifold& manifold, uint64_t pairKey)
+{
+	const uint32_t* previous = m_previousManifolds.Find(pairKey);
+
+	m_current.pairKey.push_back(pairKey);
+	m_current.polyA.push_back((uint32_t)manifold.polyA);
+	m_current.polyB.push_back((uint32_t)manifold.polyB);
+	m_current.normalX.push_back(manifold.normal.x);
+	m_current.normalY.push_back(manifold.normal.y);
+	m_current.firstContact.push_back((uint32_t)m_current.pointX.size());
+	m_current.contactCount.push_back((uint32_t)manifold.pointCount);
+
+	for (size_t i = 0; i < manifold.pointCount; i++)
+	{
+		float normalImpulse = 0.0f;
+		float tangentImpulse = 0.0f;
+
+		// Same features means same contact point, it keeps its impulses
+		if (previous != nullptr)
+		{
+			const uint32_t first = m_previous.firstContact[*previous];
+			const uint32_t end = first + m_previous.contactCount[*previous];
+
+			for (uint32_t contact = first; contact < end; contact++)
+			{
+				if (m_previous.featureId[contact] == manifold.featureIds[i])
+				{
+					normalImpulse = m_previous.normalImpulse[contact];
+					tangentImpulse = m_previous.tangentImpulse[contact];
+					m_warmStartedCount++;
+					break;
+				}
+			}
+		}
+
+		m_current.pointX.push_back(manifold.points[i].x);
+		m_current.pointY.push_back(manifold.points[i].y);
+		m_current.separation.push_back(manifold.separations[i]);
+		m_current.featureId.push_back(manifold.featureIds[i]);
+		m_current.normalImpulse.push_back(normalImpulse);
+		m_current.tangentImpulse.push_back(tangentImpulse);
+	}
+}
@@ -0,0 +1,63 @@
+#include "physics/DoubleBufferedBVH4.h"
+
+#include <thread>
+
+CDoubleBufferedBVH4::CDoubleBufferedBVH4()
+{
+	m_epoch.store(0);
+	m_readers[0].store(0);
+	m_readers[1].store(0);
+}
+
+/*
+* The operations on the epoch and the reader counts are sequentially consistent:
+* if the second load of the epoch by a reader still finds the tree in front, the
+* increment of its reader count comes before the swap, so the builder sees it
+* before it starts writing that tree again.
+*/
+const SBVH4Tree&	CDoubleBufferedBVH4::Acquire() const
+{
+	for (;;)
+	{
+		const uint32_t epoch = m_epoch.load();
+		m_readers[epoch & 1].fetch_add(1);
+
+		if (m_epoch.load() == epoch)
+			return m_trees[epoch & 1];
+
+		// Swapped meanwhile, the tree may already be built again
+		m_readers[epoch & 1].fetch_sub(1);
+	}
+}
+
+void	CDoubleBufferedBVH4::Release(const SBVH4Tree& tree) const
+{
+	// The reads of the tree come before the builder sees the count drop
+	m_readers[&tree - m_trees].fetch_sub(1);
+}
+
+SBVH4Tree&	CDoubleBufferedBVH4::BeginBuild(size_t nodeCapacity)
+{
+	const uint32_t back = (m_epoch.load(std::memory_order_relaxed) + 1) & 1;
+
+	// Readers that acquired the tree before the last swap
+	while (m_readers[back].load() != 0)
+		std::this_thread::yield();
+
+	SBVH4Tree& tree = m_trees[back];
+	if (tree.nodes.Size() < nodeCapacity)
+		tree.nodes.Resize(nodeCapacity);
+
+	return tree;
+}
+
+void	CDoubleBufferedBVH4::EndBuild()
+{
+	m_epoch.fetch_add(1);
+}
+
+void	CDoubleBufferedBVH4::Clear()
+{
+	BeginBuild(0).nodeCount = 0;
+	EndBuild();
+}
@@ -0,0 +1,124 @@
+#include "physics/PairGather.h"
+
+void CPairGather::Gather(const CPolygon& poly, const SSpan<const SPolygonPair>* buckets, size_t bucketCount)
+{
+	// Compute the block range of every bucket
+	m_bucketFirstBlock.resize(bucketCount + 1);
+
+	size_t blockCount = 0;
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		m_bucketFirstBlock[bucket] = blockCount;
+		blockCount += (buckets[bucket].size + 3) / 4;
+	}
+	m_bucketFirstBlock[bucketCount] = blockCount;
+
+	// Round up to an even number of blocks so that the AVX2 path always gathers 8 pairs
+	m_blockCount = (blockCount + 1) & ~(size_t)1;
+
+	const size_t laneCount = m_blockCount * 4;
+	m_indicesA.resize(laneCount);
+	m_indicesB.resize(laneCount);
+	m_columns.Resize(2 * ColumnCount * m_blockCount * 4);
+
+	if (laneCount == 0)
+		return;
+
+	// Flatten the body indices of all the buckets, padding incomplete blocks
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		const SSpan<const SPolygonPair>& pairs = buckets[bucket];
+		const size_t firstLane = m_bucketFirstBlock[bucket] * 4;
+		const size_t endLane = m_bucketFirstBlock[bucket + 1] * 4;
+
+		for (size_t lane = firstLane; lane < endLane; lane++)
+		{
+			const SPolygonPair& pair = pairs[Min(lane - firstLane, pairs.size - 1)];
+			m_indicesA[lane] = (int32_t)pair.polyA;
+			m_indicesB[lane] = (int32_t)pair.polyB;
+		}
+	}
+
+	// The extra block added for the AVX2 path points to the first pair
+	for (size_t lane = blockCount * 4; lane < laneCount; lane++)
+	{
+		m_indicesA[lane] = m_indicesA[0];
+		m_indicesB[lane] = m_indicesB[0];
+	}
+
+	GatherSide(poly, 0, m_indicesA.data());
+	GatherSide(poly, 1, m_indicesB.data());
+}
+
+float* CPairGather::GetColumn(size_t side, Column column) noexcept
+{
+	return m_columns.Data() + (side * ColumnCount + column) * m_blockCount * 4;
+}
+
+SBodyBatch CPairGather::GetBatch(size_t side, size_t block) const noexcept
+{
+	// Columns are a whole number of blocks long, so every block starts on 16 bytes
+	const size_t columnSize = m_blockCount * 4;
+	const float* columns = m_columns.Data() + side * ColumnCount * columnSize + block * 4;
+
+	SBodyBatch batch;
+	batch.posX = _mm_load_ps(columns + PosX * columnSize);
+	batch.posY = _mm_load_ps(columns + PosY * columnSize);
+	batch.cos = _mm_load_ps(columns + Cos * columnSize);
+	batch.sin = _mm_load_ps(columns + Sin * columnSize);
+	batch.extentX = _mm_load_ps(columns + ExtentX * columnSize);
+	batch.extentY = _mm_load_ps(columns + ExtentY * columnSize);
+	batch.radius = _mm_load_ps(columns + Radius * columnSize);
+
+	return batch;
+}
+
+void CPairGather::GatherSide(const CPolygon& poly, size_t side, const int32_t* indices)
+{
+	const float* posX = poly.positionX.Data();
+	const float* posY = poly.positionY.Data();
+	const float* extentX = poly.halfExtentX.Data();
+	const float* extentY = poly.halfExtentY.Data();
+	const float* radius = poly.radius.Data();
+	const float* cos = poly.rotationCos.Data();
+	const float* sin = poly.rotationSin.Data();
+
+	float* outPosX = GetColumn(side, PosX);
+	float* outPosY = GetColumn(side, PosY);
+	float* outCos = GetColumn(side, Cos);
+	float* outSin = GetColumn(side, Sin);
+	float* outExtentX = GetColumn(side, ExtentX);
+	float* outExtentY = GetColumn(side, ExtentY);
+	float* outRadius = GetColumn(side, Radius);
+
+	const size_t laneCount = m_blockCount * 4;
+
+#ifdef __AVX2__
+	// Gather 8 pairs at a time, the scale is the size of a float
+	for (size_t lane = 0; lane < laneCount; lane += 8)
+	{
+		__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + lane));
+
+		_mm256_storeu_ps(outPosX + lane, _mm256_i32gather_ps(posX, index, 4));
+		_mm256_storeu_ps(outPosY + lane, _mm256_i32gather_ps(posY, index, 4));
+		_mm256_storeu_ps(outCos + lane, _mm256_i32gather_ps(cos, index, 4));
+		_mm256_storeu_ps(outSin + lane, _mm256_i32gather_ps(sin, index, 4));
+		_mm256_storeu_ps(outExtentX + lane, _mm256_i32gather_ps(extentX, index, 4));
+		_mm256_storeu_ps(outExtentY + lane, _mm256_i32gather_ps(extentY, index, 4));
+		_mm256_storeu_ps(outRadius + lane, _mm256_i32gather_ps(radius, index, 4));
+	}
+#else
+	for (size_t lane = 0; lane < laneCount; lane++)
+	{
+		const int32_t index = indices[lane];
+
+		outPosX[lane] = posX[index];
+		outPosY[lane] = posY[index];
+		outCos[lane] = cos[index];
+		outSin[lane] = sin[index];
+		outExtentX[lane] = extentX[index];
+		outExtentY[lane] = extentY[index];
+		outRadius[lane] = radius[index];
+	}
+#endif
+}
@@ -3,26 +3,99 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "GlobalVariables.h"
 #include "World.h"
-#include "render/Renderer.h" // for debugging only
 #include "Timer.h"
+#include "Profiler.h"
+#include "CollisionPublisher.h"
+#include "SceneRecording.h"
 
 #include "physics/BroadPhase.h"
 #include "physics/BroadPhaseAABBTree.h"
+#include "physics/ShapeKernels.h"
+#include "physics/PairGather.h"
+#include "JobSystem.h"
 
+// Number of gathered blocks of 4 pairs tested by a single narrow phase task
+#define NARROW_PHASE_CHUNK_BLOCKS 32
+
+const char*	GetStepStageName(StepStage stage)
+{
+	switch (stage)
+	{
+	case StepStage::WorldAABBs:			return "World AABBs";
+	case StepStage::BVH:				return "BVH";
+	case StepStage::BroadPhase:			return "Broad phase";
+	case StepStage::Gather:				return "Gather";
+	case StepStage::NarrowPhase:		return "Narrow phase";
+	case StepStage::ContactManifolds:	return "Contact manifolds";
+	case StepStage::Continuous:			return "CCD";
+	case StepStage::Integration:		return "Integration";
+	default:							return "Unknown";
+	}
+}
 
 void	CPhysicEngine::Reset()
 {
-	m_pairsToCheck.clear();
-	m_collidingPairs.clear();
+	ResetFrameBuffers();
+
+	integrate = false;
 
 	m_localAABBs.clear();
-	m_worldAABBs.clear();
+	m_bvh4.Clear();
+	m_staticBVH4.Clear();
+	m_staticBVHValid = false;
 
 	m_active = true;
+	m_stats = SPhysicStats();
 
 	m_broadPhase = new CBroadPhaseAABBTree();
+
+	if (m_pairGather == nullptr)
+		m_pairGather = new CPairGather();
+
+	if (m_queryGather == nullptr)
+		m_queryGather = new CPairGather();
+
+	if (m_ccdGather == nullptr)
+		m_ccdGather = new CPairGather();
+
+	if (m_jobSystem == nullptr)
+		m_jobSystem = new CJobSystem();
+
+	const std::pair<StepStage, void (CPhysicEngine::*)()> stages[] =
+	{
+		{ StepStage::WorldAABBs, &CPhysicEngine::ComputeWorldAABBs },
+		{ StepStage::BVH, &CPhysicEngine::BuildAABBTree },
+		{ StepStage::BroadPhase, &CPhysicEngine::CollisionBroadPhase },
+		{ StepStage::Gather, &CPhysicEngine::CollisionGather },
+		{ StepStage::NarrowPhase, &CPhysicEngine::CollisionNarrowPhase },
+		{ StepStage::ContactManifolds, &CPhysicEngine::BuildContactManifolds },
+		{ StepStage::Continuous, &CPhysicEngine::CollisionContinuous },
+		{ StepStage::Integration, &CPhysicEngine::Integrate },
+	};
+	for (const auto& stage : stages)
+	{
+		SStepStageJob& job = m_stepStages[(size_t)stage.first];
+		job.engine = this;
+		job.function = stage.second;
+		job.name = GetStepStageName(stage.first);
+		job.duration = 0.0f;
+		job.perfCounters = SPerfCounterValues();
+	}
+}
+
+void	CPhysicEngine::SetJobSystemConfig(const SJobSystemConfig& config)
+{
+	delete m_jobSystem;
+	m_jobSystem = new CJobSystem(config);
+}
+
+size_t	CPhysicEngine::GetThreadCount() const
+{
+	return m_jobSystem != nullptr ? m_jobSystem->GetThreadCount() : 0;
 }
 
 void	CPhysicEngine::Activate(bool active)
@@ -30,37 +103,111 @@ void	CPhysicEngine::Activate(bool active)
 	m_active = active;
 }
 
-void	CPhysicEngine::DetectCollisions()
+void	CPhysicEngine::Step(float deltaTime)
 {
-	CTimer timer;
-	timer.Start();
-	CollisionBroadPhase();
-	timer.Stop();
-	if (gVars->bDebug)
+	if (!m_active)
 	{
-		gVars->pRenderer->DisplayText("Collision broadphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms");
+		//return;
 	}
 
-	timer.Start();
-	CollisionNarrowPhase();
-	timer.Stop();
-	if (gVars->bDebug)
+	PROFILE_SCOPE("Step");
+
+	// The transforms before the step are its whole input, whatever moved the bodies
+	if (gVars->pSceneRecorder != nullptr)
+		gVars->pSceneRecorder->RecordFrame(*gVars->pWorld, deltaTime);
+
+	m_stepTime = deltaTime;
+
+	ResetFrameBuffers();
+
+	/*
+	* The stages run as a graph of jobs, each one starts once the stages whose
+	* output it reads are finished. The continuous collision detection only
+	* needs the pairs of the broad phase so it runs next to the narrow phase.
+	* It sweeps the bodies over the motion of the step from their positions at
+	* the start of the step, so the integration waits for all the others.
+	*/
+	SJob* jobs[(size_t)StepStage::Count];
+	for (size_t stage = 0; stage < (size_t)StepStage::Count; stage++)
+		jobs[stage] = m_jobSystem->CreateJob(&CPhysicEngine::RunStepStage, &m_stepStages[stage]);
+
+	auto addDependency = [&jobs, this](StepStage stage, StepStage dependency)
 	{
-		gVars->pRenderer->DisplayText("Collision narrowphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms");
-	}
-	gVars->pRenderer->DisplayText("collisions: " + std::to_string(m_collidingPairs.size()));
+		m_jobSystem->AddDependency(jobs[(size_t)stage], jobs[(size_t)dependency]);
+	};
+	addDependency(StepStage::BVH, StepStage::WorldAABBs);
+	addDependency(StepStage::BroadPhase, StepStage::BVH);
+	addDependency(StepStage::Gather, StepStage::BroadPhase);
+	addDependency(StepStage::NarrowPhase, StepStage::Gather);
+	addDependency(StepStage::ContactManifolds, StepStage::NarrowPhase);
+	addDependency(StepStage::Continuous, StepStage::BroadPhase);
+	addDependency(StepStage::Integration, StepStage::ContactManifolds);
+	addDependency(StepStage::Integration, StepStage::Continuous);
+
+	for (SJob* job : jobs)
+		m_jobSystem->Run(job);
+
+	m_jobSystem->Wait(jobs[(size_t)StepStage::Integration]);
+
+	if (gVars->pCollisionPublisher != nullptr)
+		gVars->pCollisionPublisher->Publish(*this);
 }
 
-void	CPhysicEngine::Step(float deltaTime)
+void	CPhysicEngine::RunStepStage(void* context, size_t, size_t, size_t)
 {
-	if (!m_active)
+	SStepStageJob& stage = *static_cast<SStepStageJob*>(context);
+	PROFILE_SCOPE(stage.name);
+
+	const bool usePerfCounters = stage.engine->usePerfCounters;
+	SPerfCounterValues startCounters;
+	if (usePerfCounters)
+		CPerfCounterGroup::GetThreadGroup().Read(startCounters);
+
+	CTimer timer;
+	timer.Start();
+	(stage.engine->*stage.function)();
+	timer.Stop();
+
+	stage.duration = timer.GetDuration();
+
+	if (usePerfCounters)
 	{
-		//return;
+		SPerfCounterValues endCounters;
+		CPerfCounterGroup::GetThreadGroup().Read(endCounters);
+		stage.perfCounters = endCounters - startCounters;
 	}
+	else
+	{
+		stage.perfCounters = SPerfCounterValues();
+	}
+}
 
-	BuildAABBTree();
+SPerfCounterValues	CPhysicEngine::GetStepPerfCounters() const
+{
+	SPerfCounterValues counters;
+	for (const SStepStageJob& stage : m_stepStages)
+		counters += stage.perfCounters;
+	return counters;
+}
 
-	DetectCollisions();
+void	CPhysicEngine::ResetFrameBuffers()
+{
+	m_frameArena.Reset();
+
+	m_pairsToCheck.Reset();
+	m_collidingPairs.Reset();
+	m_shapePairs.Reset();
+	m_narrowPhaseChunks.Reset();
+	m_mergeOffsets.Reset();
+	m_obbPairAxes.Reset();
+	m_ccdPairs.Reset();
+	m_timesOfImpact.Reset();
+	m_bodyTimesOfImpact.Reset();
+	m_bodyImpactNormals.Reset();
+	m_worldAABBs.Reset();
+	m_xSortedLeaves.Reset();
+	m_ySortedLeaves.Reset();
+	m_bvh2Nodes.Reset();
 }
 
 void	CPhysicEngine::AddLocalAABB(const AABB& aabb)
@@ -68,90 +215,199 @@ void	CPhysicEngine::AddLocalAABB(const AABB& aabb)
 	m_localAABBs.push_back(aabb);
 }
 
+void	CPhysicEngine::AddLocalAABBs(const AABB* aabbs, size_t count)
+{
+	m_localAABBs.insert(m_localAABBs.end(), aabbs, aabbs + count);
+
+	// Some of the bodies may be static
+	InvalidateStaticBVH();
+}
+
 void CPhysicEngine::RemoveLocalAABB(size_t index)
 {
 	m_localAABBs[index] = m_localAABBs[m_localAABBs.size() - 1];
 	m_localAABBs.pop_back();
 }
 
-void CPhysicEngine::DrawBVH2(const Node2* nodes, const size_t nodeCount)
+void	CPhysicEngine::ComputeWorldAABBs()
 {
-	for (size_t i = 0; i < nodeCount; i++)
+	const size_t objectCount = m_localAABBs.size();
+
+	// Contains the world AABBs of all polygons in the same order as the polygons themselves,
+	// the ones of static bodies are only computed when their tree is built again and copied otherwise
+	m_worldAABBs.Resize(objectCount);
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	const bool skipStaticBodies = m_staticBVHValid;
+
+	// Bodies are independent, split them in batches big enough to cover the cost of a job
+	m_jobSystem->ParallelFor(objectCount, [this, &poly, skipStaticBodies](size_t i, size_t)
 	{
-		AABB::DrawWorld(nodes[i].childAABBs[0]);
-		AABB::DrawWorld(nodes[i].childAABBs[1]);
+		if (skipStaticBodies && poly.isStatic[i])
+		{
+			m_worldAABBs[i] = m_staticWorldAABBs[i];
+			return;
+		}
+
+		// X, Y, X, Y
+		const __m128 pos = _mm_setr_ps(poly.positionX[i], poly.positionY[i], poly.positionX[i], poly.positionY[i]);
+
+		AABB worldAABB = m_localAABBs[i].Transform(pos, poly.rotationCos[i], poly.rotationSin[i]);
+
+		if (poly.fast[i])
+		{
+			// Sweep the AABB of fast bodies over their motion during the step so that the
+			// broad phase also returns the bodies they pass through. The maximum is stored
+			// negated so the union of the start and end boxes is a single min
+			const Vec2 move = poly.speed[i] * m_stepTime;
+			worldAABB = AABB(_mm_min_ps(worldAABB.GetReg(), _mm_add_ps(worldAABB.GetReg(), _mm_set_ps(-move.y, -move.x, move.y, move.x))));
+		}
+
+		m_worldAABBs[i] = worldAABB;
+	}, 1024);
+
+	// Contain Leaf structures of the dynamic bodies, they store a world AABB and the index of the polygon it belongs to
+	m_xSortedLeaves.Resize(objectCount);
+	m_ySortedLeaves.Resize(objectCount);
+
+	size_t leafCount = 0;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		if (!poly.isStatic[i])
+		{
+			m_ySortedLeaves[leafCount] = m_xSortedLeaves[leafCount] = Leaf(m_worldAABBs[i], i);
+			leafCount++;
+		}
 	}
+
+	m_xSortedLeaves.Resize(leafCount);
+	m_ySortedLeaves.Resize(leafCount);
 }
 
-void CPhysicEngine::DrawBVH4(const Node4* nodes, const size_t nodeCount)
+void	CPhysicEngine::SetBVH4(const Node4* nodes, size_t nodeCount)
 {
-	for (size_t i = 0; i < nodeCount; i++)
+	SBVH4Tree& tree = m_bvh4.BeginBuild(nodeCount);
+	std::copy(nodes, nodes + nodeCount, tree.nodes.begin());
+	tree.nodeCount = nodeCount;
+	m_bvh4.EndBuild();
+
+	ComputeBVHStats();
+}
+
+void	CPhysicEngine::SetStaticBVH4(const Node4* nodes, size_t nodeCount)
+{
+	SBVH4Tree& tree = m_staticBVH4.BeginBuild(nodeCount);
+	std::copy(nodes, nodes + nodeCount, tree.nodes.begin());
+	tree.nodeCount = nodeCount;
+	m_staticBVH4.EndBuild();
+
+	// The steps copy the world AABBs of the static bodies instead of computing them
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	m_staticWorldAABBs.resize(m_localAABBs.size());
+	for (size_t i = 0; i < m_localAABBs.size(); i++)
 	{
-		if (nodes[i].children[0].index != -1) AABB::DrawWorld(nodes[i].GetAABB(0));
-		if (nodes[i].children[1].index != -1) AABB::DrawWorld(nodes[i].GetAABB(1));
-		if (nodes[i].children[2].index != -1) AABB::DrawWorld(nodes[i].GetAABB(2));
-		if (nodes[i].children[3].index != -1) AABB::DrawWorld(nodes[i].GetAABB(3));
+		if (poly.isStatic[i])
+		{
+			const __m128 pos = _mm_setr_ps(poly.positionX[i], poly.positionY[i], poly.positionX[i], poly.positionY[i]);
+			m_staticWorldAABBs[i] = m_localAABBs[i].Transform(pos, poly.rotationCos[i], poly.rotationSin[i]);
+		}
 	}
+
+	m_staticBVHValid = true;
+}
+
+void	CPhysicEngine::BuildBVH4()
+{
+	ResetFrameBuffers();
+
+	// No sweep of the fast bodies, the tree is the one of their current positions
+	m_stepTime = 0.0f;
+
+	InvalidateStaticBVH();
+	ComputeWorldAABBs();
+	BuildAABBTree();
 }
 
 void	CPhysicEngine::BuildAABBTree()
 {
-	// We use the std::vector class for easy memory management but pass pointers to the
-	// BVH construction functions to use the lighter pointer syntax compared to iterators
+	// The arrays are allocated from the frame arena, the BVH construction
+	// functions get pointers to use the lighter pointer syntax
 
-	const size_t objectCount = m_localAABBs.size();
+	if (!m_staticBVHValid)
+		BuildStaticAABBTree();
 
-	// Contains the world AABBs of all polygons in the same order as the polygons themselves
-	m_worldAABBs.resize(objectCount);
+	// Readers keep the previous tree until the new one is complete
+	const size_t leafCount = m_xSortedLeaves.Size();
+	SBVH4Tree& tree = m_bvh4.BeginBuild(GetBVH4NodeCapacity(leafCount));
+	tree.nodeCount = BuildBVH4FromLeaves(m_xSortedLeaves.Data(), m_ySortedLeaves.Data(), leafCount, tree.nodes.Data());
+	m_bvh4.EndBuild();
 
-	// Contain Leaf structures, they store a world AABB and the index of the polygon it belongs to
-	m_xSortedLeaves.resize(objectCount);
-	m_ySortedLeaves.resize(objectCount);
-	
-	CPolygon& poly = gVars->pWorld->GetPolygons();
+	ComputeBVHStats();
+}
+
+void	CPhysicEngine::BuildStaticAABBTree()
+{
+	PROFILE_SCOPE("BuildStaticAABBTree");
+
+	// The world AABBs of the static bodies were computed this step because the tree was invalid
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	const size_t objectCount = m_localAABBs.size();
+
+	CFrameArray<Leaf> xSortedLeaves{ m_frameArena };
+	CFrameArray<Leaf> ySortedLeaves{ m_frameArena };
+	xSortedLeaves.Reserve(objectCount - m_xSortedLeaves.Size());
+	ySortedLeaves.Reserve(objectCount - m_xSortedLeaves.Size());
+	m_staticWorldAABBs.resize(objectCount);
 
 	for (size_t i = 0; i < objectCount; i++)
 	{
-		size_t arrayIdx = floor(i / 4);
-		size_t registerIdx = i % 4;
-
-		__m128 pos;
-		// X, X, Y, Y
-		if (registerIdx == 0)
-			pos = _mm_shuffle_ps(poly.positionX[arrayIdx], poly.positionY[arrayIdx], _MM_SHUFFLE(0, 0, 0, 0));
-		else if (registerIdx == 1)
-			pos = _mm_shuffle_ps(poly.positionX[arrayIdx], poly.positionY[arrayIdx], _MM_SHUFFLE(1, 1, 1, 1));
-		else if (registerIdx == 2)
-			pos = _mm_shuffle_ps(poly.positionX[arrayIdx], poly.positionY[arrayIdx], _MM_SHUFFLE(2, 2, 2, 2));
-		else if (registerIdx == 3)
-			pos = _mm_shuffle_ps(poly.positionX[arrayIdx], poly.positionY[arrayIdx], _MM_SHUFFLE(3, 3, 3, 3));
-		// X, Y, X, Y
-		pos = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(2, 0, 2, 0));
+		if (poly.isStatic[i])
+		{
+			m_staticWorldAABBs[i] = m_worldAABBs[i];
+			xSortedLeaves.PushBack(Leaf(m_worldAABBs[i], i));
+			ySortedLeaves.PushBack(Leaf(m_worldAABBs[i], i));
+		}
+	}
 
-		AABB worldAABB = m_localAABBs[i].Transform(pos, poly.registerRotation[i]);
+	const size_t leafCount = xSortedLeaves.Size();
+	SBVH4Tree& tree = m_staticBVH4.BeginBuild(GetBVH4NodeCapacity(leafCount));
+	tree.nodeCount = BuildBVH4FromLeaves(xSortedLeaves.Data(), ySortedLeaves.Data(), leafCount, tree.nodes.Data());
+	m_staticBVH4.EndBuild();
 
-		m_worldAABBs[i] = worldAABB;
-		m_ySortedLeaves[i] = m_xSortedLeaves[i] = Leaf(worldAABB, i);
+	m_staticBVHValid = true;
+}
+
+int32_t	CPhysicEngine::BuildBVH4FromLeaves(Leaf* xSortedLeaves, Leaf* ySortedLeaves, size_t leafCount, Node4* bvh4Nodes)
+{
+	if (leafCount == 0)
+		return 0;
+
+	// The BVH2 needs two children per node, a single leaf is the first child of the root
+	if (leafCount == 1)
+	{
+		new(bvh4Nodes) Node4;
+		bvh4Nodes->children[0] = ChildID(xSortedLeaves->polyIndex, true);
+		bvh4Nodes->SetAABB(0, xSortedLeaves->aabb);
+		return 1;
 	}
 
 	// The tree doesn't contains the leaves so the number of nodes is number of leaves -1
-	size_t nodeCount = objectCount  - 1;
-	m_bvh2Nodes.resize(nodeCount);
-	m_bvh4Nodes.resize(nodeCount);
+	m_bvh2Nodes.Resize(leafCount - 1);
 
 	// Build BVH2
 	int32_t newNodeIndex = 0;
-	BVH2Recurse(m_bvh2Nodes.data(), newNodeIndex, m_xSortedLeaves.data(), m_ySortedLeaves.data(), objectCount);
-
-	//if (gVars->bDebug)
-	//	DrawBVH2(bvh2Nodes, nodeCount);
+	{
+		PROFILE_SCOPE("BVH2Recurse");
+		BVH2Recurse(m_bvh2Nodes.Data(), newNodeIndex, xSortedLeaves, ySortedLeaves, leafCount);
+	}
 
 	// Build BVH4 from BVH2
 	newNodeIndex = 0;
-	BVH2ToBVH4(m_bvh2Nodes.data(), 0, m_bvh4Nodes.data(), newNodeIndex);
-
-	if (gVars->bDebug)
-		DrawBVH4(m_bvh4Nodes.data(), newNodeIndex);
+	{
+		PROFILE_SCOPE("BVH2ToBVH4");
+		BVH2ToBVH4(m_bvh2Nodes.Data(), 0, bvh4Nodes, newNodeIndex);
+	}
+	return newNodeIndex;
 }
 
 int32_t CPhysicEngine::BVH2Recurse(Node2* nodes, int32_t& newNodeIndex, Leaf* xSortedLeaves, Leaf* ySortedLeaves, size_t leafCount)
@@ -336,10 +592,152 @@ int32_t CPhysicEngine::BVH2ToBVH4(Node2* bvh2Nodes, int32_t currentNode2Index, N
 	return node4Index;
 }
 
+static size_t	GetBVH4Depth(const Node4* nodes, int32_t nodeIndex)
+{
+	size_t childDepth = 0;
+	for (const ChildID& child : nodes[nodeIndex].children)
+	{
+		if (child.index != -1 && !child.isLeaf)
+			childDepth = Max(childDepth, GetBVH4Depth(nodes, child.index));
+	}
+	return childDepth + 1;
+}
+
+void	CPhysicEngine::ComputeBVHStats()
+{
+	m_stats.sahCost = 0.0f;
+	m_stats.depth = 0;
+	m_stats.averageNodeFill = 0.0f;
+	m_stats.siblingOverlapArea = 0.0f;
+
+	const size_t nodeCount = GetBVH4NodeCount();
+	if (nodeCount == 0)
+		return;
+
+	// Areas of the AABBs, the maximum is stored negated
+	auto getArea = [](__m128 reg)
+	{
+		const AABB aabb(reg);
+		return Max(0.0f, -aabb.maximum.x - aabb.minimum.x) * Max(0.0f, -aabb.maximum.y - aabb.minimum.y);
+	};
+
+	const Node4* nodes = GetBVH4Nodes();
+
+	__m128 root = nodes[0].GetAABB(0).GetReg();
+	for (size_t child = 1; child < 4; child++)
+	{
+		if (nodes[0].children[child].index != -1)
+			root = _mm_min_ps(root, nodes[0].GetAABB(child).GetReg());
+	}
+	const float rootArea = getArea(root);
+
+	/*
+	* A query inside the root AABB visits a node or hits a leaf with the probability
+	* that it is inside its AABB, which is the ratio of its area to the area of the
+	* root. The AABBs of the nodes and leaves are the ones stored in their parent so
+	* the cost is the root plus the sum of the ratios of all the children.
+	*/
+	size_t childCount = 0;
+	float childAreas = 0.0f;
+
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		AABB childAABBs[4];
+		size_t nodeChildCount = 0;
+
+		for (size_t child = 0; child < 4; child++)
+		{
+			if (nodes[i].children[child].index != -1)
+				childAABBs[nodeChildCount++] = nodes[i].GetAABB(child);
+		}
+
+		for (size_t a = 0; a < nodeChildCount; a++)
+		{
+			childAreas += getArea(childAABBs[a].GetReg());
+
+			// The intersection of two AABBs is the max of their minimums and of their negated maximums
+			for (size_t b = a + 1; b < nodeChildCount; b++)
+				m_stats.siblingOverlapArea += getArea(_mm_max_ps(childAABBs[a].GetReg(), childAABBs[b].GetReg()));
+		}
+
+		childCount += nodeChildCount;
+	}
+
+	m_stats.sahCost = rootArea > 0.0f ? 1.0f + childAreas / rootArea : 0.0f;
+	m_stats.depth = GetBVH4Depth(nodes, 0);
+	m_stats.averageNodeFill = (float)childCount / (float)nodeCount;
+}
+
+// Closest leaf of the tree crossed by the ray before hit.distance, the maximums of the AABBs are stored negated
+static void	RaycastBVH4(const Node4* nodes, int32_t nodeIndex, __m128 originX, __m128 originY, __m128 inverseDirectionX, __m128 inverseDirectionY,
+	bool& found, SRaycastHit& hit)
+{
+	const Node4& node = nodes[nodeIndex];
+	const __m128 signMask = _mm_set_ps1(-0.f);
+
+	// Slab test of the 4 children at once, the ray is inside the AABB between the last entry and the first exit
+	const __m128 minimumX = _mm_mul_ps(_mm_sub_ps(node.packedAABBs.minimumX, originX), inverseDirectionX);
+	const __m128 maximumX = _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(node.packedAABBs.maximumX, signMask), originX), inverseDirectionX);
+	const __m128 minimumY = _mm_mul_ps(_mm_sub_ps(node.packedAABBs.minimumY, originY), inverseDirectionY);
+	const __m128 maximumY = _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(node.packedAABBs.maximumY, signMask), originY), inverseDirectionY);
+
+	const __m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(minimumX, maximumX), _mm_min_ps(minimumY, maximumY)), _mm_setzero_ps());
+	const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(minimumX, maximumX), _mm_max_ps(minimumY, maximumY)), _mm_set_ps1(hit.distance));
+
+	// Empty children have their minimum above their maximum, which swaps their slabs instead of
+	// rejecting them, they are skipped by their index
+	const int mask = _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+
+	float entries[4];
+	_mm_storeu_ps(entries, entry);
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		const ChildID& child = node.children[i];
+		if ((mask & (1 << i)) == 0 || child.index == -1 || entries[i] > hit.distance)
+			continue;
+
+		if (child.isLeaf)
+		{
+			found = true;
+			hit.polyIndex = child.index;
+			hit.distance = entries[i];
+		}
+		else
+		{
+			RaycastBVH4(nodes, child.index, originX, originY, inverseDirectionX, inverseDirectionY, found, hit);
+		}
+	}
+}
+
+bool	CPhysicEngine::Raycast(const Vec2& origin, const Vec2& direction, float maxDistance, SRaycastHit& hit) const
+{
+	// Axis parallel rays get a huge inverse instead of an infinite one, so that a null distance to a slab gives 0
+	const __m128 inverseDirectionX = _mm_set_ps1(direction.x != 0.0f ? 1.0f / direction.x : FLT_MAX);
+	const __m128 inverseDirectionY = _mm_set_ps1(direction.y != 0.0f ? 1.0f / direction.y : FLT_MAX);
+	const __m128 originX = _mm_set_ps1(origin.x);
+	const __m128 originY = _mm_set_ps1(origin.y);
+
+	bool found = false;
+	hit.distance = maxDistance;
+
+	// The trees are read as they were at the end of the step that built them
+	const CBVH4ReadLock dynamicTree(m_bvh4);
+	if (dynamicTree.GetNodeCount() > 0)
+		RaycastBVH4(dynamicTree.GetNodes(), 0, originX, originY, inverseDirectionX, inverseDirectionY, found, hit);
+
+	const CBVH4ReadLock staticTree(m_staticBVH4);
+	if (staticTree.GetNodeCount() > 0)
+		RaycastBVH4(staticTree.GetNodes(), 0, originX, originY, inverseDirectionX, inverseDirectionY, found, hit);
+
+	return found;
+}
+
 void	CPhysicEngine::CollisionBroadPhase()
 {
-	m_pairsToCheck.clear();
-	m_broadPhase->GetCollidingPairsToCheck(m_pairsToCheck);
+	m_pairsToCheck.Clear();
+	m_broadPhase->GetCollidingPairsToCheck(m_pairsToCheck, m_stats);
+	m_stats.candidatePairs = m_pairsToCheck.Size();
 }
 
 bool CPhysicEngine::SIMD_Shuffle_OBBCollisionTest(__m128 pos, __m128 extent, __m128 rotXxYx, __m128 rotXyYy) const noexcept
@@ -588,89 +986,612 @@ bool CPhysicEngine::SIMD_Shuffle_OBBCollisionTest(__m128 pos, __m128 extent, __m
 //}
 
 
-void	CPhysicEngine::CollisionNarrowPhase()
+void	CPhysicEngine::CollisionGather()
 {
-	m_collidingPairs.clear();
-	CPolygon& poly = gVars->pWorld->GetPolygons();
+	BucketPairsByShape();
+
+	constexpr size_t bucketCount = (size_t)ShapeType::Count * (size_t)ShapeType::Count;
+
+	SSpan<const SPolygonPair> buckets[bucketCount];
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+		buckets[bucket] = GetShapePairBucket(bucket);
+
+	m_pairGather->Gather(gVars->pWorld->GetPolygons(), buckets, bucketCount);
+}
+
+void	CPhysicEngine::BucketPairsByShape()
+{
+	// Counting sort of the pairs by bucket: count the pairs of each bucket, the prefix
+	// sum of the counts gives where each bucket starts in the single array of pairs
+	constexpr size_t bucketCount = (size_t)ShapeType::Count * (size_t)ShapeType::Count;
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+
+	auto getBucket = [&poly](const SPolygonPair& pair)
+	{
+		const size_t typeA = (size_t)poly.shapeType[pair.polyA];
+		const size_t typeB = (size_t)poly.shapeType[pair.polyB];
+		return typeA <= typeB ? typeA * (size_t)ShapeType::Count + typeB : typeB * (size_t)ShapeType::Count + typeA;
+	};
+
+	size_t counts[bucketCount] = {};
+	for (const SPolygonPair& pair : m_pairsToCheck)
+		counts[getBucket(pair)]++;
+
+	size_t next[bucketCount];
+	m_shapePairBucketOffsets[0] = 0;
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		next[bucket] = m_shapePairBucketOffsets[bucket];
+		m_shapePairBucketOffsets[bucket + 1] = m_shapePairBucketOffsets[bucket] + counts[bucket];
+	}
 
+	m_shapePairs.Resize(m_pairsToCheck.Size());
 	for (const SPolygonPair& pair : m_pairsToCheck)
 	{
-		SCollision collision;
-		size_t idx1 = pair.polyA;
-		size_t idx2 = pair.polyB;
+		// Swap the pair so that the kernels only have to handle one order
+		if (poly.shapeType[pair.polyA] <= poly.shapeType[pair.polyB])
+			m_shapePairs[next[getBucket(pair)]++] = pair;
+		else
+			m_shapePairs[next[getBucket(pair)]++] = SPolygonPair(pair.polyB, pair.polyA);
+	}
 
-		const size_t arrayIdx1 = floor(idx1 / 4);
-		const size_t registerIdx1 = idx1 % 4;
-		const size_t arrayIdx2 = floor(idx2 / 4);
-		const size_t registerIdx2 = idx2 % 4;
-		
-		constexpr int mask0 = _MM_SHUFFLE(0, 0, 0, 0);
-		constexpr int mask1 = _MM_SHUFFLE(1, 1, 1, 1);
-		constexpr int mask2 = _MM_SHUFFLE(2, 2, 2, 2);
-		constexpr int mask3 = _MM_SHUFFLE(3, 3, 3, 3);
+	// Sort the pairs by blocks of 16 bodies (a cache line of each column) of the first body,
+	// then by second body, so that the gather reads the body columns in increasing order
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		std::sort(m_shapePairs.begin() + m_shapePairBucketOffsets[bucket], m_shapePairs.begin() + m_shapePairBucketOffsets[bucket + 1], [](const SPolygonPair& a, const SPolygonPair& b)
+		{
+			const size_t blockA = a.polyA / 16;
+			const size_t blockB = b.polyA / 16;
+			return blockA < blockB || (blockA == blockB && a.polyB < b.polyB);
+		});
+	}
+}
+
+SSpan<const SPolygonPair>	CPhysicEngine::GetShapePairBucket(size_t bucket) const
+{
+	return SSpan<const SPolygonPair>(m_shapePairs.Data() + m_shapePairBucketOffsets[bucket], m_shapePairBucketOffsets[bucket + 1] - m_shapePairBucketOffsets[bucket]);
+}
 
-		__m128 pos1, pos2, extent1, extent2;
-		if (registerIdx1 == 0)
+size_t	CPhysicEngine::GetShapePairCount(ShapeType typeA, ShapeType typeB) const
+{
+	const size_t first = (size_t)std::min(typeA, typeB);
+	const size_t second = (size_t)std::max(typeA, typeB);
+	return GetShapePairBucket(first * (size_t)ShapeType::Count + second).size;
+}
+
+void	CPhysicEngine::CollisionNarrowPhase()
+{
+	// Split the blocks of each bucket in fixed size chunks, a chunk never
+	// spans two buckets so that it runs a single kernel
+	m_narrowPhaseChunks.Clear();
+
+	for (size_t bucket = 0; bucket < (size_t)ShapeType::Count * (size_t)ShapeType::Count; bucket++)
+	{
+		const size_t endBlock = m_pairGather->GetEndBlock(bucket);
+
+		for (size_t block = m_pairGather->GetFirstBlock(bucket); block < endBlock; block += NARROW_PHASE_CHUNK_BLOCKS)
 		{
-			pos1 = _mm_shuffle_ps(poly.positionX[arrayIdx1], poly.positionY[arrayIdx1], mask0);
-			extent1 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx1], poly.halfExtentY[arrayIdx1], mask0);
+			SNarrowPhaseChunk chunk;
+			chunk.bucket = bucket;
+			chunk.firstBlock = block;
+			chunk.endBlock = Min<size_t>(block + NARROW_PHASE_CHUNK_BLOCKS, endBlock);
+			m_narrowPhaseChunks.PushBack(chunk);
 		}
-		else if (registerIdx1 == 1)
+	}
+
+	m_threadCollisions.resize(m_jobSystem->GetThreadCount());
+	for (SThreadCollisions& thread : m_threadCollisions)
+	{
+		thread.collisions.clear();
+		thread.axisCacheExits = 0;
+		thread.obbTests = 0;
+	}
+
+	m_obbPairAxes.Resize(GetShapePairBucket((size_t)ShapeType::OBB * (size_t)ShapeType::Count + (size_t)ShapeType::OBB).size);
+
+	// Each thread appends the colliding pairs of the chunks it takes to its own
+	// output and records where they are so that they can be merged afterwards
+	m_jobSystem->ParallelFor(m_narrowPhaseChunks.Size(), [this](size_t chunkIndex, size_t threadIndex)
+	{
+		SNarrowPhaseChunk& chunk = m_narrowPhaseChunks[chunkIndex];
+		SThreadCollisions& output = m_threadCollisions[threadIndex];
+
+		chunk.thread = threadIndex;
+		chunk.outputOffset = output.collisions.size();
+		NarrowPhaseChunk(chunk, output);
+		chunk.outputCount = output.collisions.size() - chunk.outputOffset;
+	});
+
+	MergeCollisions();
+	UpdateSeparatingAxisCache();
+
+	m_stats.obbTests = 0;
+	for (const SThreadCollisions& thread : m_threadCollisions)
+		m_stats.obbTests += thread.obbTests;
+	m_stats.collisions = m_collidingPairs.Size();
+}
+
+void	CPhysicEngine::NarrowPhaseChunk(const SNarrowPhaseChunk& chunk, SThreadCollisions& output)
+{
+	// Shows how the chunks are spread over the workers
+	PROFILE_SCOPE("Narrow phase chunk");
+
+	constexpr size_t typeCount = (size_t)ShapeType::Count;
+	constexpr size_t obb = (size_t)ShapeType::OBB;
+	constexpr size_t circle = (size_t)ShapeType::Circle;
+	constexpr size_t capsule = (size_t)ShapeType::Capsule;
+
+	switch (chunk.bucket)
+	{
+	case obb * typeCount + obb:
+		NarrowPhaseOBBBlocks(chunk, output);
+		break;
+	// Shape types are sorted in the pairs so boxes always come first
+	case obb * typeCount + circle:
+		NarrowPhaseBlocks(chunk, [](const SBodyBatch& box, const SBodyBatch& circle)
+		{
+			return SIMD_CircleOBBTest(circle, box);
+		}, output.collisions);
+		break;
+	case obb * typeCount + capsule:
+		NarrowPhaseBlocks(chunk, [](const SBodyBatch& box, const SBodyBatch& capsule)
+		{
+			return SIMD_CapsuleOBBTest(capsule, box);
+		}, output.collisions);
+		break;
+	case circle * typeCount + circle:
+		NarrowPhaseBlocks(chunk, SIMD_CircleCircleTest, output.collisions);
+		break;
+	case circle * typeCount + capsule:
+	case capsule * typeCount + capsule:
+		NarrowPhaseBlocks(chunk, SIMD_CapsuleCapsuleTest, output.collisions);
+		break;
+	default:
+		break;
+	}
+}
+
+template<typename TKernel>
+void	CPhysicEngine::NarrowPhaseBlocks(const SNarrowPhaseChunk& chunk, TKernel kernel, std::vector<SCollision>& output) const
+{
+	const SSpan<const SPolygonPair> pairs = GetShapePairBucket(chunk.bucket);
+	const size_t bucketFirstBlock = m_pairGather->GetFirstBlock(chunk.bucket);
+
+	// Test pairs 4 by 4 from the gathered batches, results of the padding
+	// lanes of the last block are masked out
+	for (size_t block = chunk.firstBlock; block < chunk.endBlock; block++)
+	{
+		const size_t first = (block - bucketFirstBlock) * 4;
+		const size_t laneCount = Min<size_t>(4, pairs.size - first);
+
+		int resMask = kernel(m_pairGather->GetBatchA(block), m_pairGather->GetBatchB(block));
+		resMask &= (1 << laneCount) - 1;
+
+		for (size_t lane = 0; lane < laneCount; lane++)
 		{
-			pos1 = _mm_shuffle_ps(poly.positionX[arrayIdx1], poly.positionY[arrayIdx1], mask1);
-			extent1 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx1], poly.halfExtentY[arrayIdx1], mask1);
+			if (resMask & (1 << lane))
+				output.push_back(SCollision(pairs[first + lane].polyA, pairs[first + lane].polyB));
 		}
-		else if (registerIdx1 == 2)
+	}
+}
+
+void	CPhysicEngine::NarrowPhaseOBBBlocks(const SNarrowPhaseChunk& chunk, SThreadCollisions& output)
+{
+	/*
+	* Pairs that were separated last frame are most likely separated by the same
+	* axis this frame, and pairs that were overlapping most likely separate along
+	* their axis of least penetration. So we first project each pair on the axis
+	* cached for it and run the full SAT test only if one of the pairs of the
+	* block is not separated on its cached axis. Any separating axis proves that
+	* the boxes don't overlap, so a wrong axis in the cache is only a cache miss.
+	*/
+
+	const SSpan<const SPolygonPair> pairs = GetShapePairBucket(chunk.bucket);
+	const size_t bucketFirstBlock = m_pairGather->GetFirstBlock(chunk.bucket);
+	// The cache outlives the step so it is keyed by the stable slots of the bodies
+	const uint32_t* slots = gVars->pWorld->GetBodySlots();
+
+	for (size_t block = chunk.firstBlock; block < chunk.endBlock; block++)
+	{
+		const size_t first = (block - bucketFirstBlock) * 4;
+		const size_t laneCount = Min<size_t>(4, pairs.size - first);
+		const int laneMask = (1 << laneCount) - 1;
+
+		const SBodyBatch boxA = m_pairGather->GetBatchA(block);
+		const SBodyBatch boxB = m_pairGather->GetBatchB(block);
+
+		alignas(16) int32_t axes[4] = { 0, 0, 0, 0 };
+		int cachedMask = 0;
+
+		if (useSeparatingAxisCache)
+		{
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				const uint8_t* axis = m_separatingAxisCache.Find(CPairTable<uint8_t>::MakeKey(slots[pairs[first + lane].polyA], slots[pairs[first + lane].polyB]));
+				if (axis != nullptr)
+				{
+					axes[lane] = *axis;
+					cachedMask |= 1 << lane;
+				}
+			}
+		}
+
+		int resMask = 0;
+		__m128i axis = _mm_load_si128(reinterpret_cast<const __m128i*>(axes));
+
+		// Pairs without a cached axis are inconclusive
+		int separatedMask = 0;
+		if (cachedMask != 0)
+			separatedMask = cachedMask & ~SIMD_OBBOBBAxisTest(boxA, boxB, axis);
+
+		if (separatedMask == laneMask)
 		{
-			pos1 = _mm_shuffle_ps(poly.positionX[arrayIdx1], poly.positionY[arrayIdx1], mask2);
-			extent1 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx1], poly.halfExtentY[arrayIdx1], mask2);
+			output.axisCacheExits += laneCount;
 		}
-		else if (registerIdx1 == 3)
+		else
 		{
-			pos1 = _mm_shuffle_ps(poly.positionX[arrayIdx1], poly.positionY[arrayIdx1], mask3);
-			extent1 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx1], poly.halfExtentY[arrayIdx1], mask3);
+			resMask = SIMD_OBBOBBTest(boxA, boxB, axis) & laneMask;
+			output.obbTests += laneCount;
+			_mm_store_si128(reinterpret_cast<__m128i*>(axes), axis);
 		}
 
-		if (registerIdx2 == 0)
+		for (size_t lane = 0; lane < laneCount; lane++)
 		{
-			pos2 = _mm_shuffle_ps(poly.positionX[arrayIdx2], poly.positionY[arrayIdx2], mask0);
-			extent2 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx2], poly.halfExtentY[arrayIdx2], mask0);
+			m_obbPairAxes[first + lane] = (uint8_t)axes[lane];
+
+			if (resMask & (1 << lane))
+				output.collisions.push_back(SCollision(pairs[first + lane].polyA, pairs[first + lane].polyB));
 		}
-		else if (registerIdx2 == 1)
+	}
+}
+
+void	CPhysicEngine::MergeCollisions()
+{
+	// Prefix sum of the output sizes gives the position of each output in the merged
+	// array. In stable order the outputs are the chunks, in the order of the buckets,
+	// otherwise whole thread outputs are copied in thread order
+	size_t collisionCount = 0;
+
+	if (stableCollisionOrder)
+	{
+		m_mergeOffsets.Resize(m_narrowPhaseChunks.Size());
+		for (size_t i = 0; i < m_narrowPhaseChunks.Size(); i++)
 		{
-			pos2 = _mm_shuffle_ps(poly.positionX[arrayIdx2], poly.positionY[arrayIdx2], mask1);
-			extent2 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx2], poly.halfExtentY[arrayIdx2], mask1);
+			m_mergeOffsets[i] = collisionCount;
+			collisionCount += m_narrowPhaseChunks[i].outputCount;
 		}
-		else if (registerIdx2 == 2)
+	}
+	else
+	{
+		m_mergeOffsets.Resize(m_threadCollisions.size());
+		for (size_t i = 0; i < m_threadCollisions.size(); i++)
+		{
+			m_mergeOffsets[i] = collisionCount;
+			collisionCount += m_threadCollisions[i].collisions.size();
+		}
+	}
+
+	m_collidingPairs.Resize(collisionCount);
+
+	// Outputs don't overlap in the merged array so they can be copied in parallel
+	m_jobSystem->ParallelFor(m_mergeOffsets.Size(), [this](size_t index, size_t)
+	{
+		const SCollision* first;
+		size_t count;
+
+		if (stableCollisionOrder)
+		{
+			const SNarrowPhaseChunk& chunk = m_narrowPhaseChunks[index];
+			first = m_threadCollisions[chunk.thread].collisions.data() + chunk.outputOffset;
+			count = chunk.outputCount;
+		}
+		else
+		{
+			first = m_threadCollisions[index].collisions.data();
+			count = m_threadCollisions[index].collisions.size();
+		}
+
+		std::copy(first, first + count, m_collidingPairs.begin() + m_mergeOffsets[index]);
+	});
+}
+
+void	CPhysicEngine::UpdateSeparatingAxisCache()
+{
+	m_axisCacheExits = 0;
+	for (const SThreadCollisions& thread : m_threadCollisions)
+		m_axisCacheExits += thread.axisCacheExits;
+
+	// Rebuild the cache from the box pairs of this frame only, so that pairs that
+	// left the broad phase don't stay in it
+	const SSpan<const SPolygonPair> pairs = GetShapePairBucket((size_t)ShapeType::OBB * (size_t)ShapeType::Count + (size_t)ShapeType::OBB);
+
+	const uint32_t* slots = gVars->pWorld->GetBodySlots();
+
+	m_separatingAxisCache.Clear(pairs.size);
+	for (size_t i = 0; i < pairs.size; i++)
+		m_separatingAxisCache.Insert(CPairTable<uint8_t>::MakeKey(slots[pairs[i].polyA], slots[pairs[i].polyB]), m_obbPairAxes[i]);
+}
+
+void	CPhysicEngine::CollisionContinuous()
+{
+	m_timesOfImpact.Clear();
+	m_ccdPairs.Clear();
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+
+	// The AABBs of fast bodies are swept so the broad phase pairs
+	// include every body they can hit during the step
+	for (const SPolygonPair& pair : m_pairsToCheck)
+	{
+		if (poly.fast[pair.polyA] || poly.fast[pair.polyB])
+			m_ccdPairs.PushBack(pair);
+	}
+
+	if (m_ccdPairs.Empty())
+		return;
+
+	const SSpan<const SPolygonPair> ccdPairs = m_ccdPairs.GetSpan();
+	m_ccdGather->Gather(poly, &ccdPairs, 1);
+
+	const size_t endBlock = m_ccdGather->GetEndBlock(0);
+	for (size_t block = 0; block < endBlock; block++)
+	{
+		const size_t first = block * 4;
+		const size_t laneCount = Min<size_t>(4, m_ccdPairs.Size() - first);
+
+		// Motion of B relative to A during the step
+		alignas(16) float moveX[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		alignas(16) float moveY[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (size_t lane = 0; lane < laneCount; lane++)
 		{
-			pos2 = _mm_shuffle_ps(poly.positionX[arrayIdx2], poly.positionY[arrayIdx2], mask2);
-			extent2 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx2], poly.halfExtentY[arrayIdx2], mask2);
+			const SPolygonPair& pair = m_ccdPairs[first + lane];
+			const Vec2 move = (poly.speed[pair.polyB] - poly.speed[pair.polyA]) * m_stepTime;
+			moveX[lane] = move.x;
+			moveY[lane] = move.y;
 		}
-		else if (registerIdx2 == 3)
+
+		// Round shapes are swept as their bounding box, which gives a conservative time of impact
+		SBodyBatch bodyA = m_ccdGather->GetBatchA(block);
+		SBodyBatch bodyB = m_ccdGather->GetBatchB(block);
+		bodyA.extentX = _mm_add_ps(bodyA.extentX, bodyA.radius);
+		bodyA.extentY = _mm_add_ps(bodyA.extentY, bodyA.radius);
+		bodyB.extentX = _mm_add_ps(bodyB.extentX, bodyB.radius);
+		bodyB.extentY = _mm_add_ps(bodyB.extentY, bodyB.radius);
+
+		__m128 toi, normalX, normalY;
+		int hitMask = SIMD_OBBOBBTimeOfImpact(bodyA, bodyB, _mm_load_ps(moveX), _mm_load_ps(moveY), toi, normalX, normalY);
+		hitMask &= (1 << laneCount) - 1;
+
+		if (hitMask == 0)
+			continue;
+
+		alignas(16) float times[4];
+		alignas(16) float normalsX[4];
+		alignas(16) float normalsY[4];
+		_mm_store_ps(times, toi);
+		_mm_store_ps(normalsX, normalX);
+		_mm_store_ps(normalsY, normalY);
+
+		for (size_t lane = 0; lane < laneCount; lane++)
 		{
-			pos2 = _mm_shuffle_ps(poly.positionX[arrayIdx2], poly.positionY[arrayIdx2], mask3);
-			extent2 = _mm_shuffle_ps(poly.halfExtentX[arrayIdx2], poly.halfExtentY[arrayIdx2], mask3);
+			if (hitMask & (1 << lane))
+				m_timesOfImpact.PushBack(STimeOfImpact(m_ccdPairs[first + lane].polyA, m_ccdPairs[first + lane].polyB, times[lane], Vec2(normalsX[lane], normalsY[lane])));
 		}
+	}
+}
 
-		__m128 pos = _mm_shuffle_ps(pos1, pos2, _MM_SHUFFLE(2, 0, 2, 0));
-		__m128 extent = _mm_shuffle_ps(extent1, extent2, _MM_SHUFFLE(2, 0, 2, 0));
+void	CPhysicEngine::BuildContactManifolds()
+{
+	m_manifolds.BeginFrame();
 
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	const uint32_t* slots = gVars->pWorld->GetBodySlots();
 
-		// BYx, BXx, AYx, AXx
-		//__m128 rotX = _mm_shuffle_ps(poly.registerRotation[idx2], poly.registerRotation[idx1], _MM_SHUFFLE(0, 2, 0, 2));
-		__m128 rotX = _mm_shuffle_ps(poly.registerRotation[idx1], poly.registerRotation[idx2], _MM_SHUFFLE(0, 2, 0, 2));
+	SContactManifold manifold;
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		if (poly.shapeType[collision.polyA] != ShapeType::OBB || poly.shapeType[collision.polyB] != ShapeType::OBB)
+			continue;
 
-		// BYy, BXy, AYy, AXy
-		__m128 rotY = _mm_shuffle_ps(poly.registerRotation[idx1], poly.registerRotation[idx2], _MM_SHUFFLE(1, 3, 1, 3));
+		if (BuildOBBManifold(poly, collision.polyA, collision.polyB, manifold))
+			m_manifolds.AddManifold(manifold, CPairTable<uint32_t>::MakeKey(slots[collision.polyA], slots[collision.polyB]));
+	}
+}
+
+void	CPhysicEngine::Integrate()
+{
+	CPolygon& poly = gVars->pWorld->GetPolygons();
+	const size_t count = poly.polyCount;
 
+	if (!integrate || count == 0)
+		return;
 
-		// AYx, AXxm BYx, BXx 
-		//__m128 rotX = _mm_set_ps(pair.polyB->rotation.X.x, pair.polyB->rotation.Y.x, pair.polyA->rotation.X.x, pair.polyA->rotation.Y.x);
-		//__m128 rotY = _mm_set_ps(pair.polyB->rotation.X.y, pair.polyB->rotation.Y.y, pair.polyA->rotation.X.y, pair.polyA->rotation.Y.y);
+	// Bodies hit during the step by a fast body, or fast bodies hitting
+	// another one, only move until their first time of impact
+	const size_t paddedCount = (count + 3) & ~(size_t)3;
+	m_bodyTimesOfImpact.Resize(paddedCount);
+	m_bodyImpactNormals.Resize(paddedCount);
+	std::fill(m_bodyTimesOfImpact.begin(), m_bodyTimesOfImpact.end(), 1.0f);
+	std::fill(m_bodyImpactNormals.begin(), m_bodyImpactNormals.end(), Vec2());
 
-		if (SIMD_Shuffle_OBBCollisionTest(pos, extent, rotX, rotY))
+	for (const STimeOfImpact& impact : m_timesOfImpact)
+	{
+		for (size_t idx : { impact.polyA, impact.polyB })
 		{
-			m_collidingPairs.push_back(collision);
+			if (impact.time < m_bodyTimesOfImpact[idx])
+			{
+				m_bodyTimesOfImpact[idx] = impact.time;
+				m_bodyImpactNormals[idx] = impact.normal;
+			}
 		}
 	}
-}
\ No newline at end of file
+
+	/*
+	* 4 bodies at a time. The columns are padded to whole cache lines so the
+	* last block stays in their allocation. Speeds and normals are stored as
+	* (x, y) pairs, two loads give 4 of them that are split in x and y registers.
+	* Static bodies keep their position, speed and angle, moving one would need
+	* the static tree and the world AABBs kept with it to be rebuilt.
+	*/
+	float* positionX = poly.positionX.Data();
+	float* positionY = poly.positionY.Data();
+	float* speed = reinterpret_cast<float*>(poly.speed.Data());
+	float* angle = poly.angle.Data();
+	const float* angularSpeed = poly.angularSpeed.Data();
+	const bool* isStatic = poly.isStatic.Data();
+	const float* timeOfImpact = m_bodyTimesOfImpact.Data();
+	const float* normal = reinterpret_cast<const float*>(m_bodyImpactNormals.Data());
+
+	const __m128 stepTime = _mm_set_ps1(m_stepTime);
+	const __m128 one = _mm_set_ps1(1.0f);
+	const __m128 two = _mm_set_ps1(2.0f);
+	const __m128 signBit = _mm_set_ps1(-0.0f);
+	const __m128 minX = _mm_set_ps1(worldBoundsMin.x);
+	const __m128 minY = _mm_set_ps1(worldBoundsMin.y);
+	const __m128 maxX = _mm_set_ps1(worldBoundsMax.x);
+	const __m128 maxY = _mm_set_ps1(worldBoundsMax.y);
+
+	m_jobSystem->ParallelFor(paddedCount / 4, [&](size_t block, size_t)
+	{
+		const size_t i = block * 4;
+
+		const __m128 speed01 = _mm_load_ps(speed + 2 * i);
+		const __m128 speed23 = _mm_load_ps(speed + 2 * i + 4);
+		const __m128 startSpeedX = _mm_shuffle_ps(speed01, speed23, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 startSpeedY = _mm_shuffle_ps(speed01, speed23, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 speedX = startSpeedX;
+		__m128 speedY = startSpeedY;
+
+		// Lanes of static bodies, from the 4 bytes of their flags
+		int32_t staticFlags;
+		memcpy(&staticFlags, isStatic + i, sizeof(staticFlags));
+		const __m128 staticLanes = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(staticFlags)), _mm_setzero_si128()));
+
+		const __m128 startX = _mm_load_ps(positionX + i);
+		const __m128 startY = _mm_load_ps(positionY + i);
+		const __m128 time = _mm_load_ps(timeOfImpact + i);
+		const __m128 moveTime = _mm_mul_ps(time, stepTime);
+		__m128 x = _mm_add_ps(startX, _mm_mul_ps(speedX, moveTime));
+		__m128 y = _mm_add_ps(startY, _mm_mul_ps(speedY, moveTime));
+
+		// Reflect the speed of the bodies that hit another one, the reflection doesn't
+		// depend on the direction of the normal
+		const __m128 normal01 = _mm_load_ps(normal + 2 * i);
+		const __m128 normal23 = _mm_load_ps(normal + 2 * i + 4);
+		const __m128 normalX = _mm_shuffle_ps(normal01, normal23, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 normalY = _mm_shuffle_ps(normal01, normal23, _MM_SHUFFLE(3, 1, 3, 1));
+
+		const __m128 hit = _mm_cmplt_ps(time, one);
+		const __m128 dot = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(speedX, normalX), _mm_mul_ps(speedY, normalY)));
+		speedX = _mm_blendv_ps(speedX, _mm_sub_ps(speedX, _mm_mul_ps(dot, normalX)), hit);
+		speedY = _mm_blendv_ps(speedY, _mm_sub_ps(speedY, _mm_mul_ps(dot, normalY)), hit);
+
+		// Bodies out of the world bounds are put back on them and bounce
+		const __m128 outX = _mm_or_ps(_mm_cmplt_ps(x, minX), _mm_cmpgt_ps(x, maxX));
+		const __m128 outY = _mm_or_ps(_mm_cmplt_ps(y, minY), _mm_cmpgt_ps(y, maxY));
+		x = _mm_min_ps(_mm_max_ps(x, minX), maxX);
+		y = _mm_min_ps(_mm_max_ps(y, minY), maxY);
+		speedX = _mm_xor_ps(speedX, _mm_and_ps(outX, signBit));
+		speedY = _mm_xor_ps(speedY, _mm_and_ps(outY, signBit));
+
+		const __m128 startAngle = _mm_load_ps(angle + i);
+		const __m128 nextAngle = _mm_add_ps(startAngle, _mm_mul_ps(_mm_load_ps(angularSpeed + i), stepTime));
+
+		x = _mm_blendv_ps(x, startX, staticLanes);
+		y = _mm_blendv_ps(y, startY, staticLanes);
+		speedX = _mm_blendv_ps(speedX, startSpeedX, staticLanes);
+		speedY = _mm_blendv_ps(speedY, startSpeedY, staticLanes);
+
+		_mm_store_ps(positionX + i, x);
+		_mm_store_ps(positionY + i, y);
+		_mm_store_ps(speed + 2 * i, _mm_unpacklo_ps(speedX, speedY));
+		_mm_store_ps(speed + 2 * i + 4, _mm_unpackhi_ps(speedX, speedY));
+
+		_mm_store_ps(angle + i, _mm_blendv_ps(nextAngle, startAngle, staticLanes));
+	}, 256);
+
+	// Ranges are multiples of 8 bodies so that UpdateRotations doesn't write the same blocks on two threads
+	const size_t rotationBatch = 1024;
+	m_jobSystem->ParallelFor((count + rotationBatch - 1) / rotationBatch, [&](size_t batch, size_t)
+	{
+		poly.UpdateRotations(batch * rotationBatch, Min((batch + 1) * rotationBatch, count));
+	});
+}
+
+SBodyDistance	CPhysicEngine::ComputeDistance(size_t polyA, size_t polyB) const
+{
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+
+	// Same body in all lanes, only the first one is read back
+	auto splat = [&poly](size_t index)
+	{
+		const Vec2 position = poly.GetPosition(index);
+		const Vec2 extent = poly.GetExtent(index);
+
+		SBodyBatch batch;
+		batch.posX = _mm_set_ps1(position.x);
+		batch.posY = _mm_set_ps1(position.y);
+		batch.cos = _mm_set_ps1(poly.rotationCos[index]);
+		batch.sin = _mm_set_ps1(poly.rotationSin[index]);
+		batch.extentX = _mm_set_ps1(extent.x);
+		batch.extentY = _mm_set_ps1(extent.y);
+		batch.radius = _mm_set_ps1(poly.radius[index]);
+		return batch;
+	};
+
+	__m128 pointAX, pointAY, pointBX, pointBY;
+	__m128 distance = SIMD_DistanceTest(splat(polyA), splat(polyB), pointAX, pointAY, pointBX, pointBY);
+
+	SBodyDistance result;
+	result.distance = _mm_cvtss_f32(distance);
+	result.pointA = Vec2(_mm_cvtss_f32(pointAX), _mm_cvtss_f32(pointAY));
+	result.pointB = Vec2(_mm_cvtss_f32(pointBX), _mm_cvtss_f32(pointBY));
+
+	return result;
+}
+
+void	CPhysicEngine::ComputeDistances(const std::vector<SPolygonPair>& pairs, std::vector<SBodyDistance>& distances)
+{
+	distances.resize(pairs.size());
+
+	if (pairs.empty())
+		return;
+
+	// Gather the bodies of all the queries once, then test blocks of 4 pairs on the job system
+	const SSpan<const SPolygonPair> queryPairs(pairs.data(), pairs.size());
+	m_queryGather->Gather(gVars->pWorld->GetPolygons(), &queryPairs, 1);
+
+	const size_t blockCount = m_queryGather->GetEndBlock(0);
+	const size_t chunkCount = (blockCount + NARROW_PHASE_CHUNK_BLOCKS - 1) / NARROW_PHASE_CHUNK_BLOCKS;
+
+	m_jobSystem->ParallelFor(chunkCount, [&](size_t chunk, size_t)
+	{
+		const size_t endBlock = Min<size_t>((chunk + 1) * NARROW_PHASE_CHUNK_BLOCKS, blockCount);
+
+		for (size_t block = chunk * NARROW_PHASE_CHUNK_BLOCKS; block < endBlock; block++)
+		{
+			alignas(16) float distance[4];
+			alignas(16) float pointAX[4], pointAY[4], pointBX[4], pointBY[4];
+
+			__m128 ax, ay, bx, by;
+			_mm_store_ps(distance, SIMD_DistanceTest(m_queryGather->GetBatchA(block), m_queryGather->GetBatchB(block), ax, ay, bx, by));
+			_mm_store_ps(pointAX, ax);
+			_mm_store_ps(pointAY, ay);
+			_mm_store_ps(pointBX, bx);
+			_mm_store_ps(pointBY, by);
+
+			const size_t first = block * 4;
+			const size_t laneCount = Min<size_t>(4, pairs.size() - first);
+
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				SBodyDistance& result = distances[first + lane];
+				result.distance = distance[lane];
+				result.pointA = Vec2(pointAX[lane], pointAY[lane]);
+				result.pointB = Vec2(pointBX[lane], pointBY[lane]);
+			}
+		}
+	});
+}
@@ -0,0 +1,139 @@
+#include "physics/PhysicThread.h"
+
+#include "GlobalVariables.h"
+#include "Profiler.h"
+#include "World.h"
+#include "physics/PhysicEngine.h"
+
+Vec2	SPhysicSnapshot::GetPosition(size_t index, float alpha) const
+{
+	return Vec2(previousPositionX[index] + (positionX[index] - previousPositionX[index]) * alpha,
+		previousPositionY[index] + (positionY[index] - previousPositionY[index]) * alpha);
+}
+
+float	SPhysicSnapshot::GetAngle(size_t index, float alpha) const
+{
+	// Shortest way between the two angles, bodies rotated by hand can turn by more than a half turn
+	return previousAngle[index] + remainderf(angle[index] - previousAngle[index], 2.0f * (float)M_PI) * alpha;
+}
+
+CPhysicThread::CPhysicThread(float tickTime)
+	: m_running(false), m_tickTime(tickTime)
+{
+}
+
+CPhysicThread::~CPhysicThread()
+{
+	Stop();
+}
+
+void	CPhysicThread::Start()
+{
+	if (m_running)
+		return;
+
+	m_frontSnapshot = -1;
+	m_readSnapshot = -1;
+
+	m_running = true;
+	m_thread = std::thread(&CPhysicThread::ThreadLoop, this);
+}
+
+void	CPhysicThread::Stop()
+{
+	if (!m_running)
+		return;
+
+	m_running = false;
+	m_thread.join();
+}
+
+const SPhysicSnapshot*	CPhysicThread::AcquireSnapshot(float& alpha)
+{
+	std::lock_guard<std::mutex> lock(m_snapshotMutex);
+
+	m_readSnapshot = m_frontSnapshot;
+	if (m_readSnapshot < 0)
+		return nullptr;
+
+	// The snapshot is drawn one tick late, moving from its previous to its last tick
+	const SPhysicSnapshot& snapshot = m_snapshots[m_readSnapshot];
+	const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.time).count();
+	alpha = Clamp(elapsed / m_tickTime, 0.0f, 1.0f);
+
+	return &snapshot;
+}
+
+void	CPhysicThread::ReleaseSnapshot()
+{
+	std::lock_guard<std::mutex> lock(m_snapshotMutex);
+	m_readSnapshot = -1;
+}
+
+void	CPhysicThread::ThreadLoop()
+{
+	const std::chrono::steady_clock::duration tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_tickTime));
+	std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+
+	CProfiler::SetThreadName("Physics");
+
+	while (m_running)
+	{
+		Tick();
+
+		// Ticks running late are dropped rather than caught up, which would only make them later
+		nextTick += tick;
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (nextTick < now)
+			nextTick = now;
+
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+void	CPhysicThread::Tick()
+{
+	std::lock_guard<std::mutex> worldLock(m_worldMutex);
+
+	if (gVars->pWorld == nullptr)
+		return;
+
+	// Write the snapshot that isn't published, unless the renderer still reads it
+	int backSnapshot;
+	{
+		std::lock_guard<std::mutex> lock(m_snapshotMutex);
+		backSnapshot = m_frontSnapshot == 0 ? 1 : 0;
+		if (backSnapshot == m_readSnapshot)
+			backSnapshot = -1;
+	}
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	SPhysicSnapshot* snapshot = backSnapshot >= 0 ? &m_snapshots[backSnapshot] : nullptr;
+
+	if (snapshot != nullptr)
+	{
+		snapshot->previousPositionX.assign(poly.positionX.begin(), poly.positionX.end());
+		snapshot->previousPositionY.assign(poly.positionY.begin(), poly.positionY.end());
+		snapshot->previousAngle.assign(poly.angle.begin(), poly.angle.end());
+	}
+
+	gVars->pPhysicEngine->Step(m_tickTime);
+
+	if (snapshot == nullptr)
+		return;
+
+	// Bodies can't be added or removed during the step, the counts of the two ticks match
+	snapshot->bodyCount = poly.polyCount;
+	snapshot->positionX.assign(poly.positionX.begin(), poly.positionX.end());
+	snapshot->positionY.assign(poly.positionY.begin(), poly.positionY.end());
+	snapshot->angle.assign(poly.angle.begin(), poly.angle.end());
+
+	const CManifoldCache::SColumns& contacts = gVars->pPhysicEngine->GetManifolds().GetColumns();
+	snapshot->contactX.assign(contacts.pointX.begin(), contacts.pointX.end());
+	snapshot->contactY.assign(contacts.pointY.begin(), contacts.pointY.end());
+
+	snapshot->time = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_snapshotMutex);
+	m_frontSnapshot = backSnapshot;
+}
@@ -0,0 +1,421 @@
+#include "physics/ShapeKernels.h"
+
+#include <cfloat>
+
+static inline __m128 Clamp4(__m128 value, __m128 min, __m128 max)
+{
+	return _mm_min_ps(_mm_max_ps(value, min), max);
+}
+
+static inline __m128 Abs4(__m128 value)
+{
+	return _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+// Squared distance between points (px, py) and their projection on the
+// segments centered on (mx, my) with direction (ux, uy) and half length l
+static inline __m128 SqrDistancePointSegment(__m128 px, __m128 py, __m128 mx, __m128 my, __m128 ux, __m128 uy, __m128 l)
+{
+	__m128 dx = _mm_sub_ps(px, mx);
+	__m128 dy = _mm_sub_ps(py, my);
+
+	__m128 t = Clamp4(_mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy)), _mm_sub_ps(_mm_setzero_ps(), l), l);
+
+	dx = _mm_sub_ps(dx, _mm_mul_ps(ux, t));
+	dy = _mm_sub_ps(dy, _mm_mul_ps(uy, t));
+
+	return _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+}
+
+// Squared distance between points (px, py) and the boxes centered on the
+// origin with half extents (ex, ey)
+static inline __m128 SqrDistancePointBox(__m128 px, __m128 py, __m128 ex, __m128 ey)
+{
+	__m128 dx = _mm_sub_ps(px, Clamp4(px, _mm_sub_ps(_mm_setzero_ps(), ex), ex));
+	__m128 dy = _mm_sub_ps(py, Clamp4(py, _mm_sub_ps(_mm_setzero_ps(), ey), ey));
+
+	return _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+}
+
+// Closest points of the boxes to points (px, py), all in world space
+static inline void ClosestPointBox(const SBodyBatch& box, __m128 px, __m128 py, __m128& cx, __m128& cy)
+{
+	__m128 dx = _mm_sub_ps(px, box.posX);
+	__m128 dy = _mm_sub_ps(py, box.posY);
+
+	__m128 localX = Clamp4(_mm_add_ps(_mm_mul_ps(dx, box.cos), _mm_mul_ps(dy, box.sin)), _mm_sub_ps(_mm_setzero_ps(), box.extentX), box.extentX);
+	__m128 localY = Clamp4(_mm_sub_ps(_mm_mul_ps(dy, box.cos), _mm_mul_ps(dx, box.sin)), _mm_sub_ps(_mm_setzero_ps(), box.extentY), box.extentY);
+
+	cx = _mm_add_ps(box.posX, _mm_sub_ps(_mm_mul_ps(localX, box.cos), _mm_mul_ps(localY, box.sin)));
+	cy = _mm_add_ps(box.posY, _mm_add_ps(_mm_mul_ps(localX, box.sin), _mm_mul_ps(localY, box.cos)));
+}
+
+int SIMD_OBBOBBTest(const SBodyBatch& boxA, const SBodyBatch& boxB) noexcept
+{
+	__m128i axis;
+	return SIMD_OBBOBBTest(boxA, boxB, axis);
+}
+
+int SIMD_OBBOBBTest(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128i& axis) noexcept
+{
+	/*
+	* Same SAT test as CPhysicEngine::SIMD_Shuffle_OBBCollisionTest but for 4
+	* pairs at once, each lane holds a pair so there is no shuffle at all. In 2D
+	* the rotation from A to B is R = | c -s | with c = cos(angleB - angleA) and
+	*                                 | s  c |  s = sin(angleB - angleA)
+	* so the absolute rotation matrix of Ericson's algorithm only has two
+	* distinct values |c| and |s|.
+	*/
+
+	__m128 dx = _mm_sub_ps(boxB.posX, boxA.posX);
+	__m128 dy = _mm_sub_ps(boxB.posY, boxA.posY);
+
+	__m128 absC = Abs4(_mm_add_ps(_mm_mul_ps(boxA.cos, boxB.cos), _mm_mul_ps(boxA.sin, boxB.sin)));
+	__m128 absS = Abs4(_mm_sub_ps(_mm_mul_ps(boxA.cos, boxB.sin), _mm_mul_ps(boxA.sin, boxB.cos)));
+
+	// Projections of the translation on the axes of both boxes
+	__m128 tAX = Abs4(_mm_add_ps(_mm_mul_ps(dx, boxA.cos), _mm_mul_ps(dy, boxA.sin)));
+	__m128 tAY = Abs4(_mm_sub_ps(_mm_mul_ps(dy, boxA.cos), _mm_mul_ps(dx, boxA.sin)));
+	__m128 tBX = Abs4(_mm_add_ps(_mm_mul_ps(dx, boxB.cos), _mm_mul_ps(dy, boxB.sin)));
+	__m128 tBY = Abs4(_mm_sub_ps(_mm_mul_ps(dy, boxB.cos), _mm_mul_ps(dx, boxB.sin)));
+
+	// Sum of the projections of both boxes on each axis
+	__m128 rAX = _mm_add_ps(boxA.extentX, _mm_add_ps(_mm_mul_ps(boxB.extentX, absC), _mm_mul_ps(boxB.extentY, absS)));
+	__m128 rAY = _mm_add_ps(boxA.extentY, _mm_add_ps(_mm_mul_ps(boxB.extentX, absS), _mm_mul_ps(boxB.extentY, absC)));
+	__m128 rBX = _mm_add_ps(boxB.extentX, _mm_add_ps(_mm_mul_ps(boxA.extentX, absC), _mm_mul_ps(boxA.extentY, absS)));
+	__m128 rBY = _mm_add_ps(boxB.extentY, _mm_add_ps(_mm_mul_ps(boxA.extentX, absS), _mm_mul_ps(boxA.extentY, absC)));
+
+	// Separation along each axis, positive if the axis is separating and minus the
+	// penetration depth otherwise. The axis with the largest separation is the most
+	// separating one for separated boxes and the axis of least penetration for
+	// overlapping boxes, a lane is separated if that separation is positive
+	__m128 separation = _mm_sub_ps(tAX, rAX);
+	axis = _mm_set1_epi32((int)OBBAxis::AX);
+
+	__m128 separationAY = _mm_sub_ps(tAY, rAY);
+	__m128 greater = _mm_cmpgt_ps(separationAY, separation);
+	separation = _mm_max_ps(separation, separationAY);
+	axis = _mm_blendv_epi8(axis, _mm_set1_epi32((int)OBBAxis::AY), _mm_castps_si128(greater));
+
+	__m128 separationBX = _mm_sub_ps(tBX, rBX);
+	greater = _mm_cmpgt_ps(separationBX, separation);
+	separation = _mm_max_ps(separation, separationBX);
+	axis = _mm_blendv_epi8(axis, _mm_set1_epi32((int)OBBAxis::BX), _mm_castps_si128(greater));
+
+	__m128 separationBY = _mm_sub_ps(tBY, rBY);
+	greater = _mm_cmpgt_ps(separationBY, separation);
+	separation = _mm_max_ps(separation, separationBY);
+	axis = _mm_blendv_epi8(axis, _mm_set1_epi32((int)OBBAxis::BY), _mm_castps_si128(greater));
+
+	return _mm_movemask_ps(_mm_cmple_ps(separation, _mm_setzero_ps()));
+}
+
+int SIMD_OBBOBBAxisTest(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128i axis) noexcept
+{
+	// Pick the axis of each lane, the Y axis of a box being (-sin, cos)
+	__m128 useB = _mm_castsi128_ps(_mm_cmpgt_epi32(axis, _mm_set1_epi32((int)OBBAxis::AY)));
+	__m128 useY = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(axis, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+
+	__m128 c = _mm_blendv_ps(boxA.cos, boxB.cos, useB);
+	__m128 s = _mm_blendv_ps(boxA.sin, boxB.sin, useB);
+	__m128 nx = _mm_blendv_ps(c, _mm_sub_ps(_mm_setzero_ps(), s), useY);
+	__m128 ny = _mm_blendv_ps(s, c, useY);
+
+	__m128 dx = _mm_sub_ps(boxB.posX, boxA.posX);
+	__m128 dy = _mm_sub_ps(boxB.posY, boxA.posY);
+	__m128 t = Abs4(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)));
+
+	// Projection of each box on the axis is the sum of its extents scaled
+	// by the absolute cosines between the axis and the box axes
+	__m128 rA = _mm_add_ps(_mm_mul_ps(boxA.extentX, Abs4(_mm_add_ps(_mm_mul_ps(nx, boxA.cos), _mm_mul_ps(ny, boxA.sin)))),
+						   _mm_mul_ps(boxA.extentY, Abs4(_mm_sub_ps(_mm_mul_ps(ny, boxA.cos), _mm_mul_ps(nx, boxA.sin)))));
+	__m128 rB = _mm_add_ps(_mm_mul_ps(boxB.extentX, Abs4(_mm_add_ps(_mm_mul_ps(nx, boxB.cos), _mm_mul_ps(ny, boxB.sin)))),
+						   _mm_mul_ps(boxB.extentY, Abs4(_mm_sub_ps(_mm_mul_ps(ny, boxB.cos), _mm_mul_ps(nx, boxB.sin)))));
+
+	return ~_mm_movemask_ps(_mm_cmpgt_ps(t, _mm_add_ps(rA, rB))) & 0xF;
+}
+
+int SIMD_CircleCircleTest(const SBodyBatch& circleA, const SBodyBatch& circleB) noexcept
+{
+	__m128 dx = _mm_sub_ps(circleB.posX, circleA.posX);
+	__m128 dy = _mm_sub_ps(circleB.posY, circleA.posY);
+	__m128 sqrDist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+	__m128 radii = _mm_add_ps(circleA.radius, circleB.radius);
+
+	return _mm_movemask_ps(_mm_cmple_ps(sqrDist, _mm_mul_ps(radii, radii)));
+}
+
+int SIMD_CircleOBBTest(const SBodyBatch& circle, const SBodyBatch& box) noexcept
+{
+	// Express the circle centers in the coordinate frame of the boxes
+	__m128 dx = _mm_sub_ps(circle.posX, box.posX);
+	__m128 dy = _mm_sub_ps(circle.posY, box.posY);
+
+	__m128 localX = _mm_add_ps(_mm_mul_ps(dx, box.cos), _mm_mul_ps(dy, box.sin));
+	__m128 localY = _mm_sub_ps(_mm_mul_ps(dy, box.cos), _mm_mul_ps(dx, box.sin));
+
+	// The closest point of the box to the center of the circle is the center clamped
+	// to the box extents, the shapes overlap if it is inside the circle
+	__m128 sqrDist = SqrDistancePointBox(localX, localY, box.extentX, box.extentY);
+
+	return _mm_movemask_ps(_mm_cmple_ps(sqrDist, _mm_mul_ps(circle.radius, circle.radius)));
+}
+
+int SIMD_CapsuleOBBTest(const SBodyBatch& capsule, const SBodyBatch& box) noexcept
+{
+	/*
+	* The capsule overlaps the box if its segment is closer to the box than its
+	* radius. We work in the coordinate frame of the box where it is an AABB:
+	* 	- If the segment intersects the box the distance is null, this is
+	* 	  checked with a SAT test on the box axes and the segment normal
+	* 	- Otherwise in 2D the closest features of a segment and a convex
+	* 	  polygon always involve a vertex of one of them, so the distance is
+	* 	  the minimum of the segment end points to box distances and box
+	* 	  corners to segment distances
+	*/
+
+	__m128 dx = _mm_sub_ps(capsule.posX, box.posX);
+	__m128 dy = _mm_sub_ps(capsule.posY, box.posY);
+
+	// Segment center and direction in the coordinate frame of the box
+	__m128 mx = _mm_add_ps(_mm_mul_ps(dx, box.cos), _mm_mul_ps(dy, box.sin));
+	__m128 my = _mm_sub_ps(_mm_mul_ps(dy, box.cos), _mm_mul_ps(dx, box.sin));
+	__m128 ux = _mm_add_ps(_mm_mul_ps(capsule.cos, box.cos), _mm_mul_ps(capsule.sin, box.sin));
+	__m128 uy = _mm_sub_ps(_mm_mul_ps(capsule.sin, box.cos), _mm_mul_ps(capsule.cos, box.sin));
+
+	__m128 l = capsule.extentX;
+	__m128 ex = box.extentX;
+	__m128 ey = box.extentY;
+
+	// Half segment vector
+	__m128 hx = _mm_mul_ps(ux, l);
+	__m128 hy = _mm_mul_ps(uy, l);
+
+	// SAT test between the segment and the box, a bit is set for separated pairs
+	__m128 sepX = _mm_cmpgt_ps(Abs4(mx), _mm_add_ps(ex, Abs4(hx)));
+	__m128 sepY = _mm_cmpgt_ps(Abs4(my), _mm_add_ps(ey, Abs4(hy)));
+	__m128 sepN = _mm_cmpgt_ps(Abs4(_mm_sub_ps(_mm_mul_ps(my, hx), _mm_mul_ps(mx, hy))),
+							   _mm_add_ps(_mm_mul_ps(ex, Abs4(hy)), _mm_mul_ps(ey, Abs4(hx))));
+	int intersectMask = ~_mm_movemask_ps(_mm_or_ps(_mm_or_ps(sepX, sepY), sepN)) & 0xF;
+
+	// Segment end points to box
+	__m128 sqrDist = _mm_min_ps(SqrDistancePointBox(_mm_sub_ps(mx, hx), _mm_sub_ps(my, hy), ex, ey),
+								SqrDistancePointBox(_mm_add_ps(mx, hx), _mm_add_ps(my, hy), ex, ey));
+
+	// Box corners to segment
+	__m128 nex = _mm_sub_ps(_mm_setzero_ps(), ex);
+	__m128 ney = _mm_sub_ps(_mm_setzero_ps(), ey);
+	sqrDist = _mm_min_ps(sqrDist, SqrDistancePointSegment(ex, ey, mx, my, ux, uy, l));
+	sqrDist = _mm_min_ps(sqrDist, SqrDistancePointSegment(nex, ey, mx, my, ux, uy, l));
+	sqrDist = _mm_min_ps(sqrDist, SqrDistancePointSegment(ex, ney, mx, my, ux, uy, l));
+	sqrDist = _mm_min_ps(sqrDist, SqrDistancePointSegment(nex, ney, mx, my, ux, uy, l));
+
+	int distanceMask = _mm_movemask_ps(_mm_cmple_ps(sqrDist, _mm_mul_ps(capsule.radius, capsule.radius)));
+
+	return intersectMask | distanceMask;
+}
+
+int SIMD_CapsuleCapsuleTest(const SBodyBatch& capsuleA, const SBodyBatch& capsuleB) noexcept
+{
+	/*
+	* Closest points between two segments, from "Real Time Collision Detection"
+	* by Christer Ericson (5.1.9) written with a center/direction parametrization:
+	* 	P(s) = pA + uA * s, s in [-lA, lA]
+	* 	Q(t) = pB + uB * t, t in [-lB, lB]
+	* Directions are unit vectors which removes a few terms, and the branches
+	* of the original algorithm are replaced by selects
+	*/
+
+	__m128 rx = _mm_sub_ps(capsuleA.posX, capsuleB.posX);
+	__m128 ry = _mm_sub_ps(capsuleA.posY, capsuleB.posY);
+
+	__m128 lA = capsuleA.extentX;
+	__m128 lB = capsuleB.extentX;
+	__m128 nlA = _mm_sub_ps(_mm_setzero_ps(), lA);
+	__m128 nlB = _mm_sub_ps(_mm_setzero_ps(), lB);
+
+	__m128 b = _mm_add_ps(_mm_mul_ps(capsuleA.cos, capsuleB.cos), _mm_mul_ps(capsuleA.sin, capsuleB.sin));
+	__m128 c = _mm_add_ps(_mm_mul_ps(capsuleA.cos, rx), _mm_mul_ps(capsuleA.sin, ry));
+	__m128 f = _mm_add_ps(_mm_mul_ps(capsuleB.cos, rx), _mm_mul_ps(capsuleB.sin, ry));
+
+	// Closest point on the infinite line A to the line B, parallel segments
+	// have a null denominator in which case we pick the center of A
+	__m128 denom = _mm_sub_ps(_mm_set_ps1(1.0f), _mm_mul_ps(b, b));
+	__m128 notParallel = _mm_cmpgt_ps(denom, _mm_set_ps1(1e-6f));
+	denom = _mm_blendv_ps(_mm_set_ps1(1.0f), denom, notParallel);
+
+	__m128 s = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(b, f), c), denom);
+	s = Clamp4(_mm_and_ps(s, notParallel), nlA, lA);
+
+	// Closest point on segment B to the point on segment A, if it had to be
+	// clamped, recompute the closest point on segment A
+	__m128 t = _mm_add_ps(_mm_mul_ps(b, s), f);
+	__m128 clampedT = Clamp4(t, nlB, lB);
+	__m128 recomputedS = Clamp4(_mm_sub_ps(_mm_mul_ps(b, clampedT), c), nlA, lA);
+	s = _mm_blendv_ps(s, recomputedS, _mm_cmpneq_ps(t, clampedT));
+
+	__m128 dx = _mm_sub_ps(_mm_add_ps(rx, _mm_mul_ps(capsuleA.cos, s)), _mm_mul_ps(capsuleB.cos, clampedT));
+	__m128 dy = _mm_sub_ps(_mm_add_ps(ry, _mm_mul_ps(capsuleA.sin, s)), _mm_mul_ps(capsuleB.sin, clampedT));
+	__m128 sqrDist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+	__m128 radii = _mm_add_ps(capsuleA.radius, capsuleB.radius);
+
+	return _mm_movemask_ps(_mm_cmple_ps(sqrDist, _mm_mul_ps(radii, radii)));
+}
+
+int SIMD_OBBOBBTimeOfImpact(const SBodyBatch& boxA, const SBodyBatch& boxB, __m128 moveX, __m128 moveY,
+							__m128& toi, __m128& normalX, __m128& normalY) noexcept
+{
+	/*
+	* SAT test extended to moving boxes. Bodies don't rotate during the step so
+	* the 4 axes stay the same, and along each axis the projections overlap during
+	* a single interval of time. The boxes overlap when the intervals of all axes
+	* overlap: they start touching at the latest time they enter on an axis, if
+	* it is before the earliest time they leave on another one, and the axis of
+	* that latest entry gives the contact normal.
+	*/
+
+	__m128 dx = _mm_sub_ps(boxB.posX, boxA.posX);
+	__m128 dy = _mm_sub_ps(boxB.posY, boxA.posY);
+
+	__m128 absC = Abs4(_mm_add_ps(_mm_mul_ps(boxA.cos, boxB.cos), _mm_mul_ps(boxA.sin, boxB.sin)));
+	__m128 absS = Abs4(_mm_sub_ps(_mm_mul_ps(boxA.cos, boxB.sin), _mm_mul_ps(boxA.sin, boxB.cos)));
+
+	// Axes and sum of the projections of both boxes on them, as in SIMD_OBBOBBTest
+	const __m128 axisX[4] = { boxA.cos, _mm_sub_ps(_mm_setzero_ps(), boxA.sin), boxB.cos, _mm_sub_ps(_mm_setzero_ps(), boxB.sin) };
+	const __m128 axisY[4] = { boxA.sin, boxA.cos, boxB.sin, boxB.cos };
+	const __m128 r[4] =
+	{
+		_mm_add_ps(boxA.extentX, _mm_add_ps(_mm_mul_ps(boxB.extentX, absC), _mm_mul_ps(boxB.extentY, absS))),
+		_mm_add_ps(boxA.extentY, _mm_add_ps(_mm_mul_ps(boxB.extentX, absS), _mm_mul_ps(boxB.extentY, absC))),
+		_mm_add_ps(boxB.extentX, _mm_add_ps(_mm_mul_ps(boxA.extentX, absC), _mm_mul_ps(boxA.extentY, absS))),
+		_mm_add_ps(boxB.extentY, _mm_add_ps(_mm_mul_ps(boxA.extentX, absS), _mm_mul_ps(boxA.extentY, absC))),
+	};
+
+	const __m128 minusMax = _mm_set_ps1(-FLT_MAX);
+	const __m128 plusMax = _mm_set_ps1(FLT_MAX);
+	const __m128 signMask = _mm_set_ps1(-0.0f);
+
+	__m128 enter = minusMax;
+	__m128 exit = plusMax;
+	normalX = _mm_setzero_ps();
+	normalY = _mm_setzero_ps();
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		// Projection of the translation between the boxes at the start of the step and of its change during the step
+		__m128 start = _mm_add_ps(_mm_mul_ps(dx, axisX[i]), _mm_mul_ps(dy, axisY[i]));
+		__m128 speed = _mm_add_ps(_mm_mul_ps(moveX, axisX[i]), _mm_mul_ps(moveY, axisY[i]));
+
+		// Times at which the projection crosses -r and r
+		__m128 moving = _mm_cmpgt_ps(Abs4(speed), _mm_set_ps1(1e-6f));
+		__m128 invSpeed = _mm_div_ps(_mm_set_ps1(1.0f), _mm_blendv_ps(_mm_set_ps1(1.0f), speed, moving));
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), r[i]), start), invSpeed);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(r[i], start), invSpeed);
+
+		// Without motion along the axis, the projections overlap either during the whole step or never
+		__m128 inside = _mm_cmple_ps(Abs4(start), r[i]);
+		__m128 axisEnter = _mm_blendv_ps(_mm_blendv_ps(plusMax, minusMax, inside), _mm_min_ps(t0, t1), moving);
+		__m128 axisExit = _mm_blendv_ps(_mm_blendv_ps(minusMax, plusMax, inside), _mm_max_ps(t0, t1), moving);
+
+		// The normal points toward the side of the axis box B comes from
+		__m128 later = _mm_cmpgt_ps(axisEnter, enter);
+		__m128 side = _mm_and_ps(start, signMask);
+		normalX = _mm_blendv_ps(normalX, _mm_xor_ps(axisX[i], side), later);
+		normalY = _mm_blendv_ps(normalY, _mm_xor_ps(axisY[i], side), later);
+
+		enter = _mm_max_ps(enter, axisEnter);
+		exit = _mm_min_ps(exit, axisExit);
+	}
+
+	toi = enter;
+
+	__m128 hit = _mm_and_ps(_mm_cmple_ps(enter, exit),
+							_mm_and_ps(_mm_cmpge_ps(enter, _mm_setzero_ps()), _mm_cmple_ps(enter, _mm_set_ps1(1.0f))));
+
+	return _mm_movemask_ps(hit);
+}
+
+__m128 SIMD_DistanceTest(const SBodyBatch& bodyA, const SBodyBatch& bodyB,
+						 __m128& pointAX, __m128& pointAY, __m128& pointBX, __m128& pointBY) noexcept
+{
+	/*
+	* In 2D the closest points of two separated convex polygons always include
+	* a vertex of one of them, so the distance between the cores of the bodies
+	* is the smallest of the distances of the 4 corners of each core to the
+	* other core. Cores of circles and capsules are boxes with null extents so
+	* the same code handles them, the radii are removed from the core distance.
+	*/
+
+	const float signX[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+	const float signY[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+
+	__m128 bestSqrDist = _mm_set_ps1(FLT_MAX);
+	pointAX = pointAY = pointBX = pointBY = _mm_setzero_ps();
+
+	for (size_t side = 0; side < 2; side++)
+	{
+		const SBodyBatch& corners = side == 0 ? bodyA : bodyB;
+		const SBodyBatch& other = side == 0 ? bodyB : bodyA;
+
+		__m128 axisXX = _mm_mul_ps(corners.cos, corners.extentX);
+		__m128 axisXY = _mm_mul_ps(corners.sin, corners.extentX);
+		__m128 axisYX = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), corners.sin), corners.extentY);
+		__m128 axisYY = _mm_mul_ps(corners.cos, corners.extentY);
+
+		for (size_t corner = 0; corner < 4; corner++)
+		{
+			__m128 sx = _mm_set_ps1(signX[corner]);
+			__m128 sy = _mm_set_ps1(signY[corner]);
+			__m128 px = _mm_add_ps(corners.posX, _mm_add_ps(_mm_mul_ps(axisXX, sx), _mm_mul_ps(axisYX, sy)));
+			__m128 py = _mm_add_ps(corners.posY, _mm_add_ps(_mm_mul_ps(axisXY, sx), _mm_mul_ps(axisYY, sy)));
+
+			__m128 cx, cy;
+			ClosestPointBox(other, px, py, cx, cy);
+
+			__m128 dx = _mm_sub_ps(cx, px);
+			__m128 dy = _mm_sub_ps(cy, py);
+			__m128 sqrDist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+			__m128 closer = _mm_cmplt_ps(sqrDist, bestSqrDist);
+			bestSqrDist = _mm_min_ps(bestSqrDist, sqrDist);
+
+			pointAX = _mm_blendv_ps(pointAX, side == 0 ? px : cx, closer);
+			pointAY = _mm_blendv_ps(pointAY, side == 0 ? py : cy, closer);
+			pointBX = _mm_blendv_ps(pointBX, side == 0 ? cx : px, closer);
+			pointBY = _mm_blendv_ps(pointBY, side == 0 ? cy : py, closer);
+		}
+	}
+
+	__m128 coreDistance = _mm_sqrt_ps(bestSqrDist);
+
+	// Move the closest points of the cores along the direction between them by the radii
+	__m128 valid = _mm_cmpgt_ps(coreDistance, _mm_set_ps1(1e-6f));
+	__m128 invDistance = _mm_div_ps(_mm_set_ps1(1.0f), _mm_blendv_ps(_mm_set_ps1(1.0f), coreDistance, valid));
+	__m128 dirX = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(pointBX, pointAX), invDistance), valid);
+	__m128 dirY = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(pointBY, pointAY), invDistance), valid);
+
+	__m128 distance = _mm_sub_ps(coreDistance, _mm_add_ps(bodyA.radius, bodyB.radius));
+
+	// Corners can't find the distance of overlapping cores, the SAT test does
+	const int overlapMask = SIMD_OBBOBBTest(bodyA, bodyB);
+	const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+	__m128 overlap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(overlapMask), laneBits), laneBits));
+	overlap = _mm_or_ps(overlap, _mm_cmple_ps(distance, _mm_setzero_ps()));
+
+	pointAX = _mm_add_ps(pointAX, _mm_mul_ps(dirX, bodyA.radius));
+	pointAY = _mm_add_ps(pointAY, _mm_mul_ps(dirY, bodyA.radius));
+	pointBX = _mm_sub_ps(pointBX, _mm_mul_ps(dirX, bodyB.radius));
+	pointBY = _mm_sub_ps(pointBY, _mm_mul_ps(dirY, bodyB.radius));
+
+	__m128 half = _mm_set_ps1(0.5f);
+	__m128 middleX = _mm_mul_ps(_mm_add_ps(pointAX, pointBX), half);
+	__m128 middleY = _mm_mul_ps(_mm_add_ps(pointAY, pointBY), half);
+	pointAX = _mm_blendv_ps(pointAX, middleX, overlap);
+	pointAY = _mm_blendv_ps(pointAY, middleY, overlap);
+	pointBX = _mm_blendv_ps(pointBX, middleX, overlap);
+	pointBY = _mm_blendv_ps(pointBY, middleY, overlap);
+
+	return _mm_andnot_ps(overlap, distance);
+}
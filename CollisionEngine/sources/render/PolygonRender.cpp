@@ -0,0 +1,115 @@
+#include "render/PolygonRender.h"
+
+#include <GL/glu.h>
+
+#include "shapes/Polygon.h"
+#include "physics/PhysicThread.h"
+
+void CPolygonRender::OnBodyAdded(size_t index, const float* pointsX, const float* pointsY, size_t pointCount)
+{
+	m_vertexBufferId.resize(index + 1, 0);
+	m_pointCount.resize(index + 1, 0);
+
+	CreateBuffers(index, pointsX, pointsY, pointCount);
+}
+
+void CPolygonRender::OnBodyRemoved(size_t index)
+{
+	DestroyBuffers(index);
+
+	m_vertexBufferId[index] = m_vertexBufferId.back();
+	m_pointCount[index] = m_pointCount.back();
+	m_vertexBufferId.pop_back();
+	m_pointCount.pop_back();
+}
+
+void CPolygonRender::OnBodiesCleared()
+{
+	for (size_t i = 0; i < m_vertexBufferId.size(); i++)
+		DestroyBuffers(i);
+
+	m_vertexBufferId.clear();
+	m_pointCount.clear();
+}
+
+void CPolygonRender::Draw(const CPolygon& poly)
+{
+	for (size_t index = 0; index < m_vertexBufferId.size(); index++)
+		DrawBody(index, poly.GetPosition(index), poly.rotationCos[index], poly.rotationSin[index]);
+}
+
+void CPolygonRender::Draw(const SPhysicSnapshot& snapshot, float alpha)
+{
+	const size_t count = Min(m_vertexBufferId.size(), snapshot.bodyCount);
+
+	for (size_t index = 0; index < count; index++)
+	{
+		const float angle = snapshot.GetAngle(index, alpha);
+		DrawBody(index, snapshot.GetPosition(index, alpha), cosf(angle), sinf(angle));
+	}
+}
+
+void CPolygonRender::DrawBody(size_t index, const Vec2& position, float cos, float sin)
+{
+	// Set transforms (qssuming model view mode is set)
+	float transfMat[16] = {	cos, sin, 0.0f, 0.0f,
+							-sin, cos, 0.0f, 0.0f,
+							0.0f, 0.0f, 0.0f, 1.0f,
+							position.x, position.y, -1.0f, 1.0f };
+	glPushMatrix();
+	glMultMatrixf(transfMat);
+
+	// Draw vertices
+	BindBuffers(index);
+	glDrawArrays(GL_LINE_LOOP, 0, (GLsizei)m_pointCount[index]);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glPopMatrix();
+}
+
+void CPolygonRender::CreateBuffers(size_t index, const float* pointsX, const float* pointsY, size_t pointCount)
+{
+	DestroyBuffers(index);
+
+	float* vertices = new float[3 * pointCount];
+	for (size_t i = 0; i < pointCount; ++i)
+	{
+		vertices[3 * i] = pointsX[i];
+		vertices[3 * i + 1] = pointsY[i];
+		vertices[3 * i + 2] = 0.0f;
+	}
+
+	GLuint id;
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * pointCount, vertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_vertexBufferId[index] = id;
+	m_pointCount[index] = pointCount;
+
+	delete[] vertices;
+}
+
+void CPolygonRender::BindBuffers(size_t index)
+{
+	if (m_vertexBufferId[index] != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId[index]);
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, (void*)0);
+	}
+}
+
+void CPolygonRender::DestroyBuffers(size_t index)
+{
+	if (m_vertexBufferId[index] != 0)
+	{
+		glDeleteBuffers(1, &m_vertexBufferId[index]);
+		m_vertexBufferId[index] = 0;
+	}
+}
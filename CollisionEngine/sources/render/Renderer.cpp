@@ -8,6 +8,10 @@
 #include "GlobalVariables.h"
 #include "render/Renderer.h"
 #include "render/RenderWindow.h"
+#include "render/PolygonRender.h"
+#include "physics/PhysicThread.h"
+#include "Profiler.h"
+#include "SceneRecording.h"
 #include "shapes/Polygon.h"
 #include "physics/PhysicEngine.h"
 #include "scenes/SceneManager.h"
@@ -17,9 +21,19 @@
 
 CRenderer::CRenderer(float worldHeight)
 	: m_worldHeight(worldHeight), m_lastFPS(0.0f), m_lastFPSSince(0.0f), m_textCursor(0), m_FPS(FPS::Unlocked)
-{}
+{
+	m_polygonRender = new CPolygonRender();
+}
+
+CRenderer::~CRenderer()
+{
+	delete m_polygonRender;
+}
 
-CRenderer::~CRenderer(){}
+IBodyObserver*	CRenderer::GetBodyObserver()
+{
+	return m_polygonRender;
+}
 
 void CRenderer::SetWorldHeight(float worldHeight)
 {
@@ -39,14 +53,25 @@ float	CRenderer::GetWorldHeight() const
 	return m_worldHeight;
 }
 
-void CRenderer::DisplayText(const std::string& text)
+void CRenderer::DisplayText(const char* text)
 {
 	DisplayText(text, 50, gVars->pRenderWindow->Getheight() - 50 - 30 * m_textCursor++);
 }
 
+void CRenderer::DisplayText(const char* text, int x, int y)
+{
+	m_renderTexts.push_back(SRenderText(m_textBuffer.size(), x, y));
+	m_textBuffer.insert(m_textBuffer.end(), text, text + strlen(text) + 1);
+}
+
+void CRenderer::DisplayText(const std::string& text)
+{
+	DisplayText(text.c_str());
+}
+
 void CRenderer::DisplayText(const std::string& text, int x, int y)
 {
-	m_renderTexts.push_back(SRenderText(text, x, y));
+	DisplayText(text.c_str(), x, y);
 }
 
 void CRenderer::DisplayTextWorld(const std::string& text, const Vec2& worldPos)
@@ -70,6 +95,19 @@ void CRenderer::DrawCross(const Vec2& pos, float size, float r, float g, float b
 	DrawLine({ pos.x - size,  pos.y - size }, { pos.x + size, pos.y + size }, r, g, b);
 }
 
+void CRenderer::DrawWorldAABB(const AABB& aabb, float r, float g, float b)
+{
+	Vec2 leftUp(aabb.minimum.x, -aabb.maximum.y);
+	Vec2 leftDown(aabb.minimum);
+	Vec2 rightUp(-aabb.maximum.x, -aabb.maximum.y);
+	Vec2 rightDown(-aabb.maximum.x, aabb.minimum.y);
+
+	DrawLine(leftUp, rightUp, r, g, b);
+	DrawLine(rightUp, rightDown, r, g, b);
+	DrawLine(rightDown, leftDown, r, g, b);
+	DrawLine(leftDown, leftUp, r, g, b);
+}
+
 Vec2 CRenderer::ScreenToWorldPos(const Vec2& pos) const
 {
 	float width = (float)gVars->pRenderWindow->GetWidth();
@@ -110,37 +148,91 @@ void CRenderer::Reshape(int width, int height)
 
 void CRenderer::Update()
 {
+	PROFILE_SCOPE("Frame");
+
 	CTimer timer;
 
 	if (gVars->pRenderWindow->JustPressedKey(Key::F4))
 	{
 		gVars->bDebug = !gVars->bDebug;
 	}
-	if (gVars->pRenderWindow->JustPressedKey(Key::F5))
+	if (gVars->pRenderWindow->JustPressedKey(Key::F6))
 	{
-		gVars->pPhysicEngine->useSAH = !gVars->pPhysicEngine->useSAH;
+		if (gVars->pPhysicThread->IsRunning())
+			gVars->pPhysicThread->Stop();
+		else
+			gVars->pPhysicThread->Start();
 	}
 
-	gVars->pSceneManager->CheckSceneUpdate();
+	const bool physicThread = gVars->pPhysicThread->IsRunning();
 
 	PreRenderFrame();
 
 	float frameTime = UpdateFrameTime();
 	DrawFPS(frameTime);
 
-	gVars->pPhysicEngine->Step(frameTime);
-	
-	timer.Start();
-	UpdateWorld(frameTime);
-	timer.Stop(); 
-	if (gVars->bDebug)
 	{
-		DisplayText("Update duration : " + std::to_string(timer.GetDuration()));
+		// The physics thread steps the world on its own, it is only used while holding its lock
+		std::unique_lock<std::mutex> worldLock;
+		if (physicThread)
+			worldLock = std::unique_lock<std::mutex>(gVars->pPhysicThread->GetWorldMutex());
+
+		if (gVars->pRenderWindow->JustPressedKey(Key::F5))
+		{
+			gVars->pPhysicEngine->useSAH = !gVars->pPhysicEngine->useSAH;
+		}
+		// No step runs while the world is locked, the rings of the profiler can be read
+		if (gVars->pRenderWindow->JustPressedKey(Key::F7))
+		{
+			gVars->pProfiler->WriteChromeTrace("trace.json");
+		}
+		// Records the steps until F8 is pressed again or the scene changes
+		if (gVars->pRenderWindow->JustPressedKey(Key::F8))
+		{
+			if (gVars->pSceneRecorder == nullptr)
+			{
+				CSceneRecorder* recorder = new CSceneRecorder();
+				if (gVars->pWorld != nullptr && recorder->Start("recording.bin", *gVars->pWorld))
+					gVars->pSceneRecorder = recorder;
+				else
+					delete recorder;
+			}
+			else
+			{
+				delete gVars->pSceneRecorder;
+				gVars->pSceneRecorder = nullptr;
+			}
+		}
+
+		gVars->pSceneManager->CheckSceneUpdate();
+
+		if (!physicThread)
+			gVars->pPhysicEngine->Step(frameTime);
+		if (gVars->pWorld)
+			DisplayStepStats();
+
+		timer.Start();
+		UpdateWorld(frameTime);
+		timer.Stop(); 
+		if (gVars->bDebug)
+		{
+			DisplayText("Update duration : " + std::to_string(timer.GetDuration()));
+		}
+
+		if (!physicThread)
+		{
+			timer.Start();
+			RenderPolygons();
+			timer.Stop();
+		}
 	}
 
-	timer.Start();
-	RenderPolygons();
-	timer.Stop();
+	if (physicThread)
+	{
+		timer.Start();
+		RenderSnapshot();
+		timer.Stop();
+	}
 	if (gVars->bDebug)
 	{
 		DisplayText("Render duration : " + std::to_string(timer.GetDuration()));
@@ -187,7 +279,9 @@ void  CRenderer::DrawFPS(float frameTime)
 
 	int width = gVars->pRenderWindow->GetWidth();
 	int height = gVars->pRenderWindow->Getheight();
-	DisplayText(std::string("FPS : ") + std::to_string(m_lastFPS), width - 200, height - 30);
+	char fpsText[32];
+	snprintf(fpsText, sizeof(fpsText), "FPS : %f", m_lastFPS);
+	DisplayText(fpsText, width - 200, height - 30);
 }
 
 void  CRenderer::UpdateWorld(float frameTime)
@@ -206,12 +300,105 @@ void  CRenderer::RenderPolygons()
 
 	if (gVars->pWorld)
 	{
-		gVars->pWorld->RenderPolygons();
+		m_polygonRender->Draw(gVars->pWorld->GetPolygons());
 	}
 
 	glPopMatrix();
 }
 
+void  CRenderer::RenderSnapshot()
+{
+	float alpha;
+	const SPhysicSnapshot* snapshot = gVars->pPhysicThread->AcquireSnapshot(alpha);
+	if (snapshot == nullptr)
+		return;
+
+	glColor3f(0.0f, 0.0f, 0.0f);
+
+	glPushMatrix();
+
+	m_polygonRender->Draw(*snapshot, alpha);
+
+	glPopMatrix();
+
+	if (gVars->bDebug)
+	{
+		for (size_t i = 0; i < snapshot->contactX.size(); i++)
+			DrawCross(Vec2(snapshot->contactX[i], snapshot->contactY[i]), 0.3f, 1.0f, 0.0f, 0.0f);
+	}
+
+	gVars->pPhysicThread->ReleaseSnapshot();
+}
+
+void  CRenderer::DisplayStepStats()
+{
+	const CPhysicEngine& engine = *gVars->pPhysicEngine;
+
+	if (gVars->bDebug)
+	{
+		// The physic thread may be building the next trees meanwhile
+		{
+			const CBVH4ReadLock dynamicTree(engine.GetBVH4());
+			const CBVH4ReadLock staticTree(engine.GetStaticBVH4());
+			DrawBVH4(dynamicTree.GetNodes(), dynamicTree.GetNodeCount(), 1.0f, 0.0f, 0.0f);
+			DrawBVH4(staticTree.GetNodes(), staticTree.GetNodeCount(), 0.0f, 0.5f, 1.0f);
+		}
+
+		auto getDuration = [&engine](StepStage stage) { return std::to_string(engine.GetStageDuration(stage) * 1000.0f); };
+
+		DisplayText("World AABBs duration " + getDuration(StepStage::WorldAABBs) + " ms, BVH duration " + getDuration(StepStage::BVH) + " ms");
+		DisplayText("Collision broadphase duration " + getDuration(StepStage::BroadPhase) + " ms");
+		DisplayText("Collision gather duration " + getDuration(StepStage::Gather) + " ms");
+		DisplayText("Collision narrowphase duration " + getDuration(StepStage::NarrowPhase) + " ms (" + std::to_string(engine.GetThreadCount()) + " threads)");
+		DisplayText("Contact manifolds duration " + getDuration(StepStage::ContactManifolds) + " ms, "
+			+ std::to_string(engine.GetManifolds().GetWarmStartedCount()) + " / " + std::to_string(engine.GetManifolds().GetContactCount()) + " contacts warm started");
+		DisplayText("Collision CCD duration " + getDuration(StepStage::Continuous) + " ms");
+		if (engine.integrate)
+			DisplayText("Integration duration " + getDuration(StepStage::Integration) + " ms");
+	}
+	char collisionsText[64];
+	snprintf(collisionsText, sizeof(collisionsText), "collisions: %zu, impacts: %zu", engine.GetCollisionCount(), engine.GetTimeOfImpactCount());
+	DisplayText(collisionsText);
+	if (gVars->pSceneRecorder != nullptr)
+		DisplayText("Recording " + std::to_string(gVars->pSceneRecorder->GetFrameCount()) + " frames to recording.bin");
+	if (gVars->bDebug && engine.useSeparatingAxisCache)
+	{
+		const size_t obbPairCount = engine.GetShapePairCount(ShapeType::OBB, ShapeType::OBB);
+		DisplayText("Separating axis cache exits " + std::to_string(engine.GetAxisCacheExits()) + " / " + std::to_string(obbPairCount) + " box pairs");
+	}
+	if (gVars->bDebug)
+	{
+		const SPhysicStats& stats = engine.GetStats();
+		char statsText[128];
+
+		snprintf(statsText, sizeof(statsText), "Broad phase: %zu nodes visited, %zu AABB tests, %zu leaf hits, %zu candidate pairs",
+			stats.nodesVisited, stats.aabbTests, stats.leafHits, stats.candidatePairs);
+		DisplayText(statsText);
+		snprintf(statsText, sizeof(statsText), "Narrow phase: %zu full box tests, %zu collisions, %.1f%% false positives",
+			stats.obbTests, stats.collisions, stats.GetFalsePositiveRate() * 100.0f);
+		DisplayText(statsText);
+		snprintf(statsText, sizeof(statsText), "BVH4: SAH cost %.2f, depth %zu, %.2f / 4 children per node, sibling overlap area %.1f",
+			stats.sahCost, stats.depth, stats.averageNodeFill, stats.siblingOverlapArea);
+		DisplayText(statsText);
+
+		const CFrameArena& frameArena = engine.GetFrameArena();
+		DisplayText("Frame arena " + std::to_string(frameArena.GetUsed() / 1024) + " KB, peak " + std::to_string(frameArena.GetHighWaterMark() / 1024)
+			+ " KB / " + std::to_string(frameArena.GetCapacity() / 1024) + " KB" + (frameArena.AreHugePagesRequested() ? " (huge pages requested)" : ""));
+	}
+}
+
+void  CRenderer::DrawBVH4(const Node4* nodes, size_t nodeCount, float r, float g, float b)
+{
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		for (size_t child = 0; child < 4; child++)
+		{
+			if (nodes[i].children[child].index != -1)
+				DrawWorldAABB(nodes[i].GetAABB(child), r, g, b);
+		}
+	}
+}
+
 void  CRenderer::RenderTexts()
 {
 	int width = gVars->pRenderWindow->GetWidth();
@@ -234,12 +421,13 @@ void  CRenderer::RenderTexts()
 		glPushMatrix();
 
 		glTranslatef((float)text.x, (float)text.y, 0.0f);
-		dtx_string(text.text.c_str());
+		dtx_string(&m_textBuffer[text.offset]);
 
 		glPopMatrix();
 	}
 
 	m_renderTexts.clear();
+	m_textBuffer.clear();
 	m_textCursor = 0;
 }
 
@@ -1,16 +1,22 @@
 #include "scenes/SceneManager.h"
 
+#include <cstdio>
 #include <iostream>
 #include <string>
 
 #include "GlobalVariables.h"
 #include "physics/PhysicEngine.h"
+#include "SceneRecording.h"
 #include "World.h"
 #include "render/RenderWindow.h"
 #include "render/Renderer.h"
 
 void CSceneManager::Reset()
 {
+	// A recording only holds the bodies of one scene
+	delete gVars->pSceneRecorder;
+	gVars->pSceneRecorder = nullptr;
+
 	gVars->pPhysicEngine->Reset();
 
 	if (gVars->pWorld != nullptr)
@@ -35,6 +41,7 @@ void CSceneManager::LoadScene(size_t index)
 	Reset();
 
 	gVars->pWorld = new CWorld();
+	gVars->pWorld->SetBodyObserver(gVars->pRenderer->GetBodyObserver());
 	m_scenes[index]->Create();
 
 	gVars->pWorld->ForEachBehavior([&](CBehaviorPtr& behavior)
@@ -52,7 +59,9 @@ void CSceneManager::ReloadScene()
 
 void CSceneManager::CheckSceneUpdate()
 {
-	gVars->pRenderer->DisplayText("F1: Reset scene, F2: prev scene, F3: next scene, cur scene: " + std::to_string(m_currentScene) + ", F4: debug, F5: lock FPS");
+	char helpText[128];
+	snprintf(helpText, sizeof(helpText), "F1: Reset scene, F2: prev scene, F3: next scene, cur scene: %zu, F4: debug, F5: lock FPS, F6: physics thread, F7: save trace, F8: record", m_currentScene);
+	gVars->pRenderer->DisplayText(helpText);
 
 	if (gVars->pRenderWindow->JustPressedKey(Key::F2) && m_currentScene > 0)
 	{
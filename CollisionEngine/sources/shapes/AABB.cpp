@@ -2,8 +2,6 @@
 
 #include <algorithm>
 
-#include "GlobalVariables.h"
-#include "render/Renderer.h"
 #include "physics/PhysicEngine.h"
 
 /**
@@ -80,12 +78,13 @@ float AABB::Surface() const noexcept
     return (-maximum.x - minimum.x) * (-maximum.y - minimum.y);
 }
 
-AABB AABB::Transform(__m128 position, __m128 rotation) const noexcept
+AABB AABB::Transform(__m128 position, float cos, float sin) const noexcept
 {
-    __m128 min = _mm_movelh_ps(reg, reg);
-    __m128 max = _mm_movehl_ps(reg, reg);
+    __m128 min = _mm_movelh_ps(GetReg(), GetReg());
+    __m128 max = _mm_movehl_ps(GetReg(), GetReg());
 
-    __m128 rot = _mm_shuffle_ps(rotation, rotation, _MM_SHUFFLE(3, 1, 2, 0));
+    // Rows of the rotation matrix, X row then Y row
+    __m128 rot = _mm_setr_ps(cos, -sin, sin, cos);
 
     __m128 e = _mm_mul_ps(min, rot);
     __m128 f = _mm_mul_ps(max, rot);
@@ -105,19 +104,6 @@ AABB AABB::Transform(__m128 position, __m128 rotation) const noexcept
     return res;
 }
 
-void AABB::DrawWorld(const AABB& A) noexcept
-{
-    Vec2 leftUp(A.minimum.x, -A.maximum.y);
-    Vec2 leftDown(A.minimum);
-    Vec2 rightUp(-A.maximum.x, -A.maximum.y);
-    Vec2 rightDown(-A.maximum.x, A.minimum.y);
-
-    gVars->pRenderer->DrawLine(leftUp, rightUp, 1.0f, 0.0f, 0.0f);
-    gVars->pRenderer->DrawLine(rightUp, rightDown, 1.0f, 0.0f, 0.0f);
-    gVars->pRenderer->DrawLine(rightDown, leftDown, 1.0f, 0.0f, 0.0f);
-    gVars->pRenderer->DrawLine(leftDown, leftUp, 1.0f, 0.0f, 0.0f);
-}
-
 float AABB::GetSurface(const std::vector<AABB>& aabbs) noexcept
 {
 	AABB s = AABB::GetSurrounding(aabbs);
@@ -130,9 +116,9 @@ float AABB::GetSurface(const std::vector<AABB>& aabbs) noexcept
 
 AABB AABB::GetSurrounding(const std::vector<AABB>& aabbs) noexcept
 {
-	__m128 surround = aabbs[0].reg;
+	__m128 surround = aabbs[0].GetReg();
 	for (size_t i = 1; i < aabbs.size(); i++)
-		surround = _mm_min_ps(surround, aabbs[i].reg);
+		surround = _mm_min_ps(surround, aabbs[i].GetReg());
 
 	return AABB(surround);
 }
@@ -160,31 +146,47 @@ int PackedAABB::Intersect(const PackedAABB& a, const PackedAABB& b) noexcept
 
 PackedAABB::PackedAABB(const AABB& toPack) noexcept
 {
-    minimumX = _mm_shuffle_ps(toPack.reg, toPack.reg, _MM_SHUFFLE(0, 0, 0, 0));
-    minimumY = _mm_shuffle_ps(toPack.reg, toPack.reg, _MM_SHUFFLE(1, 1, 1, 1));
-    maximumX = _mm_shuffle_ps(toPack.reg, toPack.reg, _MM_SHUFFLE(2, 2, 2, 2));
-    maximumY = _mm_shuffle_ps(toPack.reg, toPack.reg, _MM_SHUFFLE(3, 3, 3, 3));
+    minimumX = _mm_shuffle_ps(toPack.GetReg(), toPack.GetReg(), _MM_SHUFFLE(0, 0, 0, 0));
+    minimumY = _mm_shuffle_ps(toPack.GetReg(), toPack.GetReg(), _MM_SHUFFLE(1, 1, 1, 1));
+    maximumX = _mm_shuffle_ps(toPack.GetReg(), toPack.GetReg(), _MM_SHUFFLE(2, 2, 2, 2));
+    maximumY = _mm_shuffle_ps(toPack.GetReg(), toPack.GetReg(), _MM_SHUFFLE(3, 3, 3, 3));
 }
 
 void Node4::SetAABB(size_t index, const AABB& aabb) noexcept
 {
-    packedAABBs.minimumX.m128_f32[index] = aabb.minimum.x;
-    packedAABBs.minimumY.m128_f32[index] = aabb.minimum.y;
-    packedAABBs.maximumX.m128_f32[index] = aabb.maximum.x;
-    packedAABBs.maximumY.m128_f32[index] = aabb.maximum.y;
+    alignas(16) float lanes[4][4];
+    _mm_store_ps(lanes[0], packedAABBs.minimumX);
+    _mm_store_ps(lanes[1], packedAABBs.minimumY);
+    _mm_store_ps(lanes[2], packedAABBs.maximumX);
+    _mm_store_ps(lanes[3], packedAABBs.maximumY);
+
+    lanes[0][index] = aabb.minimum.x;
+    lanes[1][index] = aabb.minimum.y;
+    lanes[2][index] = aabb.maximum.x;
+    lanes[3][index] = aabb.maximum.y;
+
+    packedAABBs.minimumX = _mm_load_ps(lanes[0]);
+    packedAABBs.minimumY = _mm_load_ps(lanes[1]);
+    packedAABBs.maximumX = _mm_load_ps(lanes[2]);
+    packedAABBs.maximumY = _mm_load_ps(lanes[3]);
 }
 
 AABB Node4::GetAABB(size_t index) const noexcept
 {
-    return AABB({ packedAABBs.minimumX.m128_f32[index], packedAABBs.minimumY.m128_f32[index] },
-                { packedAABBs.maximumX.m128_f32[index], packedAABBs.maximumY.m128_f32[index] });
+    alignas(16) float lanes[4][4];
+    _mm_store_ps(lanes[0], packedAABBs.minimumX);
+    _mm_store_ps(lanes[1], packedAABBs.minimumY);
+    _mm_store_ps(lanes[2], packedAABBs.maximumX);
+    _mm_store_ps(lanes[3], packedAABBs.maximumY);
+
+    return AABB({ lanes[0][index], lanes[1][index] }, { lanes[2][index], lanes[3][index] });
 }
 
 AABB Leaf::GetSurroundingAABB(const Leaf* leaves, size_t leafCount) noexcept
 {
-    __m128 surround = leaves[0].aabb.reg;
+    __m128 surround = leaves[0].aabb.GetReg();
     for (size_t i = 1; i < leafCount; i++)
-        surround = _mm_min_ps(surround, leaves[i].aabb.reg);
+        surround = _mm_min_ps(surround, leaves[i].aabb.GetReg());
 
     return AABB(surround);
 }
@@ -1,182 +1,137 @@
 #include "shapes/Polygon.h"
 
-#include <GL/glu.h>
-
 #include "physics/PhysicEngine.h"
 #include "shapes/AABB.h"
 
 CPolygon::CPolygon()
 {
-	__m128 zero = _mm_set_ps1(0.0f);
-	for (size_t i = 0; i < polyCount; i++)
-	{
-		registerRotation[i] = zero;
-		positionX[i] = zero;
-		positionY[i] = zero;
-		halfExtentX[i] = zero;
-		halfExtentY[i] = zero;
-		density[i] = 0.0f;
-		speed[i] = Vec2();
-		m_vertexBufferId[i] = 0;
-	}
 }
 
 CPolygon::~CPolygon()
 {
 }
 
-void CPolygon::Destroy()
+size_t CPolygon::Add()
 {
-	for (size_t i = 0; i < polyCount; i++)
-		DestroyBuffers(i);
+	// New bodies are value initialized: OBB shape and null angle, position,
+	// extents, radius, density and speeds
+	ForEachColumn([](auto& column) { column.Resize(column.Size() + 1); });
+	rotationCos[polyCount] = 1.0f;
+	return polyCount++;
 }
 
-void CPolygon::Build(const size_t polyIdx, float pointsX[4], float pointsY[4])
+size_t CPolygon::AddRange(size_t count)
 {
-	m_lines[polyIdx].clear();
+	const size_t first = polyCount;
+	ForEachColumn([first, count](auto& column) { column.Resize(first + count); });
+	for (size_t i = first; i < first + count; i++)
+		rotationCos[i] = 1.0f;
 
-	CreateBuffers(polyIdx, pointsX, pointsY);
-	BuildLines(polyIdx, pointsX, pointsY);
+	polyCount += count;
+	return first;
 }
 
-void CPolygon::Draw(const size_t index)
+void CPolygon::SwapRemove(const size_t index)
 {
-	Vec2 position = GetPosition(index);
-
-	// Set transforms (qssuming model view mode is set)
-	float transfMat[16] = {	rotation[index].X.x, rotation[index].X.y, 0.0f, 0.0f,
-							rotation[index].Y.x, rotation[index].Y.y, 0.0f, 0.0f,
-							0.0f, 0.0f, 0.0f, 1.0f,
-							position.x, position.y, -1.0f, 1.0f };
-	glPushMatrix();
-	glMultMatrixf(transfMat);
-
-	// Draw vertices
-	BindBuffers(index);
-	glDrawArrays(GL_LINE_LOOP, 0, 4);
-	
-	glDisableClientState(GL_VERTEX_ARRAY);
-
-	glPopMatrix();
+	ForEachColumn([index](auto& column) { column.SwapRemove(index); });
+	polyCount--;
 }
 
 Vec2 CPolygon::GetPosition(const size_t index) const
 {
-	size_t arrayIdx = floor(index / 4);
-	size_t registerIdx = index % 4;
-
-	return { positionX[arrayIdx].m128_f32[registerIdx], 
-		positionY[arrayIdx].m128_f32[registerIdx] };
+	return { positionX[index], positionY[index] };
 }
 
 void CPolygon::SetPosition(const size_t index, const Vec2& position)
 {
-	size_t arrayIdx = floor(index / 4);
-	size_t registerIdx = index % 4;
-
-	positionX[arrayIdx].m128_f32[registerIdx] = position.x;
-	positionY[arrayIdx].m128_f32[registerIdx] = position.y;
+	positionX[index] = position.x;
+	positionY[index] = position.y;
 }
 
 void CPolygon::SetExtent(const size_t index, const Vec2& halfExtent)
 {
-	size_t arrayIdx = floor(index / 4);
-	size_t registerIdx = index % 4;
-
-	halfExtentX[arrayIdx].m128_f32[registerIdx] = halfExtent.x;
-	halfExtentY[arrayIdx].m128_f32[registerIdx] = halfExtent.y;
+	halfExtentX[index] = halfExtent.x;
+	halfExtentY[index] = halfExtent.y;
 }
 
-Vec2	CPolygon::TransformPoint(const size_t index, const Vec2& point) const
+Vec2 CPolygon::GetExtent(const size_t index) const
 {
-	return GetPosition(index) + rotation[index] * point;
+	return Vec2(halfExtentX[index], halfExtentY[index]);
 }
 
-Vec2	CPolygon::InverseTransformPoint(const size_t index, const Vec2& point) const
+float CPolygon::GetRadius(const size_t index) const
 {
-	return rotation[index].GetInverse() * (point - GetPosition(index));
+	return radius[index];
 }
 
-bool	CPolygon::IsPointInside(const size_t index, const Vec2& point) const
+void CPolygon::SetRadius(const size_t index, float radius)
 {
-	float maxDist = -FLT_MAX;
-
-	for (const Line& line : m_lines[index])
-	{
-		Vec2 pos = GetPosition(index);
-		Line globalLine = line.Transform(rotation[index], pos);
-		float pointDist = globalLine.GetPointDist(point);
-		maxDist = Max(maxDist, pointDist);
-	}
-
-	return maxDist <= 0.0f;
+	this->radius[index] = radius;
 }
 
-bool	CPolygon::CheckCollision(const CPolygon& poly, Vec2& colPoint, Vec2& colNormal, float& colDist) const
+float	CPolygon::GetAngle(const size_t index) const
 {
-	return false;
+	return RAD2DEG(angle[index]);
 }
 
-void CPolygon::CreateBuffers(const size_t polyIdx, float pointsX[4], float pointsY[4])
+void	CPolygon::SetAngle(const size_t index, float angle)
 {
-	DestroyBuffers(polyIdx);
-
-	constexpr size_t pointCount = 4;
-
-	float* vertices = new float[3 * pointCount];
-	for (size_t i = 0; i < pointCount; ++i)
-	{
-		vertices[3 * i] = pointsX[i];
-		vertices[3 * i + 1] = pointsY[i];
-		vertices[3 * i + 2] = 0.0f;
-	}
-
-	GLuint id;
-	glGenBuffers(1, &id);
-	glBindBuffer(GL_ARRAY_BUFFER, id);
+	this->angle[index] = DEG2RAD(angle);
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * pointCount, vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	m_vertexBufferId[polyIdx] = id;
-
-	delete[] vertices;
+	__m128 sin, cos;
+	SIMD_SinCos(_mm_set_ps1(this->angle[index]), sin, cos);
+	rotationCos[index] = _mm_cvtss_f32(cos);
+	rotationSin[index] = _mm_cvtss_f32(sin);
 }
 
-void CPolygon::BindBuffers(const size_t polyIdx)
+void	CPolygon::UpdateRotations(size_t begin, size_t end)
 {
-	if (m_vertexBufferId[polyIdx] != 0)
-	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId[polyIdx]);
+	// Start on a block of 8 so that all the loads are aligned, the bodies before begin
+	// get the same values back and the capacity of the columns covers the last block
+	const float* angles = angle.Data();
+	float* cosines = rotationCos.Data();
+	float* sines = rotationSin.Data();
 
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(3, GL_FLOAT, 0, (void*)0);
+#ifdef __AVX2__
+	for (size_t i = begin & ~(size_t)7; i < end; i += 8)
+	{
+		__m256 sin, cos;
+		SIMD_SinCos(_mm256_load_ps(angles + i), sin, cos);
+		_mm256_store_ps(cosines + i, cos);
+		_mm256_store_ps(sines + i, sin);
 	}
-}
-
-void CPolygon::DestroyBuffers(const size_t polyIdx)
-{
-	if (m_vertexBufferId[polyIdx] != 0)
+#else
+	for (size_t i = begin & ~(size_t)3; i < end; i += 4)
 	{
-		glDeleteBuffers(1, &m_vertexBufferId[polyIdx]);
-		m_vertexBufferId[polyIdx] = 0;
+		__m128 sin, cos;
+		SIMD_SinCos(_mm_load_ps(angles + i), sin, cos);
+		_mm_store_ps(cosines + i, cos);
+		_mm_store_ps(sines + i, sin);
 	}
+#endif
 }
 
-void CPolygon::BuildLines(const size_t polyIdx, float pointsX[4], float pointsY[4])
+Vec2	CPolygon::TransformPoint(const size_t index, const Vec2& point) const
 {
-	constexpr size_t pointCount = 4;
+	return GetPosition(index) + GetRotation(index) * point;
+}
 
-	for (size_t index = 0; index < pointCount; ++index)
-	{
-		int next = (index + 1) % pointCount;
+Vec2	CPolygon::InverseTransformPoint(const size_t index, const Vec2& point) const
+{
+	return GetRotation(index).GetInverse() * (point - GetPosition(index));
+}
 
-		Vec2 pointA(pointsX[index], pointsY[index]);
-		Vec2 pointB(pointsX[next], pointsY[next]);
+bool	CPolygon::IsPointInside(const size_t index, const Vec2& point) const
+{
+	// Distance from the point to the core of the rounded box, in local space
+	const Vec2 localPoint = InverseTransformPoint(index, point);
+	const Vec2 extent = GetExtent(index);
+	const Vec2 closest(Clamp(localPoint.x, -extent.x, extent.x), Clamp(localPoint.y, -extent.y, extent.y));
 
-		Vec2 lineDir = (pointA - pointB).Normalized();
+	return (localPoint - closest).GetSqrLength() <= radius[index] * radius[index];
+}
 
-		m_lines[polyIdx].push_back(Line(pointB, lineDir));
-	}
-}
\ No newline at end of file
+bool	CPolygon::CheckCollision(const CPolygon& poly, Vec2& colPoint, Vec2& colNormal, float& colDist) const
+{
+	return false;
+}
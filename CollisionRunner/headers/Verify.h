@@ -0,0 +1,12 @@
+#ifndef _VERIFY_H_
+#define _VERIFY_H_
+
+/*
+* Behavior checks run by --verify. Each check compares a part of the engine
+* with a plain scalar or brute force version of the same computation on
+* random inputs, prints the inputs of the first failures and a line per
+* check. Returns false if any check failed.
+*/
+bool	RunVerifyChecks();
+
+#endif
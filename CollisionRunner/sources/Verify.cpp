@@ -0,0 +1,1435 @@
+#include "Verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <immintrin.h>
+
+#include "CollisionPublisher.h"
+#include "FrameArena.h"
+#include "GlobalVariables.h"
+#include "HandleTable.h"
+#include "JobSystem.h"
+#include "Maths.h"
+#include "SceneFile.h"
+#include "SceneRecording.h"
+#include "World.h"
+#include "physics/PhysicEngine.h"
+#include "physics/ShapeKernels.h"
+
+// Failures printed in full, the next ones are only counted
+#define MAX_PRINTED_FAILURES 10
+
+// Pairs closer to touching than this are skipped, the kernels work with floats
+#define CONTACT_TOLERANCE 1e-3
+
+static size_t s_failureCount = 0;
+
+// Counts a failed condition and prints it with the values of a printf format
+#define VERIFY(condition, ...) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			if (s_failureCount++ < MAX_PRINTED_FAILURES) \
+			{ \
+				printf("  %s:%d %s failed: ", __FILE__, __LINE__, #condition); \
+				printf(__VA_ARGS__); \
+				printf("\n"); \
+			} \
+		} \
+	} while (0)
+
+/*
+* Scalar geometry in double precision, from the same float inputs as the
+* kernels. Bodies are rounded boxes as in the kernels: a box has a null
+* radius, a capsule a segment of half length extentX along its X axis and a
+* circle a null segment.
+*/
+
+struct SLaneBody
+{
+	float	posX, posY;
+	float	cos, sin;
+	float	extentX, extentY;
+	float	radius;
+};
+
+static SLaneBody	RandomBody(float maxExtentX, float maxExtentY, float maxRadius)
+{
+	const float angle = Random(0.0f, 6.2831853f);
+
+	SLaneBody body;
+	body.posX = Random(-2.5f, 2.5f);
+	body.posY = Random(-2.5f, 2.5f);
+	body.cos = cosf(angle);
+	body.sin = sinf(angle);
+	body.extentX = maxExtentX > 0.0f ? Random(0.1f, maxExtentX) : 0.0f;
+	body.extentY = maxExtentY > 0.0f ? Random(0.1f, maxExtentY) : 0.0f;
+	body.radius = maxRadius > 0.0f ? Random(0.1f, maxRadius) : 0.0f;
+	return body;
+}
+
+static SBodyBatch	MakeBatch(const SLaneBody (&bodies)[4])
+{
+	auto lanes = [&bodies](float SLaneBody::* member)
+	{
+		return _mm_setr_ps(bodies[0].*member, bodies[1].*member, bodies[2].*member, bodies[3].*member);
+	};
+
+	SBodyBatch batch;
+	batch.posX = lanes(&SLaneBody::posX);
+	batch.posY = lanes(&SLaneBody::posY);
+	batch.cos = lanes(&SLaneBody::cos);
+	batch.sin = lanes(&SLaneBody::sin);
+	batch.extentX = lanes(&SLaneBody::extentX);
+	batch.extentY = lanes(&SLaneBody::extentY);
+	batch.radius = lanes(&SLaneBody::radius);
+	return batch;
+}
+
+// Point of the body at (localX, localY) in its coordinate frame
+static void	ToWorld(const SLaneBody& body, double localX, double localY, double& x, double& y)
+{
+	x = body.posX + localX * body.cos - localY * body.sin;
+	y = body.posY + localX * body.sin + localY * body.cos;
+}
+
+static void	ToLocal(const SLaneBody& body, double x, double y, double& localX, double& localY)
+{
+	const double dx = x - body.posX;
+	const double dy = y - body.posY;
+	localX = dx * body.cos + dy * body.sin;
+	localY = dy * body.cos - dx * body.sin;
+}
+
+// Distance between a point and the core box of the body, without its radius
+static double	DistancePointBox(const SLaneBody& box, double x, double y)
+{
+	double localX, localY;
+	ToLocal(box, x, y, localX, localY);
+
+	return hypot(std::max(fabs(localX) - box.extentX, 0.0), std::max(fabs(localY) - box.extentY, 0.0));
+}
+
+// Distance between a point and the segment of the body, without its radius
+static double	DistancePointSegment(const SLaneBody& capsule, double x, double y)
+{
+	double localX, localY;
+	ToLocal(capsule, x, y, localX, localY);
+
+	return hypot(localX - std::max(-(double)capsule.extentX, std::min(localX, (double)capsule.extentX)), localY);
+}
+
+// Argument of the minimum of a convex function over [from, to], by ternary search
+template <typename TFunction>
+static double	ArgMinConvex(TFunction function, double from, double to)
+{
+	for (size_t i = 0; i < 200; i++)
+	{
+		const double third = (to - from) / 3.0;
+		if (function(from + third) < function(to - third))
+			to -= third;
+		else
+			from += third;
+	}
+
+	return (from + to) * 0.5;
+}
+
+template <typename TFunction>
+static double	MinimizeConvex(TFunction function, double from, double to)
+{
+	return function(ArgMinConvex(function, from, to));
+}
+
+// Distance between the segment of the capsule and the core of the other body, the
+// distance from a convex shape to a moving point is convex along the segment
+template <typename TDistance>
+static double	DistanceSegment(const SLaneBody& capsule, TDistance distanceToPoint)
+{
+	return MinimizeConvex([&capsule, &distanceToPoint](double s)
+	{
+		double x, y;
+		ToWorld(capsule, s, 0.0, x, y);
+		return distanceToPoint(x, y);
+	}, -capsule.extentX, capsule.extentX);
+}
+
+// Projection of the box on a unit axis, from its center
+static double	ProjectBox(const SLaneBody& box, double axisX, double axisY)
+{
+	return box.extentX * fabs(axisX * box.cos + axisY * box.sin) + box.extentY * fabs(axisY * box.cos - axisX * box.sin);
+}
+
+// Axis of the boxes in the order of OBBAxis
+static void	GetBoxAxis(const SLaneBody& boxA, const SLaneBody& boxB, size_t axis, double& axisX, double& axisY)
+{
+	const SLaneBody& box = axis < 2 ? boxA : boxB;
+	axisX = (axis % 2) == 0 ? box.cos : -box.sin;
+	axisY = (axis % 2) == 0 ? box.sin : box.cos;
+}
+
+// Separation of the boxes along an axis when box B is moved by (offsetX, offsetY), negative if they overlap on it
+static double	BoxAxisSeparation(const SLaneBody& boxA, const SLaneBody& boxB, size_t axis, double offsetX = 0.0, double offsetY = 0.0)
+{
+	double axisX, axisY;
+	GetBoxAxis(boxA, boxB, axis, axisX, axisY);
+
+	const double distance = (boxB.posX + offsetX - boxA.posX) * axisX + (boxB.posY + offsetY - boxA.posY) * axisY;
+	return fabs(distance) - ProjectBox(boxA, axisX, axisY) - ProjectBox(boxB, axisX, axisY);
+}
+
+// Largest separation of the boxes on the 4 axes, the boxes overlap if it is negative
+static double	BoxSeparation(const SLaneBody& boxA, const SLaneBody& boxB, double offsetX = 0.0, double offsetY = 0.0)
+{
+	double separation = -DBL_MAX;
+	for (size_t axis = 0; axis < 4; axis++)
+		separation = std::max(separation, BoxAxisSeparation(boxA, boxB, axis, offsetX, offsetY));
+	return separation;
+}
+
+/*
+* Distance between the cores of two bodies, null if they overlap. Between
+* separated convex shapes it is reached on the boundary of one of them, so it
+* is the smallest distance of an edge of either core to the other core.
+*/
+static double	CoreDistance(const SLaneBody& bodyA, const SLaneBody& bodyB)
+{
+	if (BoxSeparation(bodyA, bodyB) < 0.0)
+		return 0.0;
+
+	double distance = DBL_MAX;
+	for (size_t side = 0; side < 2; side++)
+	{
+		const SLaneBody& edges = side == 0 ? bodyA : bodyB;
+		const SLaneBody& other = side == 0 ? bodyB : bodyA;
+
+		// Edges along X then along Y, on both sides of the center
+		for (size_t edge = 0; edge < 4; edge++)
+		{
+			const double sign = (edge % 2) == 0 ? 1.0 : -1.0;
+			const bool alongX = edge < 2;
+			const double halfLength = alongX ? edges.extentX : edges.extentY;
+
+			distance = std::min(distance, MinimizeConvex([&](double s)
+			{
+				double x, y;
+				if (alongX)
+					ToWorld(edges, s, sign * edges.extentY, x, y);
+				else
+					ToWorld(edges, sign * edges.extentX, s, x, y);
+				return DistancePointBox(other, x, y);
+			}, -halfLength, halfLength));
+		}
+	}
+
+	return distance;
+}
+
+// Checks a distance and its closest points against the scalar distance of the bodies, returns false if the pair is too close to touching to be checked
+static bool	CheckDistance(const SLaneBody& bodyA, const SLaneBody& bodyB, float distance, const Vec2& pointA, const Vec2& pointB, const char* name, size_t index)
+{
+	const double expected = CoreDistance(bodyA, bodyB) - bodyA.radius - bodyB.radius;
+	if (fabs(expected) < CONTACT_TOLERANCE)
+		return false;
+
+	if (expected < 0.0)
+	{
+		// Overlapping bodies only share an approximate contact point
+		VERIFY(distance == 0.0f && pointA.x == pointB.x && pointA.y == pointB.y,
+			   "%s %zu, distance %f and points (%f, %f) (%f, %f) of overlapping bodies", name, index, distance, pointA.x, pointA.y, pointB.x, pointB.y);
+		return true;
+	}
+
+	// The closest points are on the surfaces of the bodies and as far apart as the bodies
+	const double surfaceA = DistancePointBox(bodyA, pointA.x, pointA.y) - bodyA.radius;
+	const double surfaceB = DistancePointBox(bodyB, pointB.x, pointB.y) - bodyB.radius;
+	const double gap = hypot((double)pointB.x - pointA.x, (double)pointB.y - pointA.y);
+	VERIFY(fabs(distance - expected) < 1e-4 && fabs(surfaceA) < 1e-4 && fabs(surfaceB) < 1e-4 && fabs(gap - expected) < 1e-4,
+		   "%s %zu, distance %f instead of %f, points %f and %f from the surfaces and %f apart", name, index, distance, expected, surfaceA, surfaceB, gap);
+	return true;
+}
+
+// Global world and physic engine of the checks that need them, as the runner sets them
+static void	CreateEngine(size_t workerCount)
+{
+	gVars = new SGlobalVariables();
+	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pPhysicEngine->Reset();
+
+	SJobSystemConfig jobSystemConfig;
+	jobSystemConfig.workerCount = workerCount;
+	gVars->pPhysicEngine->SetJobSystemConfig(jobSystemConfig);
+
+	gVars->pWorld = new CWorld();
+}
+
+static void	DestroyEngine()
+{
+	delete gVars->pWorld;
+	delete gVars->pPhysicEngine;
+	delete gVars;
+	gVars = nullptr;
+}
+
+// Boxes, circles, capsules and fast boxes moving in a world of 80 x 50 as in the shapes scene, the first ones static
+static void	CreateRandomBodies(size_t count, size_t staticCount)
+{
+	CWorld& world = *gVars->pWorld;
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+
+	SRandomPolyParams params;
+	params.minRadius = 1.0f;
+	params.maxRadius = 3.0f;
+	params.minBounds = Vec2(-40.0f + params.maxRadius * 3.0f, -25.0f + params.maxRadius * 3.0f);
+	params.maxBounds = params.minBounds * -1.0f;
+	params.minPoints = 4;
+	params.maxPoints = 4;
+	params.minSpeed = 1.0f;
+	params.maxSpeed = 3.0f;
+
+	CPolygon& poly = world.GetPolygons();
+	for (size_t i = 0; i < count; i++)
+	{
+		switch (i % 4)
+		{
+		case 0: world.AddRandomRectangle(params); break;
+		case 1: world.AddRandomCircle(params); break;
+		case 2: world.AddRandomCapsule(params); break;
+		case 3:
+		{
+			const size_t index = world.GetBodyIndex(world.AddRandomRectangle(params));
+			poly.speed[index] = poly.speed[index] * 20.0f;
+			poly.fast[index] = true;
+			break;
+		}
+		}
+	}
+
+	for (size_t i = 0; i < staticCount; i++)
+		world.SetStatic(world.GetBodyHandle(i), true);
+
+	engine.integrate = true;
+	engine.worldBoundsMin = Vec2(-40.0f, -25.0f);
+	engine.worldBoundsMax = Vec2(40.0f, 25.0f);
+}
+
+// Counters of a step that must be the same when the same bodies are stepped again
+struct SStepCounts
+{
+	size_t	candidatePairs;
+	size_t	collisions;
+	size_t	timesOfImpact;
+
+	explicit SStepCounts(const CPhysicEngine& engine)
+		: candidatePairs(engine.GetStats().candidatePairs), collisions(engine.GetStats().collisions), timesOfImpact(engine.GetTimeOfImpactCount()) {}
+
+	bool	operator==(const SStepCounts& other) const
+	{
+		return candidatePairs == other.candidatePairs && collisions == other.collisions && timesOfImpact == other.timesOfImpact;
+	}
+};
+
+/*
+* Checks
+*/
+
+// Overlap tests of all the pairs of shapes against the distances of the shapes
+static void	VerifyShapeKernels()
+{
+	size_t overlaps = 0;
+	size_t separations = 0;
+
+	for (size_t batch = 0; batch < 5000; batch++)
+	{
+		SLaneBody boxesA[4], boxesB[4], circlesA[4], circlesB[4], capsulesA[4], capsulesB[4];
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			boxesA[lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			boxesB[lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			circlesA[lane] = RandomBody(0.0f, 0.0f, 1.5f);
+			circlesB[lane] = RandomBody(0.0f, 0.0f, 1.5f);
+			capsulesA[lane] = RandomBody(1.5f, 0.0f, 1.0f);
+			capsulesB[lane] = RandomBody(1.5f, 0.0f, 1.0f);
+		}
+
+		const SBodyBatch boxA = MakeBatch(boxesA);
+		const SBodyBatch boxB = MakeBatch(boxesB);
+		const SBodyBatch circleA = MakeBatch(circlesA);
+		const SBodyBatch circleB = MakeBatch(circlesB);
+		const SBodyBatch capsuleA = MakeBatch(capsulesA);
+		const SBodyBatch capsuleB = MakeBatch(capsulesB);
+
+		__m128i axes;
+		const int obbMask = SIMD_OBBOBBTest(boxA, boxB, axes);
+		alignas(16) int32_t axisLanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(axisLanes), axes);
+
+		alignas(16) int32_t testedAxes[4];
+		for (size_t lane = 0; lane < 4; lane++)
+			testedAxes[lane] = rand() % 4;
+		const int obbAxisMask = SIMD_OBBOBBAxisTest(boxA, boxB, _mm_load_si128(reinterpret_cast<const __m128i*>(testedAxes)));
+
+		const int circleMask = SIMD_CircleCircleTest(circleA, circleB);
+		const int circleOBBMask = SIMD_CircleOBBTest(circleA, boxB);
+		const int capsuleOBBMask = SIMD_CapsuleOBBTest(capsuleA, boxB);
+		const int capsuleMask = SIMD_CapsuleCapsuleTest(capsuleA, capsuleB);
+		const int circleCapsuleMask = SIMD_CapsuleCapsuleTest(circleA, capsuleB);
+
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			// The bit of the lane must be set if the separation is negative
+			auto check = [&](const char* kernel, int mask, double separation)
+			{
+				if (fabs(separation) < CONTACT_TOLERANCE)
+					return;
+
+				const bool overlap = separation < 0.0;
+				VERIFY(((mask >> lane) & 1) == (overlap ? 1 : 0), "%s, batch %zu lane %zu, separation %f", kernel, batch, lane, separation);
+				if (overlap)
+					overlaps++;
+				else
+					separations++;
+			};
+
+			const SLaneBody& boxBodyA = boxesA[lane];
+			const SLaneBody& boxBodyB = boxesB[lane];
+			const SLaneBody& circleBodyA = circlesA[lane];
+			const SLaneBody& circleBodyB = circlesB[lane];
+			const SLaneBody& capsuleBodyA = capsulesA[lane];
+			const SLaneBody& capsuleBodyB = capsulesB[lane];
+
+			const double boxSeparation = BoxSeparation(boxBodyA, boxBodyB);
+			check("SIMD_OBBOBBTest", obbMask, boxSeparation);
+
+			// The axis of the largest separation separates the boxes, or is the one of least penetration
+			const double axisSeparation = BoxAxisSeparation(boxBodyA, boxBodyB, (size_t)axisLanes[lane]);
+			VERIFY(axisLanes[lane] >= 0 && axisLanes[lane] < 4 && axisSeparation > boxSeparation - 1e-4,
+				   "SIMD_OBBOBBTest axis %d, batch %zu lane %zu, separation %f on the axis and %f", axisLanes[lane], batch, lane, axisSeparation, boxSeparation);
+
+			// A single axis only clears the bit if it separates the boxes
+			check("SIMD_OBBOBBAxisTest", obbAxisMask, BoxAxisSeparation(boxBodyA, boxBodyB, (size_t)testedAxes[lane]));
+
+			check("SIMD_CircleCircleTest", circleMask,
+				  hypot(circleBodyB.posX - circleBodyA.posX, circleBodyB.posY - circleBodyA.posY) - circleBodyA.radius - circleBodyB.radius);
+
+			check("SIMD_CircleOBBTest", circleOBBMask, DistancePointBox(boxBodyB, circleBodyA.posX, circleBodyA.posY) - circleBodyA.radius);
+
+			check("SIMD_CapsuleOBBTest", capsuleOBBMask, DistanceSegment(capsuleBodyA, [&boxBodyB](double x, double y)
+			{
+				return DistancePointBox(boxBodyB, x, y);
+			}) - capsuleBodyA.radius);
+
+			check("SIMD_CapsuleCapsuleTest", capsuleMask, DistanceSegment(capsuleBodyA, [&capsuleBodyB](double x, double y)
+			{
+				return DistancePointSegment(capsuleBodyB, x, y);
+			}) - capsuleBodyA.radius - capsuleBodyB.radius);
+
+			check("SIMD_CapsuleCapsuleTest with a circle", circleCapsuleMask,
+				  DistancePointSegment(capsuleBodyB, circleBodyA.posX, circleBodyA.posY) - circleBodyA.radius - capsuleBodyB.radius);
+		}
+	}
+
+	// Both outcomes must be covered for the checks to mean anything
+	VERIFY(overlaps > 10000 && separations > 10000, "%zu overlapping and %zu separated pairs", overlaps, separations);
+}
+
+// Distances and closest points of all the pairs of shapes, in both orders, against the scalar distances of their cores
+static void	VerifyDistanceKernel()
+{
+	size_t overlaps = 0;
+	size_t separations = 0;
+
+	for (size_t batch = 0; batch < 1000; batch++)
+	{
+		// Boxes, circles then capsules on each side
+		SLaneBody bodiesA[3][4], bodiesB[3][4];
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			bodiesA[0][lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			bodiesB[0][lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			bodiesA[1][lane] = RandomBody(0.0f, 0.0f, 1.5f);
+			bodiesB[1][lane] = RandomBody(0.0f, 0.0f, 1.5f);
+			bodiesA[2][lane] = RandomBody(1.5f, 0.0f, 1.0f);
+			bodiesB[2][lane] = RandomBody(1.5f, 0.0f, 1.0f);
+		}
+
+		for (size_t shapeA = 0; shapeA < 3; shapeA++)
+		{
+			for (size_t shapeB = 0; shapeB < 3; shapeB++)
+			{
+				alignas(16) float distance[4];
+				alignas(16) float pointAX[4], pointAY[4], pointBX[4], pointBY[4];
+
+				__m128 ax, ay, bx, by;
+				_mm_store_ps(distance, SIMD_DistanceTest(MakeBatch(bodiesA[shapeA]), MakeBatch(bodiesB[shapeB]), ax, ay, bx, by));
+				_mm_store_ps(pointAX, ax);
+				_mm_store_ps(pointAY, ay);
+				_mm_store_ps(pointBX, bx);
+				_mm_store_ps(pointBY, by);
+
+				for (size_t lane = 0; lane < 4; lane++)
+				{
+					if (!CheckDistance(bodiesA[shapeA][lane], bodiesB[shapeB][lane], distance[lane], Vec2(pointAX[lane], pointAY[lane]), Vec2(pointBX[lane], pointBY[lane]),
+									   "SIMD_DistanceTest pair", batch * 4 + lane))
+						continue;
+
+					if (distance[lane] == 0.0f)
+						overlaps++;
+					else
+						separations++;
+				}
+			}
+		}
+	}
+
+	// Both outcomes must be covered for the checks to mean anything
+	VERIFY(overlaps > 5000 && separations > 5000, "%zu overlapping and %zu separated pairs", overlaps, separations);
+}
+
+/*
+* ComputeDistances tests the pairs by blocks on the job system and
+* ComputeDistance one pair alone, with the same kernel: both must give the
+* same results, which must be the scalar distances of the bodies. Half of the
+* pairs are close bodies so that some of them overlap.
+*/
+static void	VerifyDistanceQueries()
+{
+	CreateEngine(2);
+	CreateRandomBodies(2000, 0);
+
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	engine.Step(1.0f / 60.0f);
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	const size_t bodyCount = gVars->pWorld->GetPolygonCount();
+
+	std::vector<SPolygonPair> pairs;
+	for (size_t i = 0; i < 10001; i++)
+	{
+		const size_t polyA = (size_t)rand() % bodyCount;
+		size_t polyB = (polyA + 1 + (size_t)rand() % (bodyCount - 1)) % bodyCount;
+
+		for (size_t candidate = 0; (i % 2) == 0 && candidate < 50; candidate++)
+		{
+			const size_t other = (polyA + 1 + (size_t)rand() % (bodyCount - 1)) % bodyCount;
+			if ((poly.GetPosition(other) - poly.GetPosition(polyA)).GetSqrLength() < (poly.GetPosition(polyB) - poly.GetPosition(polyA)).GetSqrLength())
+				polyB = other;
+		}
+
+		pairs.emplace_back(polyA, polyB);
+	}
+
+	std::vector<SBodyDistance> distances;
+	engine.ComputeDistances(pairs, distances);
+	VERIFY(distances.size() == pairs.size(), "%zu distances for %zu pairs", distances.size(), pairs.size());
+
+	auto getBody = [&poly](size_t index)
+	{
+		SLaneBody body;
+		body.posX = poly.positionX[index];
+		body.posY = poly.positionY[index];
+		body.cos = poly.rotationCos[index];
+		body.sin = poly.rotationSin[index];
+		body.extentX = poly.halfExtentX[index];
+		body.extentY = poly.halfExtentY[index];
+		body.radius = poly.radius[index];
+		return body;
+	};
+
+	size_t overlaps = 0;
+	for (size_t i = 0; i < pairs.size() && i < distances.size(); i++)
+	{
+		const SBodyDistance single = engine.ComputeDistance(pairs[i].polyA, pairs[i].polyB);
+		const SBodyDistance& batched = distances[i];
+		VERIFY(single.distance == batched.distance && single.pointA.x == batched.pointA.x && single.pointA.y == batched.pointA.y &&
+			   single.pointB.x == batched.pointB.x && single.pointB.y == batched.pointB.y,
+			   "pair %zu, distance %f from ComputeDistance and %f from ComputeDistances", i, single.distance, batched.distance);
+
+		CheckDistance(getBody(pairs[i].polyA), getBody(pairs[i].polyB), batched.distance, batched.pointA, batched.pointB, "ComputeDistances pair", i);
+		if (batched.distance == 0.0f)
+			overlaps++;
+	}
+
+	VERIFY(overlaps > 100, "%zu overlapping pairs out of %zu", overlaps, pairs.size());
+
+	DestroyEngine();
+}
+
+/*
+* The separation of boxes moving without rotation is a max of absolute values
+* of linear functions of time, which is convex: they touch at its first root
+* if it is positive at the start of the step and negative at its minimum.
+*/
+static void	VerifyOBBTimeOfImpact()
+{
+	// Entries too close to grazing are skipped, the time of impact has no precision there
+	const double grazingTolerance = 1e-2;
+
+	size_t hits = 0;
+	size_t misses = 0;
+
+	for (size_t batch = 0; batch < 5000; batch++)
+	{
+		SLaneBody boxesA[4], boxesB[4];
+		alignas(16) float moveX[4], moveY[4];
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			boxesA[lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			boxesB[lane] = RandomBody(1.5f, 1.5f, 0.0f);
+			moveX[lane] = Random(-6.0f, 6.0f);
+			moveY[lane] = Random(-6.0f, 6.0f);
+		}
+
+		__m128 toi, normalX, normalY;
+		const int hitMask = SIMD_OBBOBBTimeOfImpact(MakeBatch(boxesA), MakeBatch(boxesB), _mm_load_ps(moveX), _mm_load_ps(moveY), toi, normalX, normalY);
+
+		alignas(16) float toiLanes[4], normalXLanes[4], normalYLanes[4];
+		_mm_store_ps(toiLanes, toi);
+		_mm_store_ps(normalXLanes, normalX);
+		_mm_store_ps(normalYLanes, normalY);
+
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			const SLaneBody& boxA = boxesA[lane];
+			const SLaneBody& boxB = boxesB[lane];
+			auto separation = [&](double t)
+			{
+				return BoxSeparation(boxA, boxB, t * moveX[lane], t * moveY[lane]);
+			};
+
+			const double startSeparation = separation(0.0);
+			const double minTime = ArgMinConvex(separation, 0.0, 1.0);
+			const double minSeparation = separation(minTime);
+			if (fabs(startSeparation) < CONTACT_TOLERANCE || fabs(minSeparation) < grazingTolerance)
+				continue;
+
+			// Boxes overlapping at the start of the step aren't reported
+			const bool hit = startSeparation > 0.0 && minSeparation < 0.0;
+			VERIFY(((hitMask >> lane) & 1) == (hit ? 1 : 0), "batch %zu lane %zu, separation %f at the start and %f at %f", batch, lane, startSeparation, minSeparation, minTime);
+			if (!hit)
+			{
+				misses++;
+				continue;
+			}
+
+			hits++;
+
+			double from = 0.0;
+			double to = minTime;
+			for (size_t i = 0; i < 100; i++)
+			{
+				const double middle = (from + to) * 0.5;
+				if (separation(middle) > 0.0)
+					from = middle;
+				else
+					to = middle;
+			}
+
+			const double time = toiLanes[lane];
+			VERIFY(fabs(time - from) < CONTACT_TOLERANCE, "batch %zu lane %zu, time of impact %f instead of %f", batch, lane, time, from);
+
+			// The normal is a unit axis of a box pointing from A to B, along which the boxes just touch
+			const double nx = normalXLanes[lane];
+			const double ny = normalYLanes[lane];
+			const double offsetX = boxB.posX + time * moveX[lane] - boxA.posX;
+			const double offsetY = boxB.posY + time * moveY[lane] - boxA.posY;
+			const double normalSeparation = offsetX * nx + offsetY * ny - ProjectBox(boxA, nx, ny) - ProjectBox(boxB, nx, ny);
+			VERIFY(fabs(hypot(nx, ny) - 1.0) < 1e-4 && fabs(normalSeparation) < grazingTolerance,
+				   "batch %zu lane %zu, normal (%f, %f) with a separation of %f", batch, lane, nx, ny, normalSeparation);
+		}
+	}
+
+	VERIFY(hits > 1000 && misses > 1000, "%zu hits and %zu misses", hits, misses);
+}
+
+/*
+* Random creations and removals, the handles of the bodies must keep giving
+* their index after the swap removes of other bodies, and the handles of
+* removed bodies must stay invalid once their slot is reused.
+*/
+static void	VerifyHandleTable()
+{
+	CHandleTable table;
+	// Handles in dense order as the table must hold them, and handles of removed bodies
+	std::vector<SBodyHandle> bodies;
+	std::vector<SBodyHandle> removed;
+	size_t reusedSlots = 0;
+
+	VERIFY(!table.IsValid(SBodyHandle()), "null handle valid");
+
+	for (size_t operation = 0; operation < 20000; operation++)
+	{
+		// Creations win slightly so the table grows while reusing slots
+		if (bodies.empty() || rand() % 100 < 55)
+		{
+			const SBodyHandle handle = table.Create();
+			if (handle.generation > 0)
+				reusedSlots++;
+			bodies.push_back(handle);
+		}
+		else
+		{
+			const size_t index = (size_t)rand() % bodies.size();
+			const SBodyHandle handle = bodies[index];
+
+			const size_t removedIndex = table.Remove(handle);
+			VERIFY(removedIndex == index, "operation %zu, body %zu removed from index %zu", operation, index, removedIndex);
+
+			bodies[index] = bodies.back();
+			bodies.pop_back();
+			removed.push_back(handle);
+		}
+
+		VERIFY(table.GetCount() == bodies.size(), "operation %zu, %zu bodies instead of %zu", operation, table.GetCount(), bodies.size());
+	}
+
+	for (size_t index = 0; index < bodies.size(); index++)
+	{
+		const SBodyHandle handle = bodies[index];
+		VERIFY(table.IsValid(handle) && table.GetIndex(handle) == index && table.GetHandle(index) == handle && table.GetSlots()[index] == handle.slot,
+			   "body %zu, slot %u generation %u", index, handle.slot, handle.generation);
+	}
+
+	for (const SBodyHandle& handle : removed)
+		VERIFY(!table.IsValid(handle), "removed slot %u generation %u", handle.slot, handle.generation);
+
+	VERIFY(reusedSlots > 1000, "%zu reused slots", reusedSlots);
+
+	/*
+	* Same through the world, the columns of the bodies and their local AABBs
+	* in the physic engine must follow the swap removes. Circles are told
+	* apart by their position and radius.
+	*/
+	CreateEngine(0);
+	CWorld& world = *gVars->pWorld;
+
+	std::vector<SBodyHandle> circles;
+	std::vector<float> ids;
+	for (size_t i = 0; i < 3000; i++)
+	{
+		circles.push_back(world.AddCircle(0.5f + (float)(i % 100) * 0.01f, Vec2((float)i, 0.0f)));
+		ids.push_back((float)i);
+	}
+
+	for (size_t i = 0; i < 2000; i++)
+	{
+		const size_t circle = (size_t)rand() % circles.size();
+		world.RemovePolygon(circles[circle]);
+		VERIFY(!world.IsValid(circles[circle]), "removed circle %.0f", ids[circle]);
+
+		circles[circle] = circles.back();
+		circles.pop_back();
+		ids[circle] = ids.back();
+		ids.pop_back();
+	}
+
+	const CPolygon& poly = world.GetPolygons();
+	const AABB* localAABBs = gVars->pPhysicEngine->GetLocalAABBs();
+	VERIFY(world.GetPolygonCount() == circles.size(), "%zu bodies instead of %zu", world.GetPolygonCount(), circles.size());
+	for (size_t circle = 0; circle < circles.size(); circle++)
+	{
+		const size_t index = world.GetBodyIndex(circles[circle]);
+		const float radius = 0.5f + (float)((size_t)ids[circle] % 100) * 0.01f;
+		VERIFY(world.IsValid(circles[circle]) && poly.positionX[index] == ids[circle] && poly.radius[index] == radius && localAABBs[index].minimum.x == -radius,
+			   "circle %.0f at index %zu, position %f radius %f", ids[circle], index, poly.positionX[index], poly.radius[index]);
+	}
+
+	DestroyEngine();
+}
+
+// Allocation of a frame filled with a byte of its own, to detect allocations sharing memory
+struct SArenaAllocation
+{
+	unsigned char*	memory;
+	size_t			bytes;
+	unsigned char	pattern;
+};
+
+// Allocates random sizes and alignments up to the cache line, which is the alignment of the heap allocations
+static void	AllocateFromArena(CFrameArena& arena, size_t count, std::vector<SArenaAllocation>& allocations, unsigned seed)
+{
+	// Xorshift, rand isn't thread safe
+	uint32_t state = seed * 2654435761u + 1;
+	for (size_t i = 0; i < count; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		const size_t alignment = (size_t)4 << (state % 5);
+		const size_t bytes = 1 + (state >> 8) % 20000;
+		SArenaAllocation allocation;
+		allocation.memory = static_cast<unsigned char*>(arena.Allocate(bytes, alignment));
+		allocation.bytes = bytes;
+		allocation.pattern = (unsigned char)(state >> 24);
+
+		VERIFY(reinterpret_cast<uintptr_t>(allocation.memory) % alignment == 0, "%zu bytes at %p aligned on %zu", bytes, (void*)allocation.memory, alignment);
+		memset(allocation.memory, allocation.pattern, bytes);
+		allocations.push_back(allocation);
+	}
+}
+
+static bool	CheckArenaAllocations(const std::vector<SArenaAllocation>& allocations)
+{
+	for (const SArenaAllocation& allocation : allocations)
+	{
+		for (size_t i = 0; i < allocation.bytes; i++)
+		{
+			if (allocation.memory[i] != allocation.pattern)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+* Allocations of a frame must not share memory, whether they come from the
+* block, from the heap once it is full or from several threads at once.
+* Reset() must grow the block to the high-water mark so that the same frame
+* then fits in it.
+*/
+static void	VerifyFrameArena()
+{
+	CFrameArena arena(1);
+	const size_t capacity = arena.GetCapacity();
+
+	std::vector<SArenaAllocation> allocations;
+	AllocateFromArena(arena, 1000, allocations, 1);
+	const size_t frameBytes = arena.GetUsed();
+	VERIFY(frameBytes > capacity, "%zu bytes used in a block of %zu, the frame doesn't overflow", frameBytes, capacity);
+	VERIFY(CheckArenaAllocations(allocations), "allocations overwritten by others");
+
+	arena.Reset();
+	VERIFY(arena.GetUsed() == 0 && arena.GetHighWaterMark() == frameBytes && arena.GetCapacity() >= frameBytes,
+		   "%zu bytes used after Reset, high-water mark %zu and capacity %zu for a frame of %zu bytes", arena.GetUsed(), arena.GetHighWaterMark(), arena.GetCapacity(), frameBytes);
+
+	// The same frame again is in the block, which starts at the first allocation
+	allocations.clear();
+	AllocateFromArena(arena, 1000, allocations, 1);
+	VERIFY(CheckArenaAllocations(allocations), "allocations overwritten by others");
+	for (const SArenaAllocation& allocation : allocations)
+	{
+		const size_t offset = (size_t)(allocation.memory - allocations[0].memory);
+		VERIFY(allocation.memory >= allocations[0].memory && offset + allocation.bytes <= arena.GetCapacity(),
+			   "allocation at %zu bytes from the start of the block of %zu bytes", offset, arena.GetCapacity());
+	}
+	arena.Reset();
+
+	// Grows in place at the top of the block, moves with its content otherwise
+	unsigned char* memory = static_cast<unsigned char*>(arena.Allocate(100));
+	memset(memory, 7, 100);
+	VERIFY(arena.Reallocate(memory, 100, 100, 1000) == memory, "allocation at the top moved");
+	arena.Allocate(16);
+	unsigned char* moved = static_cast<unsigned char*>(arena.Reallocate(memory, 1000, 100, 2000));
+	VERIFY(moved != memory && moved[0] == 7 && moved[99] == 7, "allocation below another one grown in place or without its content");
+
+	// Threads allocating at once, overflowing the block again
+	arena.Reset();
+	std::vector<std::vector<SArenaAllocation>> threadAllocations(4);
+	std::vector<std::thread> threads;
+	for (size_t thread = 0; thread < threadAllocations.size(); thread++)
+		threads.emplace_back([&arena, &threadAllocations, thread]() { AllocateFromArena(arena, 1000, threadAllocations[thread], 2 + (unsigned)thread); });
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (const std::vector<SArenaAllocation>& threadAllocation : threadAllocations)
+		VERIFY(CheckArenaAllocations(threadAllocation), "allocations of a thread overwritten by others");
+	VERIFY(arena.GetUsed() > arena.GetCapacity(), "%zu bytes used in a block of %zu, the threads don't overflow", arena.GetUsed(), arena.GetCapacity());
+
+	// Arrays growing one after the other, the last one grows in place
+	arena.Reset();
+	CFrameArray<uint32_t> first(arena);
+	CFrameArray<uint32_t> second(arena);
+	for (uint32_t i = 0; i < 100000; i++)
+	{
+		first.PushBack(i);
+		second.PushBack(i * 3);
+	}
+
+	bool arraysValid = first.Size() == 100000 && second.Size() == 100000;
+	for (uint32_t i = 0; i < 100000 && arraysValid; i++)
+		arraysValid = first[i] == i && second[i] == i * 3;
+	VERIFY(arraysValid, "values of the frame arrays lost when they grew");
+
+	first.Reset();
+	second.Reset();
+}
+
+/*
+* A replay must step exactly the recorded bodies: same shapes, same static
+* bodies, and the same pairs, collisions and times of impact at every frame.
+*/
+static void	VerifySceneRecording()
+{
+	const char* path = "verify_recording.crec";
+	const size_t frameCount = 30;
+
+	CreateEngine(0);
+	CreateRandomBodies(2000, 500);
+
+	CWorld& world = *gVars->pWorld;
+	gVars->pSceneRecorder = new CSceneRecorder();
+	VERIFY(gVars->pSceneRecorder->Start(path, world), "can't write %s", path);
+
+	std::vector<SStepCounts> recordedCounts;
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		gVars->pPhysicEngine->Step(1.0f / 60.0f);
+		recordedCounts.push_back(SStepCounts(*gVars->pPhysicEngine));
+	}
+
+	// Stops the recording
+	delete gVars->pSceneRecorder;
+	gVars->pSceneRecorder = nullptr;
+
+	const CPolygon& recordedPoly = world.GetPolygons();
+	std::vector<uint8_t> recordedStatic(recordedPoly.isStatic.begin(), recordedPoly.isStatic.end());
+	std::vector<uint8_t> recordedShapes;
+	for (size_t i = 0; i < recordedPoly.polyCount; i++)
+		recordedShapes.push_back((uint8_t)recordedPoly.shapeType[i]);
+
+	DestroyEngine();
+
+	CreateEngine(0);
+	CSceneReplay replay;
+	VERIFY(replay.Open(path), "can't read %s", path);
+	VERIFY(replay.GetFrameCount() == frameCount, "%zu frames recorded instead of %zu", replay.GetFrameCount(), frameCount);
+	replay.CreateBodies(*gVars->pWorld);
+
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	VERIFY(poly.polyCount == recordedShapes.size(), "%zu bodies replayed instead of %zu", poly.polyCount, recordedShapes.size());
+	for (size_t i = 0; i < poly.polyCount && i < recordedShapes.size(); i++)
+	{
+		VERIFY((uint8_t)poly.shapeType[i] == recordedShapes[i] && (poly.isStatic[i] != 0) == (recordedStatic[i] != 0),
+			   "body %zu, shape %d static %d instead of shape %d static %d", i, (int)poly.shapeType[i], (int)poly.isStatic[i], (int)recordedShapes[i], (int)recordedStatic[i]);
+	}
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		float deltaTime;
+		if (!replay.ReadFrame(*gVars->pWorld, deltaTime))
+		{
+			VERIFY(false, "recording truncated after %zu frames", frame);
+			break;
+		}
+
+		gVars->pPhysicEngine->Step(deltaTime);
+		const SStepCounts counts(*gVars->pPhysicEngine);
+		VERIFY(counts == recordedCounts[frame], "frame %zu, %zu pairs %zu collisions %zu times of impact instead of %zu %zu %zu", frame,
+			   counts.candidatePairs, counts.collisions, counts.timesOfImpact, recordedCounts[frame].candidatePairs, recordedCounts[frame].collisions, recordedCounts[frame].timesOfImpact);
+	}
+
+	replay.Close();
+	DestroyEngine();
+	remove(path);
+}
+
+// Bytes of the columns of the bodies, of their local AABBs and of the trees of the engine
+static std::vector<uint8_t>	GetEngineBytes()
+{
+	const CPolygon& poly = gVars->pWorld->GetPolygons();
+	const CPhysicEngine& engine = *gVars->pPhysicEngine;
+	const size_t bodyCount = poly.polyCount;
+
+	std::vector<uint8_t> bytes;
+	auto append = [&bytes](const auto* data, size_t count)
+	{
+		const uint8_t* first = reinterpret_cast<const uint8_t*>(data);
+		bytes.insert(bytes.end(), first, first + sizeof(*data) * count);
+	};
+
+	append(poly.angle.Data(), bodyCount);
+	append(poly.rotationCos.Data(), bodyCount);
+	append(poly.rotationSin.Data(), bodyCount);
+	append(poly.positionX.Data(), bodyCount);
+	append(poly.positionY.Data(), bodyCount);
+	append(poly.halfExtentX.Data(), bodyCount);
+	append(poly.halfExtentY.Data(), bodyCount);
+	append(poly.radius.Data(), bodyCount);
+	append(poly.shapeType.Data(), bodyCount);
+	append(poly.density.Data(), bodyCount);
+	append(poly.speed.Data(), bodyCount);
+	append(poly.angularSpeed.Data(), bodyCount);
+	append(poly.fast.Data(), bodyCount);
+	append(poly.isStatic.Data(), bodyCount);
+	append(engine.GetLocalAABBs(), bodyCount);
+	append(engine.GetBVH4Nodes(), engine.GetBVH4NodeCount());
+	append(engine.GetStaticBVH4Nodes(), engine.GetStaticBVH4NodeCount());
+	return bytes;
+}
+
+static std::vector<uint8_t>	ReadFile(const char* path)
+{
+	std::vector<uint8_t> bytes;
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return bytes;
+
+	uint8_t buffer[4096];
+	size_t readBytes;
+	while ((readBytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + readBytes);
+
+	fclose(file);
+	return bytes;
+}
+
+static bool	WriteFile(const char* path, const std::vector<uint8_t>& bytes)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	const bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	return fclose(file) == 0 && written;
+}
+
+// Offset of the first copy of the bytes of value in bytes, or the size of bytes
+template <typename T>
+static size_t	FindBytes(const std::vector<uint8_t>& bytes, const T& value)
+{
+	const uint8_t* first = reinterpret_cast<const uint8_t*>(&value);
+	return (size_t)(std::search(bytes.begin(), bytes.end(), first, first + sizeof(T)) - bytes.begin());
+}
+
+/*
+* Damaged copies of a scene file, found by their bytes so that the check
+* doesn't depend on the layout of the header: a node count whose size in
+* bytes wraps must be refused, and a leaf out of the bodies must make the
+* load build the trees again instead of installing them.
+*/
+static void	VerifyDamagedSceneFile(const char* path, const std::vector<uint8_t>& savedBytes, const Node4& savedRoot, size_t nodeCount)
+{
+	const char* damagedPath = "verify_damaged_scene.cscn";
+	const std::vector<uint8_t> bytes = ReadFile(path);
+	const size_t nodesOffset = FindBytes(bytes, savedRoot);
+
+	// The section of the nodes is their offset, element size and count
+	const uint64_t section[3] = { nodesOffset, sizeof(Node4), nodeCount };
+	const size_t sectionOffset = FindBytes(bytes, section);
+	VERIFY(nodesOffset < bytes.size() && sectionOffset < bytes.size(), "nodes at %zu and their section at %zu in %zu bytes", nodesOffset, sectionOffset, bytes.size());
+	if (nodesOffset >= bytes.size() || sectionOffset >= bytes.size())
+		return;
+
+	std::vector<uint8_t> wrapped = bytes;
+	const uint64_t wrappedCount = UINT64_MAX / sizeof(Node4) + 2;
+	memcpy(wrapped.data() + sectionOffset + 2 * sizeof(uint64_t), &wrappedCount, sizeof(wrappedCount));
+	VERIFY(WriteFile(damagedPath, wrapped), "can't write %s", damagedPath);
+
+	CreateEngine(0);
+	VERIFY(!CSceneFile::Load(damagedPath, *gVars->pWorld, *gVars->pPhysicEngine) && gVars->pWorld->GetPolygonCount() == 0,
+		   "%zu bodies loaded with %llu nodes", gVars->pWorld->GetPolygonCount(), (unsigned long long)wrappedCount);
+
+	// Trees of the saved scene were built from its bodies, building them again gives the same nodes
+	std::vector<uint8_t> badLeaf = bytes;
+	Node4 root = savedRoot;
+	root.children[0] = ChildID(0x3FFFFFFF, true);
+	memcpy(badLeaf.data() + nodesOffset, &root, sizeof(root));
+	VERIFY(WriteFile(damagedPath, badLeaf), "can't write %s", damagedPath);
+
+	DestroyEngine();
+	CreateEngine(0);
+	VERIFY(CSceneFile::Load(damagedPath, *gVars->pWorld, *gVars->pPhysicEngine), "can't read %s", damagedPath);
+	VERIFY(GetEngineBytes() == savedBytes, "trees of a file with a leaf out of the bodies differ from the trees built again");
+
+	DestroyEngine();
+	remove(damagedPath);
+}
+
+/*
+* A loaded scene must hold the same bytes as the saved one in every column
+* and tree, and step the same way.
+*/
+static void	VerifySceneFile()
+{
+	const char* path = "verify_scene.cscn";
+	const size_t frameCount = 10;
+
+	CreateEngine(0);
+	CreateRandomBodies(2000, 500);
+	gVars->pPhysicEngine->BuildBVH4();
+	VERIFY(CSceneFile::Save(path, *gVars->pWorld, *gVars->pPhysicEngine, true), "can't write %s", path);
+
+	const std::vector<uint8_t> savedBytes = GetEngineBytes();
+	const size_t savedBVH4NodeCount = gVars->pPhysicEngine->GetBVH4NodeCount();
+	const size_t savedStaticBVH4NodeCount = gVars->pPhysicEngine->GetStaticBVH4NodeCount();
+	const Node4 savedRoot = gVars->pPhysicEngine->GetBVH4Nodes()[0];
+
+	std::vector<SStepCounts> savedCounts;
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		gVars->pPhysicEngine->Step(1.0f / 60.0f);
+		savedCounts.push_back(SStepCounts(*gVars->pPhysicEngine));
+	}
+
+	DestroyEngine();
+
+	CreateEngine(0);
+	VERIFY(CSceneFile::Load(path, *gVars->pWorld, *gVars->pPhysicEngine), "can't read %s", path);
+
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	VERIFY(engine.GetBVH4NodeCount() == savedBVH4NodeCount && engine.GetStaticBVH4NodeCount() == savedStaticBVH4NodeCount && engine.IsStaticBVHValid(),
+		   "trees of %zu and %zu nodes instead of %zu and %zu", engine.GetBVH4NodeCount(), engine.GetStaticBVH4NodeCount(), savedBVH4NodeCount, savedStaticBVH4NodeCount);
+	VERIFY(GetEngineBytes() == savedBytes, "loaded bodies or trees differ from the saved ones");
+
+	engine.integrate = true;
+	engine.worldBoundsMin = Vec2(-40.0f, -25.0f);
+	engine.worldBoundsMax = Vec2(40.0f, 25.0f);
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		engine.Step(1.0f / 60.0f);
+		const SStepCounts counts(engine);
+		VERIFY(counts == savedCounts[frame], "frame %zu, %zu pairs %zu collisions %zu times of impact instead of %zu %zu %zu", frame,
+			   counts.candidatePairs, counts.collisions, counts.timesOfImpact, savedCounts[frame].candidatePairs, savedCounts[frame].collisions, savedCounts[frame].timesOfImpact);
+	}
+
+	DestroyEngine();
+
+	VerifyDamagedSceneFile(path, savedBytes, savedRoot, savedBVH4NodeCount);
+	remove(path);
+}
+
+// FNV-1a of a published frame, its counts, pairs and contacts
+static uint64_t	HashPublishedFrame(const SPublishedFrame& frame, const SPublishedPair* pairs, const SPublishedContact* contacts)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; i++)
+			hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+	};
+
+	add(&frame.frameIndex, sizeof(frame.frameIndex));
+	add(&frame.pairCount, sizeof(frame.pairCount));
+	add(&frame.contactCount, sizeof(frame.contactCount));
+	add(pairs, frame.pairCount * sizeof(SPublishedPair));
+	add(contacts, frame.contactCount * sizeof(SPublishedContact));
+	return hash;
+}
+
+/*
+* The published frames must hold the collisions of their step, truncated to
+* the capacities of the ring, and readers must see frames not yet written
+* or overwritten as such. A thread reading while the engine steps must only
+* get a valid frame with the content the publisher wrote, which the main
+* thread reads back once the step is done.
+*/
+static void	VerifyCollisionPublisher()
+{
+	const char* name = "CollisionRunnerVerify";
+	const size_t slotCount = 4;
+	const size_t capacity = 256;
+
+	CreateEngine(0);
+	CreateRandomBodies(1000, 0);
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+
+	CCollisionPublisher* publisher = new CCollisionPublisher();
+	gVars->pCollisionPublisher = publisher;
+	CCollisionReader reader;
+	const bool opened = publisher->Open(name, slotCount, capacity, capacity) && reader.Open(name);
+	VERIFY(opened, "can't create or open the shared memory %s", name);
+	if (!opened)
+	{
+		delete publisher;
+		gVars->pCollisionPublisher = nullptr;
+		DestroyEngine();
+		return;
+	}
+
+	VERIFY(reader.GetLastFrame() == 0 && reader.Read(1, [](const SPublishedFrame&, const SPublishedPair*, const SPublishedContact*) {}) == PublishedFrameStatus::NotReady,
+		   "frame 1 readable before the first step");
+
+	// The first pairs of the step, in the order of the engine
+	engine.Step(1.0f / 60.0f);
+	std::vector<SCollision> collisions;
+	engine.ForEachCollision([&collisions](const SCollision& collision) { collisions.push_back(collision); });
+
+	const PublishedFrameStatus status = reader.Read(1, [&](const SPublishedFrame& frame, const SPublishedPair* pairs, const SPublishedContact*)
+	{
+		VERIFY(frame.frameIndex == 1 && frame.stepPairCount == collisions.size() && frame.pairCount == std::min(collisions.size(), capacity),
+			   "frame %llu of %u pairs out of %u, the step has %zu", (unsigned long long)frame.frameIndex, frame.pairCount, frame.stepPairCount, collisions.size());
+		for (size_t i = 0; i < frame.pairCount && i < collisions.size(); i++)
+		{
+			const SCollision& collision = collisions[i];
+			VERIFY(pairs[i].polyA == collision.polyA && pairs[i].polyB == collision.polyB && pairs[i].pointX == collision.point.x && pairs[i].pointY == collision.point.y
+				   && pairs[i].normalX == collision.normal.x && pairs[i].normalY == collision.normal.y && pairs[i].distance == collision.distance,
+				   "pair %zu, bodies %u and %u instead of %zu and %zu", i, pairs[i].polyA, pairs[i].polyB, collision.polyA, collision.polyB);
+		}
+	});
+	VERIFY(status == PublishedFrameStatus::Valid && reader.GetLastFrame() == 1, "frame 1 not valid after the first step");
+	VERIFY(collisions.size() > capacity, "%zu collisions, the frame isn't truncated", collisions.size());
+
+	// A ring of steps later the slot holds another frame
+	for (size_t frame = 0; frame < slotCount; frame++)
+		engine.Step(1.0f / 60.0f);
+	auto ignore = [](const SPublishedFrame&, const SPublishedPair*, const SPublishedContact*) {};
+	VERIFY(reader.Read(1, ignore) == PublishedFrameStatus::Overwritten, "frame 1 not overwritten");
+	VERIFY(reader.Read(publisher->GetLastFrame() + 1, ignore) == PublishedFrameStatus::NotReady, "next frame readable before its step");
+
+	// Frames read while the engine steps, with the hash of their content
+	std::atomic<bool> stop(false);
+	std::vector<std::pair<uint64_t, uint64_t>> readFrames;
+	std::thread readerThread([&]()
+	{
+		CCollisionReader threadReader;
+		if (!threadReader.Open(name))
+			return;
+
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			const uint64_t frameIndex = threadReader.GetLastFrame();
+			uint64_t hash = 0;
+			if (threadReader.Read(frameIndex, [&hash](const SPublishedFrame& frame, const SPublishedPair* pairs, const SPublishedContact* contacts)
+				{
+					hash = HashPublishedFrame(frame, pairs, contacts);
+				}) == PublishedFrameStatus::Valid)
+			{
+				if (readFrames.empty() || readFrames.back().first != frameIndex)
+					readFrames.push_back(std::make_pair(frameIndex, hash));
+			}
+		}
+	});
+
+	const uint64_t firstFrame = publisher->GetLastFrame() + 1;
+	std::vector<uint64_t> publishedHashes;
+	for (size_t frame = 0; frame < 100; frame++)
+	{
+		engine.Step(1.0f / 60.0f);
+
+		uint64_t hash = 0;
+		reader.Read(publisher->GetLastFrame(), [&hash](const SPublishedFrame& frame, const SPublishedPair* pairs, const SPublishedContact* contacts)
+		{
+			hash = HashPublishedFrame(frame, pairs, contacts);
+		});
+		publishedHashes.push_back(hash);
+	}
+
+	stop.store(true);
+	readerThread.join();
+
+	size_t checkedFrames = 0;
+	for (const std::pair<uint64_t, uint64_t>& readFrame : readFrames)
+	{
+		// The reader may have seen the last frame before the loop
+		if (readFrame.first < firstFrame)
+			continue;
+
+		checkedFrames++;
+		VERIFY(readFrame.first - firstFrame < publishedHashes.size() && readFrame.second == publishedHashes[readFrame.first - firstFrame],
+			   "frame %llu read by the thread differs from the published one", (unsigned long long)readFrame.first);
+	}
+	VERIFY(checkedFrames > 0, "the thread didn't read any frame while the engine stepped");
+
+	reader.Close();
+	delete publisher;
+	gVars->pCollisionPublisher = nullptr;
+	DestroyEngine();
+}
+
+// Leaves of the tree whose AABB isn't the world AABB of their body in the last step
+static size_t	CountStaleLeaves(const Node4* nodes, size_t nodeCount)
+{
+	const CPhysicEngine& engine = *gVars->pPhysicEngine;
+
+	size_t staleLeaves = 0;
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		for (size_t child = 0; child < 4; child++)
+		{
+			if (nodes[node].children[child].index < 0 || !nodes[node].children[child].isLeaf)
+				continue;
+
+			const AABB leaf = nodes[node].GetAABB(child);
+			const AABB& body = engine.GetWorldAABB((size_t)nodes[node].children[child].index);
+			if (memcmp(&leaf, &body, sizeof(AABB)) != 0)
+				staleLeaves++;
+		}
+	}
+
+	return staleLeaves;
+}
+
+/*
+* Raycasts in the trees against every world AABB of the last step, with
+* static bodies so that their AABBs come from the static tree built in an
+* earlier step. A tenth of the rays are horizontal or vertical, which have
+* no slab along one axis.
+*/
+static void	VerifyRaycast()
+{
+	CreateEngine(0);
+	CreateRandomBodies(2000, 500);
+
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	for (size_t frame = 0; frame < 3; frame++)
+		engine.Step(1.0f / 60.0f);
+
+	const float maxDistance = 80.0f;
+	size_t hits = 0;
+
+	for (size_t ray = 0; ray < 20000; ray++)
+	{
+		const Vec2 origin(Random(-40.0f, 40.0f), Random(-25.0f, 25.0f));
+		const float angle = Random(0.0f, 6.2831853f);
+		Vec2 direction(cosf(angle), sinf(angle));
+		if (ray % 20 == 0)
+			direction = Vec2(1.0f, 0.0f);
+		else if (ray % 20 == 1)
+			direction = Vec2(0.0f, -1.0f);
+
+		// Slab test of the ray against each AABB, the maximum is stored negated
+		bool expectedHit = false;
+		float expectedDistance = maxDistance;
+		for (size_t i = 0; i < gVars->pWorld->GetPolygonCount(); i++)
+		{
+			const AABB& aabb = engine.GetWorldAABB(i);
+			const float minimum[2] = { aabb.minimum.x, aabb.minimum.y };
+			const float maximum[2] = { -aabb.maximum.x, -aabb.maximum.y };
+			const float start[2] = { origin.x, origin.y };
+			const float step[2] = { direction.x, direction.y };
+
+			float enter = 0.0f;
+			float exit = expectedDistance;
+			bool crossed = true;
+			for (size_t axis = 0; axis < 2; axis++)
+			{
+				if (step[axis] == 0.0f)
+				{
+					crossed = crossed && start[axis] >= minimum[axis] && start[axis] <= maximum[axis];
+					continue;
+				}
+
+				const float time0 = (minimum[axis] - start[axis]) / step[axis];
+				const float time1 = (maximum[axis] - start[axis]) / step[axis];
+				enter = std::max(enter, std::min(time0, time1));
+				exit = std::min(exit, std::max(time0, time1));
+			}
+
+			if (crossed && enter <= exit)
+			{
+				expectedHit = true;
+				expectedDistance = enter;
+			}
+		}
+
+		SRaycastHit hit;
+		const bool found = engine.Raycast(origin, direction, maxDistance, hit);
+		VERIFY(found == expectedHit && (!found || fabsf(hit.distance - expectedDistance) < 1e-3f),
+			   "ray %zu from (%f, %f) along (%f, %f), hit %d at %f instead of %d at %f", ray, origin.x, origin.y, direction.x, direction.y,
+			   found ? 1 : 0, hit.distance, expectedHit ? 1 : 0, expectedDistance);
+		if (found)
+			hits++;
+	}
+
+	VERIFY(hits > 1000 && hits < 19000, "%zu rays out of 20000 hit", hits);
+
+	// Enough small bodies for the frame arena to overflow and move the buffers of the next steps to a new block,
+	// the world AABBs of the static bodies must still be the ones of their tree
+	for (size_t i = 0; i < 100000; i++)
+		gVars->pWorld->AddCircle(0.05f, Vec2(Random(-39.0f, 39.0f), Random(-24.0f, 24.0f)));
+	engine.Step(1.0f / 60.0f);
+	engine.Step(1.0f / 60.0f);
+
+	const size_t staleLeaves = CountStaleLeaves(engine.GetBVH4Nodes(), engine.GetBVH4NodeCount());
+	const size_t staleStaticLeaves = CountStaleLeaves(engine.GetStaticBVH4Nodes(), engine.GetStaticBVH4NodeCount());
+	VERIFY(staleLeaves == 0 && staleStaticLeaves == 0, "%zu dynamic and %zu static leaves with another AABB than their body", staleLeaves, staleStaticLeaves);
+
+	DestroyEngine();
+}
+
+/*
+* Static bodies never move, even when they are out of the world bounds or
+* spin, so that the static tree built at the first step stays valid.
+*/
+static void	VerifyStaticBodies()
+{
+	CreateEngine(0);
+	CreateRandomBodies(2000, 500);
+
+	CPolygon& poly = gVars->pWorld->GetPolygons();
+	for (size_t i = 0; i < 500; i += 10)
+	{
+		poly.SetPosition(i, Vec2(i % 20 == 0 ? 45.0f : -45.0f, Random(-30.0f, 30.0f)));
+		poly.angularSpeed[i] = 2.0f;
+	}
+
+	std::vector<Vec2> positions, speeds;
+	std::vector<float> angles;
+	for (size_t i = 0; i < 500; i++)
+	{
+		positions.push_back(poly.GetPosition(i));
+		speeds.push_back(poly.speed[i]);
+		angles.push_back(poly.angle[i]);
+	}
+
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	for (size_t frame = 0; frame < 10; frame++)
+		engine.Step(1.0f / 60.0f);
+
+	for (size_t i = 0; i < 500; i++)
+	{
+		const Vec2 position = poly.GetPosition(i);
+		const AABB& aabb = engine.GetWorldAABB(i);
+		VERIFY(position.x == positions[i].x && position.y == positions[i].y && poly.speed[i].x == speeds[i].x && poly.speed[i].y == speeds[i].y &&
+			   poly.angle[i] == angles[i],
+			   "static body %zu moved from (%f, %f) to (%f, %f), angle %f to %f", i, positions[i].x, positions[i].y, position.x, position.y, angles[i], poly.angle[i]);
+		// The maximum of an AABB is stored negated
+		VERIFY(position.x >= aabb.minimum.x && position.x <= -aabb.maximum.x && position.y >= aabb.minimum.y && position.y <= -aabb.maximum.y,
+			   "static body %zu at (%f, %f) out of its AABB", i, position.x, position.y);
+	}
+
+	DestroyEngine();
+}
+
+struct SVerifyCheck
+{
+	const char*	name;
+	void		(*function)();
+};
+
+static const SVerifyCheck s_checks[] =
+{
+	{ "Shape kernels", VerifyShapeKernels },
+	{ "Distance kernel", VerifyDistanceKernel },
+	{ "Distance queries", VerifyDistanceQueries },
+	{ "OBB time of impact", VerifyOBBTimeOfImpact },
+	{ "Handle table", VerifyHandleTable },
+	{ "Frame arena", VerifyFrameArena },
+	{ "Scene recording", VerifySceneRecording },
+	{ "Scene file", VerifySceneFile },
+	{ "Collision publisher", VerifyCollisionPublisher },
+	{ "Raycast", VerifyRaycast },
+	{ "Static bodies", VerifyStaticBodies },
+};
+
+bool	RunVerifyChecks()
+{
+	// Same inputs at every run
+	srand(1);
+
+	size_t failedChecks = 0;
+	for (const SVerifyCheck& check : s_checks)
+	{
+		const size_t failureCount = s_failureCount;
+		check.function();
+
+		const bool passed = s_failureCount == failureCount;
+		printf("%-32s %s\n", check.name, passed ? "passed" : "FAILED");
+		if (!passed)
+			failedChecks++;
+	}
+
+	printf("%zu checks, %zu failed\n", sizeof(s_checks) / sizeof(s_checks[0]), failedChecks);
+	return failedChecks == 0;
+}
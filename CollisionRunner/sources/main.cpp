@@ -0,0 +1,522 @@
+// Headless runner: steps a scene of the physic engine for a number of frames
+// and prints the timings of the stages of the step, without any window.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "GlobalVariables.h"
+#include "JobSystem.h"
+#include "CollisionPublisher.h"
+#include "Profiler.h"
+#include "SceneFile.h"
+#include "SceneRecording.h"
+#include "Timer.h"
+#include "Verify.h"
+#include "World.h"
+#include "physics/PhysicEngine.h"
+
+struct SRunnerConfig
+{
+	const char*	scene = "shapes";
+	size_t		bodyCount = 300;
+	size_t		frameCount = 1000;
+	float		deltaTime = 1.0f / 60.0f;
+	// Same world as the application window at its default size
+	float		worldWidth = 50.0f * 1260.0f / 768.0f;
+	float		worldHeight = 50.0f;
+	// Job system workers, -1 for the default of the engine
+	int			workerCount = -1;
+	unsigned	seed = 0;
+	// Bodies of the polys and shapes scenes made static, in percent
+	float		staticPercent = 0.0f;
+	// Chrome trace of the steps, not recorded if null
+	const char*	tracePath = nullptr;
+	// Hardware counters of the stages
+	bool		perfCounters = false;
+	// Recording written from the steps, and recording stepped instead of the scene, if not null
+	const char*	recordPath = nullptr;
+	const char*	replayPath = nullptr;
+	// Binary scene written before the first step with its tree, and binary scene stepped instead of the scene, if not null
+	const char*	savePath = nullptr;
+	const char*	loadPath = nullptr;
+	// Shared memory the collisions of each step are streamed to, if not null
+	const char*	publishName = nullptr;
+	// Threads casting rays in the trees while the engine steps
+	size_t		raycasterCount = 0;
+	// Run the behavior checks instead of a scene
+	bool		verify = false;
+};
+
+// Min, max and sum of a duration over the frames
+struct SDurationStats
+{
+	float	min = FLT_MAX;
+	float	max = 0.0f;
+	double	sum = 0.0;
+
+	void	Add(float duration)
+	{
+		min = std::min(min, duration);
+		max = std::max(max, duration);
+		sum += duration;
+	}
+};
+
+static void	PrintUsage()
+{
+	printf("Usage: CollisionRunner [options]\n");
+	printf("  --scene <debug|polys|shapes>  scene to step (shapes)\n");
+	printf("  --bodies <count>              bodies of the polys and shapes scenes (300)\n");
+	printf("  --frames <count>              frames to step (1000)\n");
+	printf("  --dt <seconds>                fixed time of a step (1/60)\n");
+	printf("  --world <width> <height>      size of the world, bodies bounce on its borders (82 50)\n");
+	printf("  --threads <count>             job system workers besides the main thread (hardware threads - 1)\n");
+	printf("  --seed <value>                seed of the random bodies (0)\n");
+	printf("  --static <percent>            bodies of the polys and shapes scenes that never move, in their own BVH4 (0)\n");
+	printf("  --counters                    read the hardware counters of the stages, Linux only. With workers the\n");
+	printf("                                jobs a stage runs on other threads aren't counted, use --threads 0\n");
+	printf("  --trace <file>                save the profiling scopes as a Chrome trace, of the last frames if they don't fit\n");
+	printf("  --record <file>               save the bodies and their transforms before each step\n");
+	printf("  --replay <file>               step the frames of a recording instead of a scene, at most --frames of them, the\n");
+	printf("                                bodies are only moved by the recording so all the runs have the same workload\n");
+	printf("  --save <file>                 save the bodies and their BVH4 as a binary scene before the first step\n");
+	printf("  --load <file>                 step the bodies of a binary scene instead of a scene\n");
+	printf("  --publish <name>              stream the collisions and contacts of each step to the shared memory <name>,\n");
+	printf("                                a ring of the last 8 frames of at most 65536 pairs and contacts\n");
+	printf("  --raycasters <count>          threads casting random rays in the trees of the last step while the engine steps\n");
+	printf("  --verify                      check the engine against scalar and brute force references instead of stepping\n");
+}
+
+static bool	ParseArguments(int argc, char** argv, SRunnerConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (strcmp(arg, "--scene") == 0 && hasValue)
+			config.scene = argv[++i];
+		else if (strcmp(arg, "--bodies") == 0 && hasValue)
+			config.bodyCount = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--frames") == 0 && hasValue)
+			config.frameCount = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--dt") == 0 && hasValue)
+			config.deltaTime = strtof(argv[++i], nullptr);
+		else if (strcmp(arg, "--world") == 0 && i + 2 < argc)
+		{
+			config.worldWidth = strtof(argv[++i], nullptr);
+			config.worldHeight = strtof(argv[++i], nullptr);
+		}
+		else if (strcmp(arg, "--threads") == 0 && hasValue)
+			config.workerCount = atoi(argv[++i]);
+		else if (strcmp(arg, "--seed") == 0 && hasValue)
+			config.seed = (unsigned)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--static") == 0 && hasValue)
+			config.staticPercent = strtof(argv[++i], nullptr);
+		else if (strcmp(arg, "--counters") == 0)
+			config.perfCounters = true;
+		else if (strcmp(arg, "--trace") == 0 && hasValue)
+			config.tracePath = argv[++i];
+		else if (strcmp(arg, "--record") == 0 && hasValue)
+			config.recordPath = argv[++i];
+		else if (strcmp(arg, "--replay") == 0 && hasValue)
+			config.replayPath = argv[++i];
+		else if (strcmp(arg, "--save") == 0 && hasValue)
+			config.savePath = argv[++i];
+		else if (strcmp(arg, "--load") == 0 && hasValue)
+			config.loadPath = argv[++i];
+		else if (strcmp(arg, "--publish") == 0 && hasValue)
+			config.publishName = argv[++i];
+		else if (strcmp(arg, "--raycasters") == 0 && hasValue)
+			config.raycasterCount = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(arg, "--verify") == 0)
+			config.verify = true;
+		else
+			return false;
+	}
+
+	return config.deltaTime > 0.0f && config.worldWidth > 0.0f && config.worldHeight > 0.0f;
+}
+
+static SRandomPolyParams	GetRandomPolyParams(const SRunnerConfig& config)
+{
+	SRandomPolyParams params;
+	params.minRadius = 1.0f;
+	params.maxRadius = 3.0f;
+	params.minBounds = Vec2(-config.worldWidth * 0.5f + params.maxRadius * 3.0f, -config.worldHeight * 0.5f + params.maxRadius * 3.0f);
+	params.maxBounds = params.minBounds * -1.0f;
+	params.minPoints = 4;
+	params.maxPoints = 4;
+	params.minSpeed = 1.0f;
+	params.maxSpeed = 3.0f;
+	return params;
+}
+
+// The bodies move and bounce on the borders of the world
+static void	EnableIntegration(const SRunnerConfig& config)
+{
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	engine.integrate = true;
+	engine.worldBoundsMin = Vec2(-config.worldWidth * 0.5f, -config.worldHeight * 0.5f);
+	engine.worldBoundsMax = Vec2(config.worldWidth * 0.5f, config.worldHeight * 0.5f);
+}
+
+/*
+* Same bodies as the scenes of the application. Their behaviors need the
+* renderer, the bodies bouncing on the borders of the world are moved by the
+* integration of the physic engine instead.
+*/
+static bool	CreateScene(const SRunnerConfig& config)
+{
+	CWorld& world = *gVars->pWorld;
+
+	if (strcmp(config.scene, "debug") == 0)
+	{
+		world.AddRectangle(30.0f, 20.0f, Vec2(-5.0f, -5.0f));
+		world.AddRectangle(15.0f, 25.0f, Vec2(5.0f, 5.0f));
+		return true;
+	}
+
+	const SRandomPolyParams params = GetRandomPolyParams(config);
+
+	if (strcmp(config.scene, "polys") == 0)
+	{
+		for (size_t i = 0; i < config.bodyCount; ++i)
+			world.AddRandomRectangle(params);
+	}
+	else if (strcmp(config.scene, "shapes") == 0)
+	{
+		for (size_t i = 0; i < config.bodyCount; ++i)
+		{
+			switch (i % 3)
+			{
+			case 0: world.AddRandomRectangle(params); break;
+			case 1: world.AddRandomCircle(params); break;
+			case 2: world.AddRandomCapsule(params); break;
+			}
+		}
+
+		CPolygon& polygons = world.GetPolygons();
+		for (size_t i = 0; i < config.bodyCount / 30; ++i)
+		{
+			size_t polyIdx = world.GetBodyIndex(world.AddRandomRectangle(params));
+			polygons.speed[polyIdx] = polygons.speed[polyIdx] * 20.0f;
+			polygons.fast[polyIdx] = true;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	// The bodies are randomly placed, the first ones are as good as any
+	const size_t staticCount = (size_t)(world.GetPolygonCount() * Clamp(config.staticPercent, 0.0f, 100.0f) / 100.0f);
+	for (size_t i = 0; i < staticCount; ++i)
+		world.SetStatic(world.GetBodyHandle(i), true);
+
+	EnableIntegration(config);
+	return true;
+}
+
+// Rays cast by a thread of --raycasters
+struct SRaycasterStats
+{
+	size_t	raycasts = 0;
+	size_t	hits = 0;
+};
+
+// Casts rays from random points of the world in random directions until stopped, like the AI of a game would
+static void	RunRaycaster(const SRunnerConfig& config, unsigned seed, const std::atomic<bool>& stop, SRaycasterStats& stats)
+{
+	const CPhysicEngine& engine = *gVars->pPhysicEngine;
+
+	// Xorshift, rand isn't thread safe
+	uint32_t state = seed * 2654435761u + 1;
+	auto random = [&state](float from, float to)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return from + (to - from) * (float)(state >> 8) / 16777216.0f;
+	};
+
+	// Kept on the stack so that the threads don't share cache lines
+	SRaycasterStats threadStats;
+	while (!stop.load(std::memory_order_relaxed))
+	{
+		const Vec2 origin(random(-config.worldWidth * 0.5f, config.worldWidth * 0.5f), random(-config.worldHeight * 0.5f, config.worldHeight * 0.5f));
+		const float angle = random(0.0f, 6.2831853f);
+
+		SRaycastHit hit;
+		if (engine.Raycast(origin, Vec2(cosf(angle), sinf(angle)), config.worldWidth, hit))
+			threadStats.hits++;
+		threadStats.raycasts++;
+	}
+
+	stats = threadStats;
+}
+
+static void	PrintPerfCounters(const char* name, const SPerfCounterValues& counters, size_t frameCount)
+{
+	const uint64_t cycles = counters.Get(PerfCounter::Cycles);
+	const double instructionsPerCycle = cycles > 0 ? (double)counters.Get(PerfCounter::Instructions) / cycles : 0.0;
+
+	printf("%-20s", name);
+	for (size_t counter = 0; counter < (size_t)PerfCounter::Count; counter++)
+		printf(" %14.0f", (double)counters.values[counter] / frameCount);
+	printf(" %6.2f\n", instructionsPerCycle);
+}
+
+static void	PrintDurationStats(const char* name, const SDurationStats& stats, size_t frameCount)
+{
+	printf("%-20s %10.4f %10.4f %10.4f\n", name, stats.sum / frameCount * 1000.0, stats.min * 1000.0f, stats.max * 1000.0f);
+}
+
+int main(int argc, char** argv)
+{
+	SRunnerConfig config;
+	if (!ParseArguments(argc, argv, config))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (config.verify)
+		return RunVerifyChecks() ? 0 : 1;
+
+	srand(config.seed);
+
+	gVars = new SGlobalVariables();
+	if (config.tracePath != nullptr)
+	{
+		gVars->pProfiler = new CProfiler();
+		CProfiler::SetThreadName("Main");
+	}
+	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pPhysicEngine->Reset();
+
+	if (config.workerCount >= 0)
+	{
+		SJobSystemConfig jobSystemConfig;
+		jobSystemConfig.workerCount = (size_t)config.workerCount;
+		gVars->pPhysicEngine->SetJobSystemConfig(jobSystemConfig);
+	}
+
+	// No body observer, the world doesn't keep any render data
+	gVars->pWorld = new CWorld();
+
+	// The integration stays off during a replay, the frames move the bodies
+	CSceneReplay replay;
+	if (config.replayPath != nullptr)
+	{
+		if (!replay.Open(config.replayPath))
+		{
+			fprintf(stderr, "Can't read the recording %s\n", config.replayPath);
+			return 1;
+		}
+
+		replay.CreateBodies(*gVars->pWorld);
+		config.frameCount = std::min(config.frameCount, replay.GetFrameCount());
+	}
+	else if (config.loadPath != nullptr)
+	{
+		CTimer loadTimer;
+		loadTimer.Start();
+		const bool loaded = CSceneFile::Load(config.loadPath, *gVars->pWorld, *gVars->pPhysicEngine);
+		loadTimer.Stop();
+
+		if (!loaded)
+		{
+			fprintf(stderr, "Can't read the scene %s\n", config.loadPath);
+			return 1;
+		}
+
+		EnableIntegration(config);
+		printf("Loaded %zu bodies from %s in %.3f ms\n", gVars->pWorld->GetPolygonCount(), config.loadPath, loadTimer.GetDuration() * 1000.0f);
+	}
+	else if (!CreateScene(config))
+	{
+		fprintf(stderr, "Unknown scene %s\n", config.scene);
+		PrintUsage();
+		return 1;
+	}
+
+	if (config.savePath != nullptr)
+	{
+		gVars->pPhysicEngine->BuildBVH4();
+		if (!CSceneFile::Save(config.savePath, *gVars->pWorld, *gVars->pPhysicEngine, true))
+		{
+			fprintf(stderr, "Can't write the scene %s\n", config.savePath);
+			return 1;
+		}
+	}
+
+	if (config.recordPath != nullptr)
+	{
+		gVars->pSceneRecorder = new CSceneRecorder();
+		if (!gVars->pSceneRecorder->Start(config.recordPath, *gVars->pWorld))
+		{
+			fprintf(stderr, "Can't write the recording %s\n", config.recordPath);
+			return 1;
+		}
+	}
+
+	if (config.publishName != nullptr)
+	{
+		gVars->pCollisionPublisher = new CCollisionPublisher();
+		if (!gVars->pCollisionPublisher->Open(config.publishName, 8, 65536, 65536))
+		{
+			fprintf(stderr, "Can't create the shared memory %s\n", config.publishName);
+			return 1;
+		}
+	}
+
+	CPhysicEngine& engine = *gVars->pPhysicEngine;
+	engine.usePerfCounters = config.perfCounters;
+
+	SDurationStats stageStats[(size_t)StepStage::Count];
+	SPerfCounterValues stageCounters[(size_t)StepStage::Count];
+	SDurationStats stepStats;
+	// Sums of the counters of the steps, the BVH metrics are the ones of the last step
+	SPhysicStats stats;
+
+	// Started once the first trees are built, they query the trees of the last step during the next one
+	std::atomic<bool> stopRaycasters(false);
+	std::vector<std::thread> raycasters;
+	std::vector<SRaycasterStats> raycasterStats(config.raycasterCount);
+	CTimer raycastTimer;
+
+	CTimer timer;
+	for (size_t frame = 0; frame < config.frameCount; frame++)
+	{
+		float deltaTime = config.deltaTime;
+		if (config.replayPath != nullptr && !replay.ReadFrame(*gVars->pWorld, deltaTime))
+		{
+			fprintf(stderr, "Recording %s truncated after %zu frames\n", config.replayPath, frame);
+			config.frameCount = frame;
+			break;
+		}
+
+		timer.Start();
+		engine.Step(deltaTime);
+		timer.Stop();
+
+		if (frame == 0 && config.raycasterCount > 0)
+		{
+			raycastTimer.Start();
+			for (size_t raycaster = 0; raycaster < config.raycasterCount; raycaster++)
+				raycasters.emplace_back(RunRaycaster, std::cref(config), config.seed + (unsigned)raycaster, std::cref(stopRaycasters), std::ref(raycasterStats[raycaster]));
+		}
+
+		stepStats.Add(timer.GetDuration());
+		for (size_t stage = 0; stage < (size_t)StepStage::Count; stage++)
+		{
+			stageStats[stage].Add(engine.GetStageDuration((StepStage)stage));
+			stageCounters[stage] += engine.GetStagePerfCounters((StepStage)stage);
+		}
+
+		const SPhysicStats& frameStats = engine.GetStats();
+		stats.nodesVisited += frameStats.nodesVisited;
+		stats.aabbTests += frameStats.aabbTests;
+		stats.leafHits += frameStats.leafHits;
+		stats.candidatePairs += frameStats.candidatePairs;
+		stats.obbTests += frameStats.obbTests;
+		stats.collisions += frameStats.collisions;
+	}
+
+	stopRaycasters.store(true);
+	for (std::thread& raycaster : raycasters)
+		raycaster.join();
+	if (!raycasters.empty())
+		raycastTimer.Stop();
+
+	if (config.replayPath != nullptr)
+		printf("Recording %s, %zu bodies, %zu frames, %zu threads\n", config.replayPath, gVars->pWorld->GetPolygonCount(),
+			config.frameCount, engine.GetThreadCount());
+	else if (config.loadPath != nullptr)
+		printf("Scene file %s, %zu bodies, %zu frames of %f s, %zu threads\n", config.loadPath, gVars->pWorld->GetPolygonCount(),
+			config.frameCount, config.deltaTime, engine.GetThreadCount());
+	else
+		printf("Scene %s, %zu bodies, %zu frames of %f s, %zu threads\n", config.scene, gVars->pWorld->GetPolygonCount(),
+			config.frameCount, config.deltaTime, engine.GetThreadCount());
+
+	if (config.frameCount > 0)
+	{
+		printf("%-20s %10s %10s %10s\n", "Stage (ms)", "average", "min", "max");
+		for (size_t stage = 0; stage < (size_t)StepStage::Count; stage++)
+			PrintDurationStats(GetStepStageName((StepStage)stage), stageStats[stage], config.frameCount);
+		PrintDurationStats("Step", stepStats, config.frameCount);
+
+		const SPhysicStats& lastStats = engine.GetStats();
+		const double frameCount = (double)config.frameCount;
+		printf("Per frame: %.1f nodes visited, %.1f AABB tests, %.1f leaf hits, %.1f candidate pairs\n",
+			stats.nodesVisited / frameCount, stats.aabbTests / frameCount, stats.leafHits / frameCount, stats.candidatePairs / frameCount);
+		printf("Per frame: %.1f full box tests, %.1f collisions, %.1f%% false positives in the broad phase\n",
+			stats.obbTests / frameCount, stats.collisions / frameCount, stats.GetFalsePositiveRate() * 100.0f);
+		printf("Last BVH4: SAH cost %.2f, depth %zu, %.2f children per node, sibling overlap area %.1f\n",
+			lastStats.sahCost, lastStats.depth, lastStats.averageNodeFill, lastStats.siblingOverlapArea);
+		if (engine.GetStaticBVH4NodeCount() > 0)
+			printf("Static BVH4: %zu nodes, built once\n", engine.GetStaticBVH4NodeCount());
+	}
+
+	if (!raycasters.empty())
+	{
+		SRaycasterStats raycastStats;
+		for (const SRaycasterStats& threadStats : raycasterStats)
+		{
+			raycastStats.raycasts += threadStats.raycasts;
+			raycastStats.hits += threadStats.hits;
+		}
+
+		const double duration = raycastTimer.GetDuration();
+		printf("Raycasts: %zu on %zu threads during the steps, %.0f per second, %.1f%% hit\n", raycastStats.raycasts, raycasters.size(),
+			duration > 0.0 ? raycastStats.raycasts / duration : 0.0, raycastStats.raycasts > 0 ? raycastStats.hits * 100.0 / raycastStats.raycasts : 0.0);
+	}
+
+	if (config.perfCounters && config.frameCount > 0)
+	{
+		SPerfCounterValues stepCounters;
+		for (const SPerfCounterValues& counters : stageCounters)
+			stepCounters += counters;
+
+		if (stepCounters.availableMask == 0)
+		{
+			printf("Performance counters unavailable\n");
+		}
+		else
+		{
+			printf("%-20s", "Counters per frame");
+			for (size_t counter = 0; counter < (size_t)PerfCounter::Count; counter++)
+				printf(" %14s", stepCounters.IsAvailable((PerfCounter)counter) ? GetPerfCounterName((PerfCounter)counter) : "-");
+			printf(" %6s\n", "IPC");
+
+			for (size_t stage = 0; stage < (size_t)StepStage::Count; stage++)
+				PrintPerfCounters(GetStepStageName((StepStage)stage), stageCounters[stage], config.frameCount);
+			PrintPerfCounters("Step", stepCounters, config.frameCount);
+		}
+	}
+
+	// The workers are idle once the last step is done
+	if (gVars->pProfiler != nullptr)
+	{
+		if (!gVars->pProfiler->WriteChromeTrace(config.tracePath))
+			fprintf(stderr, "Can't write the trace to %s\n", config.tracePath);
+	}
+
+	// Writes the frame count of the recording
+	delete gVars->pSceneRecorder;
+	delete gVars->pCollisionPublisher;
+	delete gVars->pWorld;
+	delete gVars->pPhysicEngine;
+	delete gVars->pProfiler;
+	delete gVars;
+
+	return 0;
+}